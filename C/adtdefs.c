@@ -217,6 +217,8 @@ LookupAtom(const unsigned char *atom) { /* lookup atom in atom table */
   NOfAtoms++;
   na = AbsAtom(ae);
   ae->PropsOfAE = NIL;
+  ae->WriteInfoOfAE = 0;
+  ae->HashOfAE = 0;
   if (ae->UStrOfAE != atom)
     strcpy((char *)ae->StrOfAE, (const char *)atom);
   ae->NextOfAE = a;
@@ -280,6 +282,8 @@ LookupWideAtom(const wchar_t *atom) { /* lookup atom in atom table            */
   }
   na = AbsAtom(ae);
   ae->PropsOfAE = AbsWideAtomProp(wae);
+  ae->WriteInfoOfAE = 0;
+  ae->HashOfAE = 0;
   wae->NextOfPE = NIL;
   wae->KindOfPE = WideAtomProperty;
   wae->SizeOfAtom = sz;
@@ -429,6 +433,8 @@ void Yap_LookupAtomWithAddress(const char *atom,
   ae->NextOfAE = a;
   HashChain[hash].Entry = AbsAtom(ae);
   ae->PropsOfAE = NIL;
+  ae->WriteInfoOfAE = 0;
+  ae->HashOfAE = 0;
   strcpy((char *)ae->StrOfAE, (char *)atom);
   INIT_RWLOCK(ae->ARWLock);
   WRITE_UNLOCK(HashChain[hash].AERWLock);
@@ -424,6 +424,8 @@ clean_atom_list(AtomHashEntry *HashPtr)
 	}
 	NOfAtoms++;
 	NOfBlobs--;
+	/* a concurrent hash map owns memory outside the blob */
+	Yap_CHashRelease(atm);
 	Yap_FreeCodeSpace((char *)b);
 	GLOBAL_agc_collected += sizeof(YAP_BlobPropEntry);
 	GLOBAL_agc_collected += sizeof(AtomEntry)+sizeof(size_t)+at->rep.blob->length;
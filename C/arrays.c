@@ -1132,6 +1132,11 @@ static Int
         WRITE_UNLOCK(ae->ARWLock);
         return true;
       }
+      if (pp->TypeOfAE & SHARED_ARRAY) {
+        WRITE_UNLOCK(ae->ARWLock);
+        Yap_Error(PERMISSION_ERROR_RESIZE_ARRAY, t, "create static array");
+        return false;
+      }
       Yap_FreeCodeSpace(pp->ValueOfVE.floats);
       WRITE_UNLOCK(ae->ARWLock);
       return true;
@@ -1244,7 +1249,8 @@ static Int resize_static_array(USES_REGS1) {
 
     while (!EndOfPAEntr(pp) && pp->KindOfPE != ArrayProperty)
       pp = RepStaticArrayProp(pp->NextOfPE);
-    if (EndOfPAEntr(pp) || pp->ValueOfVE.ints == NULL) {
+    if (EndOfPAEntr(pp) || pp->ValueOfVE.ints == NULL ||
+        (pp->TypeOfAE & SHARED_ARRAY)) {
       Yap_Error(PERMISSION_ERROR_RESIZE_ARRAY, t, "resize a static array");
       return (FALSE);
     } else {
@@ -1299,7 +1305,9 @@ static Int clear_static_array(USES_REGS1) {
 
 Close an existing static array of name  _Name_. The  _Name_ must
 be an atom (named array). Space for the array will be recovered and
-further accesses to the array will return an error.
+further accesses to the array will return an error. Arrays whose
+elements are shared with C code, say by a matrix view, cannot be
+closed.
 
 
 */
@@ -1324,6 +1332,10 @@ static Int close_static_array(USES_REGS1) {
       return (FALSE);
     } else {
       StaticArrayEntry *ptr = (StaticArrayEntry *)pp;
+      if (ptr->TypeOfAE & SHARED_ARRAY) {
+        Yap_Error(PERMISSION_ERROR_RESIZE_ARRAY, t, "close static array");
+        return (FALSE);
+      }
       if (ptr->ValueOfVE.ints != NULL) {
 #if HAVE_MMAP
         Int val =
@@ -1167,7 +1167,6 @@ restart_aux:
   } else {
     seq_tv_t *inpv = (seq_tv_t *)malloc(n * sizeof(seq_tv_t)), out;
     int i = 0;
-    Atom at;
 
     if (!inpv) {
       LOCAL_Error_TYPE = RESOURCE_ERROR_HEAP;
@@ -1188,9 +1187,8 @@ restart_aux:
       goto error;
     }
     free(inpv);
-    at = out.val.a;
-    if (at)
-      return Yap_unify(ARG2, MkAtomTerm(at));
+    if (out.val.t)
+      return Yap_unify(ARG2, out.val.t);
   }
 error:
   /* Error handling */
@@ -1210,10 +1208,11 @@ restart_aux:
   n = Yap_SkipList(&t1, &tailp);
   if (*tailp != TermNil) {
     LOCAL_Error_TYPE = TYPE_ERROR_LIST;
+  } else if (n == 0) {
+    return Yap_unify(ARG3, MkStringTerm(""));
   } else {
     seq_tv_t *inpv = (seq_tv_t *)malloc((n * 2 - 1) * sizeof(seq_tv_t)), out;
     int i = 0;
-    Atom at;
 
     if (!inpv) {
       LOCAL_Error_TYPE = RESOURCE_ERROR_HEAP;
@@ -1226,11 +1225,13 @@ restart_aux:
                      YAP_STRING_FLOAT | YAP_STRING_BIG | YAP_STRING_TERM;
       inpv[i].val.t = HeadOfTerm(t1);
       i++;
+      t1 = TailOfTerm(t1);
+      if (t1 == TermNil)
+        break;
       inpv[i].type = YAP_STRING_STRING | YAP_STRING_ATOM | YAP_STRING_INT |
                      YAP_STRING_FLOAT | YAP_STRING_BIG | YAP_STRING_TERM;
       inpv[i].val.t = t2;
       i++;
-      t1 = TailOfTerm(t1);
     }
     out.type = YAP_STRING_STRING;
     if (!Yap_Concat_Text(2 * n - 1, inpv, &out PASS_REGS)) {
@@ -1238,9 +1239,8 @@ restart_aux:
       goto error;
     }
     free(inpv);
-    at = out.val.a;
-    if (at)
-      return Yap_unify(ARG3, MkAtomTerm(at));
+    if (out.val.t)
+      return Yap_unify(ARG3, out.val.t);
   }
 error:
   /* Error handling */
@@ -2346,6 +2346,195 @@ sub-strings of  _S_.
  */
 static Int sub_string(USES_REGS1) { return sub_atomic(FALSE PASS_REGS); }
 
+/* the text in t as a malloced UTF-8 buffer */
+static unsigned char *text_utf8(Term t, const char *msg) {
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, msg);
+    return NULL;
+  }
+  return (unsigned char *)Yap_TextTermToText(t, NULL, 0, ENC_ISO_UTF8);
+}
+
+/* decode one character, taking a stray byte as a character */
+static size_t text_char(const unsigned char *s, utf8proc_int32_t *c) {
+  utf8proc_ssize_t n = get_utf8((unsigned char *)s, -1, c);
+
+  if (n <= 0) {
+    *c = *s;
+    return 1;
+  }
+  return n;
+}
+
+static bool in_char_set(utf8proc_int32_t c, const unsigned char *set) {
+  utf8proc_int32_t d;
+
+  while (*set) {
+    set += text_char(set, &d);
+    if (c == d)
+      return true;
+  }
+  return false;
+}
+
+/** @pred  split_string(+ _String_, + _SepChars_, + _Pad_, - _SubStrings_)
+
+Break _String_ at every character in _SepChars_, and remove the
+characters in _Pad_ from both ends of every piece. _SubStrings_ is the
+list of the pieces, as strings. If _SepChars_ is empty, _Pad_ is only
+removed from the ends of the whole text:
+
+~~~~~{.prolog}
+?- split_string("a, b ,c", ",", " ", L).
+
+L = ["a", "b", "c"]
+~~~~~
+
+The text is scanned once, and every piece is copied once, so that
+splitting large texts is linear on their size.
+ */
+static Int split_string(USES_REGS1) {
+  unsigned char *s, *seps, *pads;
+  size_t len, i, start, nfields, need;
+  Term tout, *tailp = &tout;
+  utf8proc_int32_t c;
+
+restart:
+  if (!(s = text_utf8(Deref(ARG1), "split_string/4")))
+    return false;
+  if (!(seps = text_utf8(Deref(ARG2), "split_string/4"))) {
+    free(s);
+    return false;
+  }
+  if (!(pads = text_utf8(Deref(ARG3), "split_string/4"))) {
+    free(s);
+    free(seps);
+    return false;
+  }
+  len = strlen((char *)s);
+  nfields = 1;
+  for (i = 0; i < len;) {
+    i += text_char(s + i, &c);
+    if (in_char_set(c, seps))
+      nfields++;
+  }
+  /* each piece takes a list cell, a string header and its text */
+  need = len / sizeof(CELL) + 6 * nfields + 1024;
+  if (HR + need > ASP - 1024) {
+    free(s);
+    free(seps);
+    free(pads);
+    if (!Yap_gcl(need * sizeof(CELL), 4, ENV, gc_P(P, CP))) {
+      Yap_Error(RESOURCE_ERROR_STACK, ARG1, "split_string/4");
+      return false;
+    }
+    goto restart;
+  }
+  for (i = start = 0; i <= len;) {
+    size_t step = 1;
+
+    if (i < len) {
+      step = text_char(s + i, &c);
+      if (!in_char_set(c, seps)) {
+        i += step;
+        continue;
+      }
+    }
+    /* [start, i) is a piece */
+    {
+      size_t b = start, e = i;
+      unsigned char *buf;
+      CELL *pair = HR;
+
+      while (b < e) {
+        size_t n = text_char(s + b, &c);
+        if (!in_char_set(c, pads))
+          break;
+        b += n;
+      }
+      while (e > b) {
+        size_t p = e - 1;
+        while (p > b && (s[p] & 0xc0) == 0x80)
+          p--;
+        text_char(s + p, &c);
+        if (!in_char_set(c, pads))
+          break;
+        e = p;
+      }
+      HR += 2;
+      *tailp = AbsPair(pair);
+      pair[0] = init_tstring(PASS_REGS1);
+      buf = buf_from_tstring(HR);
+      memcpy(buf, s + b, e - b);
+      buf[e - b] = '\0';
+      close_tstring(buf + (e - b) + 1 PASS_REGS);
+      tailp = pair + 1;
+    }
+    i += step;
+    start = i;
+  }
+  *tailp = TermNil;
+  free(s);
+  free(seps);
+  free(pads);
+  return Yap_unify(ARG4, tout);
+}
+
+/* '$atomic_list_split'(+Text, +Sep, -Atoms): the split mode of
+   atomic_list_concat/3, in a single pass over Text */
+static Int atomic_list_split(USES_REGS1) {
+  unsigned char *s, *sep, *p, *q;
+  size_t seplen, n;
+  Term tout, *tailp = &tout;
+
+restart:
+  if (!(s = text_utf8(Deref(ARG1), "atomic_list_concat/3")))
+    return false;
+  if (!(sep = text_utf8(Deref(ARG2), "atomic_list_concat/3"))) {
+    free(s);
+    return false;
+  }
+  if (!(seplen = strlen((char *)sep))) {
+    free(s);
+    free(sep);
+    return Yap_unify(ARG3, MkPairTerm(Deref(ARG1), TermNil));
+  }
+  n = 1;
+  for (p = s; (q = (unsigned char *)strstr((char *)p, (char *)sep));
+       p = q + seplen)
+    n++;
+  if (HR + 2 * n + 1024 > ASP - 1024) {
+    free(s);
+    free(sep);
+    if (!Yap_gcl((2 * n + 1024) * sizeof(CELL), 3, ENV, gc_P(P, CP))) {
+      Yap_Error(RESOURCE_ERROR_STACK, ARG1, "atomic_list_concat/3");
+      return false;
+    }
+    goto restart;
+  }
+  for (p = s;; p = q + seplen) {
+    unsigned char ch = 0;
+    Atom at;
+
+    if ((q = (unsigned char *)strstr((char *)p, (char *)sep))) {
+      ch = *q;
+      *q = '\0';
+    }
+    at = Yap_LookupUTF8Atom(p);
+    *tailp = AbsPair(HR);
+    HR[0] = MkAtomTerm(at);
+    tailp = HR + 1;
+    HR += 2;
+    if (!q)
+      break;
+    *q = ch;
+  }
+  *tailp = TermNil;
+  free(s);
+  free(sep);
+  return Yap_unify(ARG3, tout);
+}
+
 static Int cont_current_atom(USES_REGS1) {
   Atom catom;
   Int i = IntOfTerm(EXTRA_CBACK_ARG(1, 2));
@@ -2629,6 +2818,8 @@ void Yap_InitAtomPreds(void) {
   */
   Yap_InitCPred("atomics_to_string", 2, atomics_to_string2, 0);
   Yap_InitCPred("atomics_to_string", 3, atomics_to_string3, 0);
+  Yap_InitCPred("split_string", 4, split_string, 0);
+  Yap_InitCPred("$atomic_list_split", 3, atomic_list_split, 0);
   Yap_InitCPred("get_string_code", 3, get_string_code3, 0);
 
   Yap_InitCPred("downcase_text_to_atom", 2, downcase_text_to_atom, 0);
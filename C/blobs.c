@@ -158,6 +158,8 @@ AtomEntry *Yap_lookupBlob(void *blob, size_t len, void *type0, int *new) {
   NOfBlobs++;
   INIT_RWLOCK(ae->ARWLock);
   ae->PropsOfAE = AbsBlobProp(b);
+  ae->WriteInfoOfAE = 0;
+  ae->HashOfAE = 0;
   ae->NextOfAE = AbsAtom(Blobs);
   ae->rep.blob->length = len;
   memcpy(ae->rep.blob->data, blob, len);
@@ -2852,6 +2852,33 @@ X_API Int YAP_ListToInts(Term t, Int *dblp, size_t sz) {
   } while (TRUE);
 }
 
+X_API void *YAP_StaticArrayData(Atom name, Int *size, bool *floats) {
+  AtomEntry *ae = RepAtom(name);
+  StaticArrayEntry *pp;
+  void *out = NULL;
+
+  WRITE_LOCK(ae->ARWLock);
+  pp = RepStaticArrayProp(ae->PropsOfAE);
+  while (!EndOfPAEntr(pp) && pp->KindOfPE != ArrayProperty)
+    pp = RepStaticArrayProp(pp->NextOfPE);
+  if (!EndOfPAEntr(pp) && !ArrayIsDynamic((ArrayEntry *)pp) &&
+      pp->ValueOfVE.ints != NULL) {
+    if (pp->ArrayType == array_of_ints) {
+      *floats = false;
+      out = pp->ValueOfVE.ints;
+    } else if (pp->ArrayType == array_of_doubles) {
+      *floats = true;
+      out = pp->ValueOfVE.floats;
+    }
+    *size = pp->ArrayEArity;
+    /* we cannot tell when the caller is done with it */
+    if (out)
+      pp->TypeOfAE |= SHARED_ARRAY;
+  }
+  WRITE_UNLOCK(ae->ARWLock);
+  return out;
+}
+
 X_API Term YAP_OpenList(int n) {
   CACHE_REGS
   Term t;
@@ -0,0 +1,711 @@
+/*************************************************************************
+*									 *
+*	 YAP Prolog 							 *
+*									 *
+*	Yap Prolog was developed at NCCUP - Universidade do Porto	 *
+*									 *
+* Copyright L.Damas, V.S.Costa and Universidade do Porto 1985-1997	 *
+*									 *
+**************************************************************************
+*									 *
+* File:		chash.c							 *
+* Last rev:								 *
+* mods:									 *
+* comments:	hash maps shared by all threads				 *
+*									 *
+*************************************************************************/
+
+/** @defgroup CHash Concurrent Hash Maps
+@ingroup builtins
+@{
+
+A concurrent hash map is shared by all threads, and is meant for data
+that many threads read and some threads update, such as caches. Keys
+must be ground; keys and values are copied into the map, and copied out
+again when read, as in the internal database.
+
+Readers never block: lookups run at the same time as each other and as
+updates. Updates lock a stripe of the table, so that updates to keys in
+different stripes also run in parallel.
+
+A map is freed by chash_destroy/1 or, in builds without threads, by
+the atom garbage collector once no term refers to it. The atom garbage
+collector does not run in builds with threads, where chash_destroy/1
+is the only way to give the memory back.
+
+~~~~~{.prolog}
+?- chash_new(M), chash_put(M, k, [1,2]), chash_get(M, k, V).
+
+V = [1,2]
+~~~~~
+*/
+
+#include "Yap.h"
+#include "Yatom.h"
+#include "YapHeap.h"
+#include "yapio.h"
+#include "iopreds.h"
+#include "blobs.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHASH_STRIPES		64
+#define CHASH_DEFAULT_BUCKETS	(1 << 14)
+
+#if defined(__GNUC__)
+#define CHASH_LOAD(p)		__atomic_load_n(&(p), __ATOMIC_SEQ_CST)
+#define CHASH_STORE(p, v)	__atomic_store_n(&(p), (v), __ATOMIC_SEQ_CST)
+#define CHASH_ADD(p, v)		__atomic_add_fetch(&(p), (v), __ATOMIC_SEQ_CST)
+#else
+#define CHASH_LOAD(p)		(p)
+#define CHASH_STORE(p, v)	((p) = (v))
+#define CHASH_ADD(p, v)		((p) += (v))
+#endif
+
+/* entries never change once they are visible: updates link in a new
+   entry, and the old one is freed when no reader may still see it.
+
+   Readers count themselves in one of two counters of the stripe, the
+   one of the current phase. An entry unlinked in a phase goes to that
+   phase's retired list. When the counter of the other phase is zero,
+   the readers that started before the last change of phase have all
+   left, so a write frees that list and makes it the current phase:
+   under steady reads new readers use the new counter, and the old one
+   drains. */
+typedef struct chash_entry {
+  struct chash_entry *next;
+  uint64_t hash;
+  size_t klen, vlen;
+  unsigned char data[1];	/* the key, and then the value */
+} chash_entry;
+
+typedef struct chash_stripe {
+#if defined(YAPOR) || defined(THREADS)
+  lockvar lock;
+#endif
+  int phase;
+  long readers[2];
+  chash_entry *retired[2];
+  char pad[64];			/* keep stripes in different cache lines */
+} chash_stripe;
+
+typedef struct chash {
+  chash_entry **buckets;
+  size_t mask;
+  long size;
+  int dead;
+  chash_stripe stripes[CHASH_STRIPES];
+} chash_t;
+
+static blob_type_t PL_Concurrent_Hash = {
+  .magic = YAP_BLOB_MAGIC_B,
+  .flags = PL_BLOB_UNIQUE | PL_BLOB_NOCOPY,
+  .name = "concurrent_hash",
+};
+
+static chash_t *
+get_chash(Term t, const char *msg)
+{
+  Atom at;
+  chash_t *map;
+
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, msg);
+    return NULL;
+  }
+  if (!IsAtomTerm(t) || !IsBlob(at = AtomOfTerm(t)) ||
+      RepBlobProp(RepAtom(at)->PropsOfAE)->blob_type != &PL_Concurrent_Hash) {
+    Yap_Error(DOMAIN_ERROR_GENERIC_ARGUMENT, t, msg);
+    return NULL;
+  }
+  memcpy(&map, RepAtom(at)->rep.blob[0].data, sizeof(map));
+  if (map->dead) {
+    Yap_Error(EXISTENCE_ERROR_KEY, t, msg);
+    return NULL;
+  }
+  return map;
+}
+
+static uint64_t
+chash_bytes(const unsigned char *s, size_t len)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  size_t i;
+
+  for (i = 0; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, s+i, 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  for (; i < len; i++)
+    h = (h ^ s[i]) * 0x100000001b3ULL;
+  h ^= h >> 29;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+/* serialize a term with fast_write/2's format */
+static unsigned char *
+chash_term(Term t, size_t *lenp, int ground, UInt arity, const char *msg)
+{
+  t = Deref(t);
+  if (ground && !Yap_IsGroundTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, msg);
+    return NULL;
+  }
+  return Yap_FastTermToBuffer(t, lenp, arity);
+}
+
+/* rebuild a term from what chash_term() stored */
+static Term
+chash_unterm(const unsigned char *s, size_t len, UInt arity)
+{
+  size_t i = 4;
+
+  /* skip the magic, the version and the size */
+  while (i < len && (s[i] & 0x80))
+    i++;
+  i++;
+  return Yap_FastTermFromBuffer(s+i, len-i, arity);
+}
+
+static inline bool
+entry_has_key(chash_entry *e, uint64_t h, const unsigned char *k, size_t klen)
+{
+  return e->hash == h && e->klen == klen && !memcmp(e->data, k, klen);
+}
+
+static chash_entry *
+new_entry(uint64_t h, const unsigned char *k, size_t klen,
+	  const unsigned char *v, size_t vlen)
+{
+  chash_entry *e = malloc(sizeof(chash_entry) + klen + vlen);
+
+  if (!e)
+    return NULL;
+  e->next = NULL;
+  e->hash = h;
+  e->klen = klen;
+  e->vlen = vlen;
+  memcpy(e->data, k, klen);
+  memcpy(e->data+klen, v, vlen);
+  return e;
+}
+
+static void
+free_entries(chash_entry *e)
+{
+  chash_entry *next;
+
+  for (; e; e = next) {
+    next = e->next;
+    free(e);
+  }
+}
+
+/* a reader does not take the lock, it just counts itself in */
+static inline int
+enter_stripe(chash_stripe *s)
+{
+  int phase = CHASH_LOAD(s->phase);
+
+  CHASH_ADD(s->readers[phase], 1);
+  return phase;
+}
+
+static inline void
+leave_stripe(chash_stripe *s, int phase)
+{
+  CHASH_ADD(s->readers[phase], -1);
+}
+
+/* called with the stripe locked, after unlinking e */
+static void
+retire_entry(chash_stripe *s, chash_entry *e)
+{
+  int i;
+
+  e->next = s->retired[s->phase];
+  s->retired[s->phase] = e;
+  /* twice, so that a stripe without readers is emptied at once */
+  for (i = 0; i < 2; i++) {
+    int old = 1 - s->phase;
+
+    if (CHASH_LOAD(s->readers[old]))
+      break;
+    free_entries(s->retired[old]);
+    s->retired[old] = NULL;
+    CHASH_STORE(s->phase, old);
+  }
+}
+
+static Int
+new_chash(size_t want USES_REGS)
+{
+  size_t nb = CHASH_STRIPES, i;
+  chash_t *map;
+  AtomEntry *ae;
+
+  while (nb < want && nb < ((size_t)1 << 30))
+    nb *= 2;
+  if (!(map = calloc(1, sizeof(chash_t))) ||
+      !(map->buckets = calloc(nb, sizeof(chash_entry *)))) {
+    free(map);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "chash_new/2");
+    return FALSE;
+  }
+  map->mask = nb-1;
+  for (i = 0; i < CHASH_STRIPES; i++)
+    INIT_LOCK(map->stripes[i].lock);
+  if (!(ae = Yap_lookupBlob(&map, sizeof(map), &PL_Concurrent_Hash, NULL))) {
+    free(map->buckets);
+    free(map);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "chash_new/2");
+    return FALSE;
+  }
+  return Yap_unify(ARG1, MkAtomTerm(AbsAtom(ae)));
+}
+
+/** @pred chash_new(- _Map_)
+
+Create a new concurrent hash map, with room for about 16000 keys
+before chains start growing.
+*/
+static Int
+p_chash_new( USES_REGS1 )
+{
+  return new_chash(CHASH_DEFAULT_BUCKETS PASS_REGS);
+}
+
+/** @pred chash_new(- _Map_, + _Buckets_)
+
+Create a new concurrent hash map with at least _Buckets_ buckets. The
+table does not grow, so _Buckets_ should be close to the number of keys
+expected.
+*/
+static Int
+p_chash_new2( USES_REGS1 )
+{
+  Term tb = Deref(ARG2);
+
+  if (IsVarTerm(tb)) {
+    Yap_Error(INSTANTIATION_ERROR, tb, "chash_new/2");
+    return FALSE;
+  }
+  if (!IsIntegerTerm(tb)) {
+    Yap_Error(TYPE_ERROR_INTEGER, tb, "chash_new/2");
+    return FALSE;
+  }
+  return new_chash(IntegerOfTerm(tb) > 0 ? IntegerOfTerm(tb) : 0 PASS_REGS);
+}
+
+/** @pred chash_put(+ _Map_, + _Key_, + _Value_)
+
+Set the value of the ground term _Key_ to a copy of _Value_.
+*/
+static Int
+p_chash_put( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_put/3");
+  unsigned char *k, *v;
+  size_t klen, vlen;
+  chash_entry *e, *ne, **pp;
+  chash_stripe *s;
+  uint64_t h;
+
+  if (!map)
+    return FALSE;
+  if (!(k = chash_term(ARG2, &klen, TRUE, 3, "chash_put/3")))
+    return FALSE;
+  if (!(v = chash_term(ARG3, &vlen, FALSE, 3, "chash_put/3"))) {
+    free(k);
+    return FALSE;
+  }
+  h = chash_bytes(k, klen);
+  ne = new_entry(h, k, klen, v, vlen);
+  free(k);
+  free(v);
+  if (!ne) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "chash_put/3");
+    return FALSE;
+  }
+  s = map->stripes + (h & (CHASH_STRIPES-1));
+  LOCK(s->lock);
+  if (!map->buckets) {
+    UNLOCK(s->lock);
+    free(ne);
+    Yap_Error(EXISTENCE_ERROR_KEY, ARG1, "chash_put/3");
+    return FALSE;
+  }
+  pp = map->buckets + (h & map->mask);
+  for (e = *pp; e; pp = &e->next, e = *pp)
+    if (entry_has_key(e, h, ne->data, ne->klen))
+      break;
+  if (e) {
+    ne->next = e->next;
+    CHASH_STORE(*pp, ne);
+    retire_entry(s, e);
+  } else {
+    ne->next = map->buckets[h & map->mask];
+    CHASH_STORE(map->buckets[h & map->mask], ne);
+    CHASH_ADD(map->size, 1);
+  }
+  UNLOCK(s->lock);
+  return TRUE;
+}
+
+/* copy the value of a key, without taking any lock */
+static unsigned char *
+chash_lookup(chash_t *map, const unsigned char *k, size_t klen, size_t *vlenp)
+{
+  uint64_t h = chash_bytes(k, klen);
+  chash_stripe *s = map->stripes + (h & (CHASH_STRIPES-1));
+  unsigned char *v = NULL;
+  chash_entry **buckets, *e = NULL;
+  int phase = enter_stripe(s);
+
+  /* chash_destroy/1 clears the table before it waits for the readers */
+  if ((buckets = CHASH_LOAD(map->buckets)))
+    e = CHASH_LOAD(buckets[h & map->mask]);
+  for (; e; e = CHASH_LOAD(e->next)) {
+    if (entry_has_key(e, h, k, klen)) {
+      if ((v = malloc(e->vlen))) {
+	memcpy(v, e->data+e->klen, e->vlen);
+	*vlenp = e->vlen;
+      }
+      break;
+    }
+  }
+  leave_stripe(s, phase);
+  return v;
+}
+
+/** @pred chash_get(+ _Map_, + _Key_, - _Value_)
+
+Unify _Value_ with a copy of the value of _Key_, or fail if _Key_ is
+not in the map. Never waits for other threads.
+*/
+static Int
+p_chash_get( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_get/3");
+  unsigned char *k, *v;
+  size_t klen, vlen;
+  Term t;
+
+  if (!map)
+    return FALSE;
+  if (!(k = chash_term(ARG2, &klen, TRUE, 3, "chash_get/3")))
+    return FALSE;
+  v = chash_lookup(map, k, klen, &vlen);
+  free(k);
+  if (!v)
+    return FALSE;
+  t = chash_unterm(v, vlen, 3);
+  free(v);
+  return t && Yap_unify(ARG3, t);
+}
+
+/** @pred chash_update(+ _Map_, + _Key_, + _Old_, + _New_)
+
+Atomically replace the value of _Key_ by _New_, if the current value
+is a variant of _Old_; fail otherwise, or if _Key_ is not in the map.
+Counters and other read-modify-write updates retry until they succeed:
+
+~~~~~{.prolog}
+incr(M, K) :-
+	chash_get(M, K, N0),
+	N is N0+1,
+	( chash_update(M, K, N0, N) -> true ; incr(M, K) ).
+~~~~~
+*/
+static Int
+p_chash_update( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_update/4");
+  unsigned char *k, *o, *v;
+  size_t klen, olen, vlen;
+  chash_entry *e, *ne, **pp;
+  chash_stripe *s;
+  uint64_t h;
+  Int rc = FALSE;
+
+  if (!map)
+    return FALSE;
+  if (!(k = chash_term(ARG2, &klen, TRUE, 4, "chash_update/4")))
+    return FALSE;
+  if (!(o = chash_term(ARG3, &olen, FALSE, 4, "chash_update/4"))) {
+    free(k);
+    return FALSE;
+  }
+  if (!(v = chash_term(ARG4, &vlen, FALSE, 4, "chash_update/4"))) {
+    free(k);
+    free(o);
+    return FALSE;
+  }
+  h = chash_bytes(k, klen);
+  if (!(ne = new_entry(h, k, klen, v, vlen))) {
+    free(k);
+    free(o);
+    free(v);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "chash_update/4");
+    return FALSE;
+  }
+  s = map->stripes + (h & (CHASH_STRIPES-1));
+  LOCK(s->lock);
+  if (!map->buckets) {
+    UNLOCK(s->lock);
+    free(ne);
+    free(k);
+    free(o);
+    free(v);
+    Yap_Error(EXISTENCE_ERROR_KEY, ARG1, "chash_update/4");
+    return FALSE;
+  }
+  pp = map->buckets + (h & map->mask);
+  for (e = *pp; e; pp = &e->next, e = *pp)
+    if (entry_has_key(e, h, k, klen))
+      break;
+  if (e && e->vlen == olen && !memcmp(e->data+e->klen, o, olen)) {
+    ne->next = e->next;
+    CHASH_STORE(*pp, ne);
+    retire_entry(s, e);
+    rc = TRUE;
+  }
+  UNLOCK(s->lock);
+  if (!rc)
+    free(ne);
+  free(k);
+  free(o);
+  free(v);
+  return rc;
+}
+
+/** @pred chash_delete(+ _Map_, + _Key_)
+
+Remove _Key_ from the map. Fails if _Key_ is not there.
+*/
+static Int
+p_chash_delete( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_delete/2");
+  unsigned char *k;
+  size_t klen;
+  chash_entry *e, **pp;
+  chash_stripe *s;
+  uint64_t h;
+
+  if (!map)
+    return FALSE;
+  if (!(k = chash_term(ARG2, &klen, TRUE, 2, "chash_delete/2")))
+    return FALSE;
+  h = chash_bytes(k, klen);
+  s = map->stripes + (h & (CHASH_STRIPES-1));
+  LOCK(s->lock);
+  if (!map->buckets) {
+    UNLOCK(s->lock);
+    free(k);
+    Yap_Error(EXISTENCE_ERROR_KEY, ARG1, "chash_delete/2");
+    return FALSE;
+  }
+  pp = map->buckets + (h & map->mask);
+  for (e = *pp; e; pp = &e->next, e = *pp)
+    if (entry_has_key(e, h, k, klen))
+      break;
+  if (e) {
+    CHASH_STORE(*pp, e->next);
+    CHASH_ADD(map->size, -1);
+    retire_entry(s, e);
+  }
+  UNLOCK(s->lock);
+  free(k);
+  return e != NULL;
+}
+
+/** @pred chash_size(+ _Map_, - _Size_)
+
+_Size_ is the number of keys in the map.
+*/
+static Int
+p_chash_size( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_size/2");
+
+  if (!map)
+    return FALSE;
+  return Yap_unify(ARG2, MkIntegerTerm(CHASH_LOAD(map->size)));
+}
+
+/** @pred chash_pairs(+ _Map_, - _Pairs_)
+
+Unify _Pairs_ with a list of _Key_-_Value_ with the contents of the
+map. Each bucket is copied without locks, so updates made while the
+list is built may or may not show up in it.
+*/
+static Int
+p_chash_pairs( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_pairs/2");
+  chash_entry *snap = NULL, **buckets, *e = NULL, *ce;
+  size_t b;
+  int i;
+
+  if (!map)
+    return FALSE;
+  /* bucket b belongs to stripe b & (CHASH_STRIPES-1) */
+  for (i = 0; i < CHASH_STRIPES; i++) {
+    chash_stripe *s = map->stripes + i;
+    int phase = enter_stripe(s);
+
+    if ((buckets = CHASH_LOAD(map->buckets))) {
+      for (b = i; b <= map->mask; b += CHASH_STRIPES) {
+	for (e = CHASH_LOAD(buckets[b]); e; e = CHASH_LOAD(e->next)) {
+	  if (!(ce = new_entry(e->hash, e->data, e->klen,
+			       e->data+e->klen, e->vlen)))
+	    break;
+	  ce->next = snap;
+	  snap = ce;
+	}
+	if (e)
+	  break;
+      }
+    }
+    leave_stripe(s, phase);
+    if (e) {
+      while ((e = snap)) {
+	snap = e->next;
+	free(e);
+      }
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "chash_pairs/2");
+      return FALSE;
+    }
+  }
+  /* the list, and then each key, must survive garbage collection */
+  XREGS[3] = TermNil;
+  while ((e = snap)) {
+    Term ts[2];
+
+    snap = e->next;
+    if (!(ts[0] = chash_unterm(e->data, e->klen, 3)))
+      break;
+    XREGS[4] = ts[0];
+    if (!(ts[1] = chash_unterm(e->data+e->klen, e->vlen, 4)))
+      break;
+    ts[0] = XREGS[4];
+    XREGS[3] = MkPairTerm(Yap_MkApplTerm(FunctorMinus, 2, ts), XREGS[3]);
+    free(e);
+  }
+  if (e) {
+    while ((e = snap)) {
+      snap = e->next;
+      free(e);
+    }
+    return FALSE;
+  }
+  return Yap_unify(ARG2, XREGS[3]);
+}
+
+/*
+  free the keys and values; the map itself goes with its blob. The
+  table is unlinked with every stripe locked, so that no writer can
+  still be using it, and freed once the readers that may have loaded
+  it before have all left. Returns FALSE if the map was already freed.
+*/
+static int
+free_chash(chash_t *map)
+{
+  chash_entry **buckets;
+  size_t b;
+  int i;
+
+  for (i = 0; i < CHASH_STRIPES; i++)
+    LOCK(map->stripes[i].lock);
+  if (!(buckets = map->buckets)) {
+    for (i = 0; i < CHASH_STRIPES; i++)
+      UNLOCK(map->stripes[i].lock);
+    return FALSE;
+  }
+  map->dead = TRUE;
+  CHASH_STORE(map->buckets, NULL);
+  for (i = 0; i < CHASH_STRIPES; i++) {
+    chash_stripe *s = map->stripes + i;
+
+    while (CHASH_LOAD(s->readers[0]) || CHASH_LOAD(s->readers[1]))
+      ;
+  }
+  for (b = 0; b <= map->mask; b++)
+    free_entries(buckets[b]);
+  free(buckets);
+  for (i = 0; i < CHASH_STRIPES; i++) {
+    chash_stripe *s = map->stripes + i;
+
+    free_entries(s->retired[0]);
+    free_entries(s->retired[1]);
+    s->retired[0] = s->retired[1] = NULL;
+  }
+  map->size = 0;
+  for (i = 0; i < CHASH_STRIPES; i++)
+    UNLOCK(map->stripes[i].lock);
+  return TRUE;
+}
+
+/*
+  called by the atom garbage collector, once no term refers to the
+  map. The collector only runs in builds without threads.
+*/
+void
+Yap_CHashRelease(Atom at)
+{
+  chash_t *map;
+
+  if (RepBlobProp(RepAtom(at)->PropsOfAE)->blob_type != &PL_Concurrent_Hash)
+    return;
+  memcpy(&map, RepAtom(at)->rep.blob[0].data, sizeof(map));
+  free_chash(map);
+  free(map);
+}
+
+/** @pred chash_destroy(+ _Map_)
+
+Release all the memory used by _Map_ now, instead of when the atom
+garbage collector finds that _Map_ is no longer used. In builds with
+threads the atom garbage collector does not run, and this is the only
+way to free a map.
+
+Other threads may still be looking up keys: chash_destroy/1 waits
+until they are done before it frees the entries. Later calls on _Map_
+raise an existence error.
+*/
+static Int
+p_chash_destroy( USES_REGS1 )
+{
+  chash_t *map = get_chash(Deref(ARG1), "chash_destroy/1");
+
+  if (!map)
+    return FALSE;
+  if (!free_chash(map)) {
+    Yap_Error(EXISTENCE_ERROR_KEY, ARG1, "chash_destroy/1");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+void
+Yap_InitCHashPreds(void)
+{
+  Yap_InitCPred("chash_new", 1, p_chash_new, SafePredFlag);
+  Yap_InitCPred("chash_new", 2, p_chash_new2, SafePredFlag);
+  Yap_InitCPred("chash_put", 3, p_chash_put, SafePredFlag);
+  Yap_InitCPred("chash_get", 3, p_chash_get, SafePredFlag);
+  Yap_InitCPred("chash_update", 4, p_chash_update, SafePredFlag);
+  Yap_InitCPred("chash_delete", 2, p_chash_delete, SafePredFlag);
+  Yap_InitCPred("chash_size", 2, p_chash_size, SafePredFlag);
+  Yap_InitCPred("chash_pairs", 2, p_chash_pairs, SafePredFlag);
+  Yap_InitCPred("chash_destroy", 1, p_chash_destroy, SafePredFlag);
+}
+
+/**
+@}
+*/
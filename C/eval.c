@@ -93,6 +93,192 @@ get_matrix_element(Term t1, Term t2 USES_REGS)
   return Eval(t1 PASS_REGS);
 }
 
+/*
+  Fast path for expressions made of the common integer and float
+  operations. Intermediate results stay in C variables instead of
+  being boxed on the global stack, and only the final result becomes
+  a term. Anything else, including integer overflow, errors and deep
+  or cyclic terms, makes FastEval give up, and Eval starts again.
+*/
+typedef struct {
+  bool isfloat;
+  union {
+    Int i;
+    Float f;
+  } v;
+} unboxed_num;
+
+#define MAX_FAST_EVAL_DEPTH 256
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define FAST_INT_OPS 1
+#endif
+
+static inline Float
+unboxed_float(unboxed_num *n)
+{
+  return (n->isfloat ? n->v.f : (Float)n->v.i);
+}
+
+static bool
+unbox_number(Term t, unboxed_num *out)
+{
+  if (IsIntTerm(t)) {
+    out->isfloat = false;
+    out->v.i = IntOfTerm(t);
+    return true;
+  }
+  if (IsApplTerm(t)) {
+    Functor f = FunctorOfTerm(t);
+    if (f == FunctorDouble) {
+      out->isfloat = true;
+      out->v.f = FloatOfTerm(t);
+      return true;
+    }
+    if (f == FunctorLongInt) {
+      out->isfloat = false;
+      out->v.i = LongIntOfTerm(t);
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+FastEval(Term t, unboxed_num *out, int depth USES_REGS)
+{
+  Functor fun;
+  Int n;
+  ExpEntry *p;
+  unboxed_num a1, a2;
+
+  if (IsVarTerm(t))
+    return false;
+  if (unbox_number(t, out))
+    return true;
+  if (IsAtomTerm(t)) {
+    /* only constants: random or cputime must not be evaluated twice */
+    if (EndOfPAEntr(p = RepExpProp(Yap_GetExpProp(AtomOfTerm(t), 0))))
+      return false;
+    switch (p->FOfEE) {
+    case op_inf:
+    case op_nan:
+      /* not evaluable in ISO mode, let the evaluator raise the error */
+      if (isoLanguageFlag())
+	return false;
+    case op_pi:
+    case op_e:
+    case op_epsilon:
+      return unbox_number(Yap_eval_atom(p->FOfEE), out);
+    default:
+      return false;
+    }
+  }
+  if (!IsApplTerm(t) || depth > MAX_FAST_EVAL_DEPTH)
+    return false;
+  fun = FunctorOfTerm(t);
+  if (IsExtensionFunctor(fun) || (Atom)fun == AtomFoundVar)
+    return false;
+  n = ArityOfFunctor(fun);
+  if (n > 2 ||
+      EndOfPAEntr(p = RepExpProp(Yap_GetExpProp(NameOfFunctor(fun), n))))
+    return false;
+  if (!FastEval(ArgOfTerm(1, t), &a1, depth + 1 PASS_REGS))
+    return false;
+  if (n == 1) {
+    switch (p->FOfEE) {
+    case op_uminus:
+      if (a1.isfloat) {
+	a1.v.f = -a1.v.f;
+      } else {
+	if (a1.v.i == Int_MIN)
+	  return false;
+	a1.v.i = -a1.v.i;
+      }
+      *out = a1;
+      return true;
+    case op_abs:
+      if (a1.isfloat) {
+	a1.v.f = fabs(a1.v.f);
+      } else {
+	if (a1.v.i == Int_MIN)
+	  return false;
+	a1.v.i = (a1.v.i < 0 ? -a1.v.i : a1.v.i);
+      }
+      *out = a1;
+      return true;
+    case op_float:
+      out->isfloat = true;
+      out->v.f = unboxed_float(&a1);
+      return true;
+    case op_exp:
+      out->isfloat = true;
+      out->v.f = exp(unboxed_float(&a1));
+      return true;
+    case op_log:
+      if (!(unboxed_float(&a1) >= 0))
+	return false;
+      out->isfloat = true;
+      out->v.f = log(unboxed_float(&a1));
+      return true;
+    case op_sqrt:
+      out->isfloat = true;
+      out->v.f = sqrt(unboxed_float(&a1));
+      return !isnan(out->v.f);
+    case op_sin:
+      out->isfloat = true;
+      out->v.f = sin(unboxed_float(&a1));
+      return true;
+    case op_cos:
+      out->isfloat = true;
+      out->v.f = cos(unboxed_float(&a1));
+      return true;
+    default:
+      return false;
+    }
+  }
+  switch (p->FOfEE) {
+  case op_plus:
+  case op_minus:
+  case op_times:
+  case op_fdiv:
+    break;
+  default:
+    return false;
+  }
+  if (!FastEval(ArgOfTerm(2, t), &a2, depth + 1 PASS_REGS))
+    return false;
+  if (p->FOfEE == op_fdiv) {
+    out->isfloat = true;
+    out->v.f = unboxed_float(&a1) / unboxed_float(&a2);
+    return true;
+  }
+  if (a1.isfloat || a2.isfloat) {
+    Float f1 = unboxed_float(&a1), f2 = unboxed_float(&a2);
+
+    out->isfloat = true;
+    if (p->FOfEE == op_plus)
+      out->v.f = f1 + f2;
+    else if (p->FOfEE == op_minus)
+      out->v.f = f1 - f2;
+    else
+      out->v.f = f1 * f2;
+    return true;
+  }
+#if FAST_INT_OPS
+  out->isfloat = false;
+  /* overflow needs a bignum, so leave it to Eval */
+  if (p->FOfEE == op_plus)
+    return !__builtin_add_overflow(a1.v.i, a2.v.i, &out->v.i);
+  else if (p->FOfEE == op_minus)
+    return !__builtin_sub_overflow(a1.v.i, a2.v.i, &out->v.i);
+  else
+    return !__builtin_mul_overflow(a1.v.i, a2.v.i, &out->v.i);
+#else
+  return false;
+#endif
+}
+
 static Term
 Eval(Term t USES_REGS)
 {
@@ -167,6 +353,13 @@ Eval(Term t USES_REGS)
 Term
 Yap_InnerEval__(Term t USES_REGS)
 {
+  unboxed_num out;
+
+  if (IsApplTerm(t) && FastEval(t, &out, 0 PASS_REGS)) {
+    if (out.isfloat)
+      return MkFloatTerm(out.v.f);
+    return MkIntegerTerm(out.v.i);
+  }
   return Eval(t PASS_REGS);
 }
 
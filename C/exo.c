@@ -38,6 +38,12 @@
 #if HAVE_STDBOOL_H
 #include <stdbool.h>
 #endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 bool YAP_NewExo( PredEntry *ap, size_t data, struct udi_info *udi);
 bool YAP_AssertTuples( PredEntry *pe, const Term *ts, size_t offset, size_t m);
@@ -774,6 +780,408 @@ p_exoassert( USES_REGS1 )
   return TRUE;
 }
 
+/* bulk loading of rows of atomic fields: the file is read in one go and
+   split in chunks of whole lines; a thread per chunk counts the rows and
+   then splits them into fields, converting the integers. Atoms must be
+   interned by the main thread, as the symbol table is not thread-safe
+   outside the multi-threaded system */
+
+#define MAX_LOAD_THREADS 64
+#define MIN_LOAD_CHUNK   (1024*1024)
+#define NO_QUOTE         256
+
+struct rows_chunk {
+  char *start, *end;        /* the lines in the chunk */
+  const char *name;         /* functor name, for files of facts */
+  size_t name_len;
+  UInt arity;
+  int sep, quote;
+  bool facts;
+  UInt first_row, nrows;
+  CELL *cells;              /* integers, or the text of future atoms */
+  char *pending;            /* which cells must become atoms */
+  UInt bad_row;             /* first row we could not parse, 0 if none */
+  const char *bad_msg;
+};
+
+static bool
+skip_row(struct rows_chunk *c, char *s, char *eol)
+{
+  if (eol > s && eol[-1] == '\r')
+    eol--;
+  if (c->facts) {
+    while (s < eol && (*s == ' ' || *s == '\t'))
+      s++;
+    return s == eol || *s == '%';
+  }
+  return s == eol;
+}
+
+static bool
+row_int(const char *s, CELL *cp)
+{
+  Int v = 0;
+  bool neg = false;
+
+  if (*s == '-') {
+    neg = true;
+    s++;
+  }
+  if (*s < '0' || *s > '9')
+    return false;
+  while (*s >= '0' && *s <= '9') {
+    if (v >= MAX_ABS_INT)
+      return false;
+    v = v*10 + (*s++ - '0');
+  }
+  if (*s)
+    return false;
+  if (neg)
+    v = -v;
+  if (!IntInBnd(v))
+    return false;
+  *cp = MkIntTerm(v);
+  return true;
+}
+
+static bool
+row_plain_atom(const char *s)
+{
+  if (*s < 'a' || *s > 'z')
+    return false;
+  while (*++s)
+    if (!((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z') ||
+          (*s >= '0' && *s <= '9') || *s == '_'))
+      return false;
+  return true;
+}
+
+static const char *
+parse_row(struct rows_chunk *c, char *s, char *eol, CELL *cells, char *pending)
+{
+  UInt i;
+
+  if (eol > s && eol[-1] == '\r')
+    eol--;
+  if (c->facts) {
+    while (*s == ' ' || *s == '\t')
+      s++;
+    while (eol > s && (eol[-1] == ' ' || eol[-1] == '\t'))
+      eol--;
+    if (eol > s && eol[-1] == '.')
+      eol--;
+    else
+      return "missing full stop";
+    while (eol > s && (eol[-1] == ' ' || eol[-1] == '\t'))
+      eol--;
+    if ((size_t)(eol-s) < c->name_len+2 || strncmp(s, c->name, c->name_len) ||
+        s[c->name_len] != '(' || eol[-1] != ')')
+      return "not a fact for the predicate";
+    s += c->name_len+1;
+    eol--;
+  }
+  for (i = 0; i < c->arity; i++) {
+    char *f, *out;
+    bool quoted = false;
+
+    if (c->facts)
+      while (s < eol && (*s == ' ' || *s == '\t'))
+        s++;
+    f = out = s;
+    if (s < eol && (unsigned char)*s == c->quote) {
+      quoted = true;
+      s++;
+      for (;;) {
+        if (s == eol)
+          return "unterminated quoted field";
+        if ((unsigned char)*s == c->quote) {
+          if (s+1 < eol && (unsigned char)s[1] == c->quote) {
+            *out++ = *s;
+            s += 2;
+            continue;
+          }
+          s++;
+          break;
+        }
+        if (c->facts && *s == '\\')
+          return "escape sequences are not supported";
+        *out++ = *s++;
+      }
+      if (c->facts)
+        while (s < eol && (*s == ' ' || *s == '\t'))
+          s++;
+    } else {
+      while (s < eol && *s != c->sep)
+        s++;
+      out = s;
+      if (c->facts)
+        while (out > f && (out[-1] == ' ' || out[-1] == '\t'))
+          out--;
+    }
+    if (i+1 < c->arity) {
+      if (s == eol)
+        return "too few fields";
+      if (*s != c->sep)
+        return "unexpected text after quoted field";
+    } else if (s != eol) {
+      return "too many fields";
+    }
+    *out = '\0';
+    if (!quoted && row_int(f, cells+i)) {
+      pending[i] = FALSE;
+    } else {
+      if (c->facts && !quoted && !row_plain_atom(f))
+        return "fields must be integers or atoms";
+      cells[i] = (CELL)f;
+      pending[i] = TRUE;
+    }
+    s++;
+  }
+  return NULL;
+}
+
+static void *
+count_rows(void *arg)
+{
+  struct rows_chunk *c = (struct rows_chunk *)arg;
+  char *s = c->start, *eol;
+
+  c->nrows = 0;
+  while (s < c->end) {
+    if (!(eol = memchr(s, '\n', c->end-s)))
+      eol = c->end;
+    if (!skip_row(c, s, eol))
+      c->nrows++;
+    s = eol+1;
+  }
+  return NULL;
+}
+
+static void *
+parse_rows(void *arg)
+{
+  struct rows_chunk *c = (struct rows_chunk *)arg;
+  char *s = c->start, *eol;
+  CELL *cells = c->cells;
+  char *pending = c->pending;
+  UInt row = c->first_row;
+
+  while (s < c->end) {
+    if (!(eol = memchr(s, '\n', c->end-s)))
+      eol = c->end;
+    if (!skip_row(c, s, eol)) {
+      const char *msg = parse_row(c, s, eol, cells, pending);
+      if (msg) {
+        c->bad_row = row+1;
+        c->bad_msg = msg;
+        return NULL;
+      }
+      cells += c->arity;
+      pending += c->arity;
+      row++;
+    }
+    s = eol+1;
+  }
+  return NULL;
+}
+
+static void
+run_chunks(void *(*f)(void *), struct rows_chunk *c, int n)
+{
+  int i;
+#if HAVE_PTHREAD_H
+  pthread_t th[MAX_LOAD_THREADS];
+  bool started[MAX_LOAD_THREADS];
+
+  for (i = 1; i < n; i++)
+    started[i] = (pthread_create(th+i, NULL, f, c+i) == 0);
+  f(c);
+  for (i = 1; i < n; i++) {
+    if (started[i])
+      pthread_join(th[i], NULL);
+    else
+      f(c+i);
+  }
+#else
+  for (i = 0; i < n; i++)
+    f(c+i);
+#endif
+}
+
+static Int
+p_exo_load_rows( USES_REGS1 )
+{   /* exo_load_rows(+File,+Pred,+Mod,+Sep,+Quote,+Facts,+Threads,-Rows) */
+  Term tf = Deref(ARG1), t = Deref(ARG2), mod = Deref(ARG3);
+  Term tsep = Deref(ARG4), tquote = Deref(ARG5), tfacts = Deref(ARG6);
+  Term tthreads = Deref(ARG7);
+  struct rows_chunk chunks[MAX_LOAD_THREADS];
+  MegaClause *mcl;
+  Atom name, last_atom[MAX_ARITY];
+  char *buf, *last_text[MAX_ARITY];
+  CELL *cells, *ptr;
+  char *pending;
+  FILE *f;
+  long size;
+  UInt arity, nrows, i, j;
+  int nthreads;
+
+  if (!IsAtomTerm(tf) || !IsApplTerm(t) || !IsIntTerm(tsep) ||
+      !IsIntTerm(tquote) || !IsIntTerm(tthreads))
+    return FALSE;
+  name = NameOfFunctor(FunctorOfTerm(t));
+  arity = ArityOfFunctor(FunctorOfTerm(t));
+  if (arity > MAX_ARITY) {
+    Yap_Error(REPRESENTATION_ERROR_MAX_ARITY, t, "load_db_rows/3");
+    return FALSE;
+  }
+  if (!IsAtomTerm(mod))
+    return FALSE;
+  /* check now, rather than after reading the whole file */
+  if (RepPredProp(PredPropByFunc(FunctorOfTerm(t), mod))->PredFlags &
+      (DynamicPredFlag|LogUpdatePredFlag
+#ifdef TABLING
+       |TabledPredFlag
+#endif /* TABLING */
+       )) {
+    Yap_Error(PERMISSION_ERROR_MODIFY_STATIC_PROCEDURE, t, "load_db_rows/3");
+    return FALSE;
+  }
+  if (!(f = fopen(RepAtom(AtomOfTerm(tf))->StrOfAE, "rb"))) {
+    Yap_Error(EXISTENCE_ERROR_SOURCE_SINK, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  if (fseek(f, 0L, SEEK_END) < 0 || (size = ftell(f)) < 0 ||
+      fseek(f, 0L, SEEK_SET) < 0) {
+    fclose(f);
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  if (!(buf = malloc(size+1))) {
+    fclose(f);
+    Yap_Error(RESOURCE_ERROR_HEAP, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  if (fread(buf, 1, size, f) != (size_t)size) {
+    fclose(f);
+    free(buf);
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  fclose(f);
+  buf[size] = '\0';
+  /* split in chunks of whole lines */
+  nthreads = IntOfTerm(tthreads);
+  if (nthreads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (nthreads <= 0)
+      nthreads = 1;
+  }
+  if (nthreads > MAX_LOAD_THREADS)
+    nthreads = MAX_LOAD_THREADS;
+  if (nthreads > size/MIN_LOAD_CHUNK)
+    nthreads = size/MIN_LOAD_CHUNK+1;
+  for (i = 0; i < (UInt)nthreads; i++) {
+    struct rows_chunk *c = chunks+i;
+    c->start = (i == 0 ? buf : chunks[i-1].end);
+    if (i+1 == (UInt)nthreads) {
+      c->end = buf+size;
+    } else {
+      c->end = buf+(size/nthreads)*(i+1);
+      if (c->end < c->start)
+        c->end = c->start;
+      while (c->end < buf+size && c->end[-1] != '\n')
+        c->end++;
+    }
+    c->name = RepAtom(name)->StrOfAE;
+    c->name_len = strlen(c->name);
+    c->arity = arity;
+    c->sep = IntOfTerm(tsep);
+    c->quote = IntOfTerm(tquote) ? IntOfTerm(tquote) : NO_QUOTE;
+    c->facts = (tfacts == TermTrue);
+    c->bad_row = 0;
+  }
+  run_chunks(count_rows, chunks, nthreads);
+  for (nrows = 0, i = 0; i < (UInt)nthreads; i++) {
+    chunks[i].first_row = nrows;
+    nrows += chunks[i].nrows;
+  }
+  cells = malloc(nrows*arity*sizeof(CELL)+1);
+  pending = malloc(nrows*arity+1);
+  if (!cells || !pending) {
+    free(cells);
+    free(pending);
+    free(buf);
+    Yap_Error(RESOURCE_ERROR_HEAP, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  for (i = 0; i < (UInt)nthreads; i++) {
+    chunks[i].cells = cells+chunks[i].first_row*arity;
+    chunks[i].pending = pending+chunks[i].first_row*arity;
+  }
+  run_chunks(parse_rows, chunks, nthreads);
+  for (i = 0; i < (UInt)nthreads; i++) {
+    if (chunks[i].bad_row) {
+      UInt row = chunks[i].bad_row;
+      const char *msg = chunks[i].bad_msg;
+      free(cells);
+      free(pending);
+      free(buf);
+      Yap_Error(SYNTAX_ERROR, tf, "row %lu: %s", (unsigned long)row, msg);
+      return FALSE;
+    }
+  }
+  /* make the atoms first, so that a failure leaves the predicate alone */
+  for (j = 0; j < arity; j++)
+    last_text[j] = NULL;
+  for (i = 0; i < nrows; i++) {
+    for (j = 0; j < arity; j++) {
+      UInt k = i*arity+j;
+      if (pending[k]) {
+        char *txt = (char *)cells[k];
+        /* sorted or categorical columns repeat the same atom a lot */
+        if (!last_text[j] || strcmp(last_text[j], txt)) {
+          last_atom[j] = Yap_LookupAtom(txt);
+          last_text[j] = txt;
+        }
+        if (last_atom[j] == NIL) {
+          free(cells);
+          free(pending);
+          free(buf);
+          Yap_Error(RESOURCE_ERROR_HEAP, tf, "load_db_rows/3");
+          return FALSE;
+        }
+        cells[k] = MkAtomTerm(last_atom[j]);
+      }
+    }
+  }
+  free(pending);
+  free(buf);
+  if (nrows <= 1) {
+    /* too small for an exo clause: hand the row back in Pred, and let
+       load_db_rows/3 assert it */
+    for (j = 0; j < nrows*arity; j++) {
+      if (!Yap_unify(ArgOfTerm(j+1, t), cells[j])) {
+        free(cells);
+        return FALSE;
+      }
+    }
+    free(cells);
+    return Yap_unify(ARG8, MkIntegerTerm(nrows));
+  }
+  /* now we know the size */
+  if (!(mcl = exodb_get_space(t, mod, MkIntegerTerm(nrows)))) {
+    free(cells);
+    Yap_Error(RESOURCE_ERROR_HEAP, tf, "load_db_rows/3");
+    return FALSE;
+  }
+  ptr = (CELL *)((ADDR)mcl->ClCode+2*sizeof(struct index_t *));
+  memcpy(ptr, cells, nrows*arity*sizeof(CELL));
+  free(cells);
+  return Yap_unify(ARG8, MkIntegerTerm(nrows));
+}
+
 void
 Yap_InitExoPreds(void)
 {
@@ -783,5 +1191,6 @@ Yap_InitExoPreds(void)
   CurrentModule = DBLOAD_MODULE;
   Yap_InitCPred("exo_db_get_space", 4, p_exodb_get_space, 0L);
   Yap_InitCPred("exoassert", 3, p_exoassert, 0L);
+  Yap_InitCPred("exo_load_rows", 8, p_exo_load_rows, 0L);
   CurrentModule = cm;
 }
@@ -940,10 +940,63 @@ inline static GlobalEntry *GetGlobalEntry(Atom at USES_REGS)
   new->AtomOfGE = ae;
   AddPropToAtom(ae, (PropEntry *)new);
   RESET_VARIABLE(&new->global);
+  new->SizeOfGE = 0;
   WRITE_UNLOCK(ae->ARWLock);
   return new;
 }
 
+/* how many cells of the arena the fresh copy to takes */
+static UInt GlobalValueSize(Term to USES_REGS) {
+  CELL *pt;
+
+  if (IsVarTerm(to) || IsAtomOrIntTerm(to))
+    return 0;
+  if (IsPairTerm(to)) {
+    pt = RepPair(to);
+  } else {
+    if (FunctorOfTerm(to) == FunctorDBRef)
+      return 0;
+    pt = RepAppl(to);
+  }
+  /* variables may be bound or attributed from outside */
+  if (pt < H0 || pt >= ArenaPt(LOCAL_GlobalArena) || !Yap_IsGroundTerm(to))
+    return 0;
+  return ArenaPt(LOCAL_GlobalArena) - pt;
+}
+
+/*
+  nb_setval/2 copies each new value to the start of the free arena. If
+  the old value was the last thing copied there, and nobody read it
+  since, then nothing can point to its cells. Once the new value is
+  safely in the arena, just above the old one, copy it again over the
+  old cells and give both back but for the second copy. The second copy
+  fits in space the first one already used, so it cannot grow the
+  arena; if it fails anyway, the first copy stays.
+*/
+static Term ReuseGlobalCells(GlobalEntry *ge, Term to USES_REGS) {
+  Term t = ge->global, arena = LOCAL_GlobalArena, tn;
+  UInt sz = ge->SizeOfGE, nsz;
+  CELL *pt;
+
+  if (!sz || IsVarTerm(t) || IsAtomOrIntTerm(t))
+    return to;
+  nsz = GlobalValueSize(to PASS_REGS);
+  if (!nsz || nsz > sz)
+    return to;
+  pt = (IsPairTerm(t) ? RepPair(t) : RepAppl(t));
+  if (pt + sz != (IsPairTerm(to) ? RepPair(to) : RepAppl(to)))
+    return to;
+  LOCAL_GlobalArena = CreateNewArena(pt, ArenaSz(arena) + sz + nsz);
+  tn = CopyTermToArena(to, LOCAL_GlobalArena, FALSE, TRUE, 2,
+                       &LOCAL_GlobalArena, 0 PASS_REGS);
+  if (tn == 0L) {
+    /* the arena header above the first copy was not touched */
+    LOCAL_GlobalArena = arena;
+    return to;
+  }
+  return tn;
+}
+
 static UInt garena_overflow_size(CELL *arena USES_REGS) {
   UInt dup = (((CELL *)arena - H0) * sizeof(CELL)) >> 3;
   if (dup < 64 * 1024 * LOCAL_GlobalArenaOverflows)
@@ -1090,6 +1143,7 @@ static Int p_nb_linkval(USES_REGS1) {
   to = Deref(ARG2);
   WRITE_LOCK(ge->GRWLock);
   ge->global = to;
+  ge->SizeOfGE = 0;
   WRITE_UNLOCK(ge->GRWLock);
   return TRUE;
 }
@@ -1232,10 +1286,13 @@ Term Yap_SetGlobalVal(Atom at, Term t0) {
   to = CopyTermToArena(
       t0, LOCAL_GlobalArena, FALSE, TRUE, 2, &LOCAL_GlobalArena,
       garena_overflow_size(ArenaPt(LOCAL_GlobalArena) PASS_REGS) PASS_REGS);
+  /* on failure the global keeps its old value */
   if (to == 0L)
     return to;
   WRITE_LOCK(ge->GRWLock);
+  to = ReuseGlobalCells(ge, to PASS_REGS);
   ge->global = to;
+  ge->SizeOfGE = GlobalValueSize(to PASS_REGS);
   WRITE_UNLOCK(ge->GRWLock);
   return to;
 }
@@ -1281,6 +1338,7 @@ static Int p_nb_set_shared_val(USES_REGS1) {
     return FALSE;
   WRITE_LOCK(ge->GRWLock);
   ge->global = to;
+  ge->SizeOfGE = 0;
   WRITE_UNLOCK(ge->GRWLock);
   return TRUE;
 }
@@ -1309,6 +1367,7 @@ static Int p_b_setval(USES_REGS1) {
       t = tn;
     }
     MaBind(&ge->global, t);
+    ge->SizeOfGE = 0;
   }
   WRITE_UNLOCK(ge->GRWLock);
   return TRUE;
@@ -1344,14 +1403,17 @@ static Int p_nb_getval(USES_REGS1) {
   ge = FindGlobalEntry(AtomOfTerm(t) PASS_REGS);
   if (!ge)
     return undefined_global(PASS_REGS1);
-  READ_LOCK(ge->GRWLock);
+  /* a write lock: reading the value clears SizeOfGE, and may bind it */
+  WRITE_LOCK(ge->GRWLock);
   to = ge->global;
+  /* the value is now visible to the caller */
+  ge->SizeOfGE = 0;
   if (IsVarTerm(to) && IsUnboundVar(VarOfTerm(to))) {
     Term t = MkVarTerm();
     YapBind(VarOfTerm(to), t);
     to = t;
   }
-  READ_UNLOCK(ge->GRWLock);
+  WRITE_UNLOCK(ge->GRWLock);
   if (to == TermFoundVar) {
     return FALSE;
   }
@@ -1366,14 +1428,17 @@ Term Yap_GetGlobal(Atom at) {
   ge = FindGlobalEntry(at PASS_REGS);
   if (!ge)
     return 0L;
-  READ_LOCK(ge->GRWLock);
+  /* a write lock: reading the value clears SizeOfGE, and may bind it */
+  WRITE_LOCK(ge->GRWLock);
   to = ge->global;
+  /* the value is now visible to the caller */
+  ge->SizeOfGE = 0;
   if (IsVarTerm(to) && IsUnboundVar(VarOfTerm(to))) {
     Term t = MkVarTerm();
     YapBind(VarOfTerm(to), t);
     to = t;
   }
-  READ_UNLOCK(ge->GRWLock);
+  WRITE_UNLOCK(ge->GRWLock);
   if (to == TermFoundVar) {
     return 0;
   }
@@ -1475,6 +1540,7 @@ static Int p_nb_create(USES_REGS1) {
     return FALSE;
   WRITE_LOCK(ge->GRWLock);
   ge->global = to;
+  ge->SizeOfGE = 0;
   WRITE_UNLOCK(ge->GRWLock);
   return TRUE;
 }
@@ -1527,6 +1593,7 @@ static Int p_nb_create2(USES_REGS1) {
     return FALSE;
   WRITE_LOCK(ge->GRWLock);
   ge->global = to;
+  ge->SizeOfGE = 0;
   WRITE_UNLOCK(ge->GRWLock);
   return TRUE;
 }
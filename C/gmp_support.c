@@ -48,10 +48,88 @@ MkRatAndClose(MP_RAT *new)
   return t;
 }
 
+#if defined(__SIZEOF_INT128__) && SIZEOF_INT_P == 8 && GMP_LIMB_BITS == 64
+#define USE_INT128_BIGS 1
+#endif
+
+#if USE_INT128_BIGS
+/*
+  Integers that need at most 127 bits are computed with the compiler's
+  128-bit arithmetic, and their bignums are laid out on the global
+  stack directly, so that GMP never allocates for them. GMP is only
+  called when a result does not fit.
+*/
+typedef __int128 Int128;
+typedef unsigned __int128 UInt128;
+
+/* the value of a bignum with at most two limbs */
+static inline int
+Int128OfBig(Term t, Int128 *out)
+{
+  CELL *pt = RepAppl(t);
+  MP_INT *b;
+  mp_limb_t *d;
+  UInt128 mag;
+  int n;
+
+  if (pt[1] != BIG_INT)
+    return FALSE;
+  b = (MP_INT *)(pt+2);
+  n = (b->_mp_size < 0 ? -b->_mp_size : b->_mp_size);
+  if (n > 2)
+    return FALSE;
+  d = (mp_limb_t *)(b+1);
+  mag = (n > 0 ? d[0] : 0);
+  if (n == 2)
+    mag |= (UInt128)d[1] << 64;
+  if (mag >> 127)
+    return FALSE;
+  *out = (b->_mp_size < 0 ? -(Int128)mag : (Int128)mag);
+  return TRUE;
+}
+
+/* same layout as Yap_MkBigIntTerm() */
+static Term
+MkInt128Term(Int128 v)
+{
+  CACHE_REGS
+  CELL *ret = HR;
+  MP_INT *dst;
+  mp_limb_t *d;
+  UInt128 mag;
+  int n;
+
+  if (v >= Int_MIN && v <= Int_MAX)
+    return MkIntegerTerm((Int)v);
+  if (ASP-HR < 1024) {
+    return Yap_ArithError(RESOURCE_ERROR_STACK, TermNil, "bignum");
+  }
+  mag = (v < 0 ? -(UInt128)v : (UInt128)v);
+  n = (mag >> 64 ? 2 : 1);
+  HR[0] = (CELL)FunctorBigInt;
+  HR[1] = BIG_INT;
+  dst = (MP_INT *)(HR+2);
+  dst->_mp_size = (v < 0 ? -n : n);
+  dst->_mp_alloc = n;
+  d = (mp_limb_t *)(dst+1);
+  d[0] = (mp_limb_t)mag;
+  if (n == 2)
+    d[1] = (mp_limb_t)(mag >> 64);
+  HR = (CELL *)(dst+1)+n;
+  HR[0] = EndSpecials;
+  HR++;
+  return AbsAppl(ret);
+}
+#endif
+
 /* add i + j using temporary bigint new */
 Term
 Yap_gmp_add_ints(Int i, Int j)
 {
+
+#if USE_INT128_BIGS
+  return MkInt128Term((Int128)i+j);
+#else
   MP_INT new;
 
   mpz_init_set_si(&new,i);
@@ -66,11 +144,15 @@ Yap_gmp_add_ints(Int i, Int j)
     }
   }
   return MkBigAndClose(&new);
+#endif
 }
 
 Term
 Yap_gmp_sub_ints(Int i, Int j)
 {
+#if USE_INT128_BIGS
+  return MkInt128Term((Int128)i-j);
+#else
   MP_INT new;
   Term t;
 
@@ -89,16 +171,22 @@ Yap_gmp_sub_ints(Int i, Int j)
   t = Yap_MkBigIntTerm(&new);
   mpz_clear(&new);
   return t;
+#endif
 }
 
 Term
 Yap_gmp_mul_ints(Int i, Int j)
 {
+
+#if USE_INT128_BIGS
+  return MkInt128Term((Int128)i*j);
+#else
   MP_INT new;
 
   mpz_init_set_si(&new,i);
   mpz_mul_si(&new, &new, j);
   return MkBigAndClose(&new);
+#endif
 }
 
 Term 
@@ -106,6 +194,10 @@ Yap_gmp_sll_ints(Int i, Int j)
 {
   MP_INT new;
 
+#if USE_INT128_BIGS
+  if (j >= 0 && j < 64)
+    return MkInt128Term((Int128)i*((Int128)1 << j));
+#endif
   mpz_init_set_si(&new,i);
   mpz_mul_2exp(&new, &new, j);
   return MkBigAndClose(&new);
@@ -116,6 +208,12 @@ Term
 Yap_gmp_add_int_big(Int i, Term t)
 {
   CELL *pt = RepAppl(t);
+#if USE_INT128_BIGS
+  Int128 v, r;
+
+  if (Int128OfBig(t, &v) && !__builtin_add_overflow((Int128)i, v, &r))
+    return MkInt128Term(r);
+#endif
   if (pt[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b = Yap_BigIntOfTerm(t);
@@ -145,6 +243,12 @@ Term
 Yap_gmp_sub_int_big(Int i, Term t)
 {
   CELL *pt = RepAppl(t);
+#if USE_INT128_BIGS
+  Int128 v, r;
+
+  if (Int128OfBig(t, &v) && !__builtin_sub_overflow((Int128)i, v, &r))
+    return MkInt128Term(r);
+#endif
   if (pt[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b = Yap_BigIntOfTerm(t);
@@ -168,6 +272,12 @@ Term
 Yap_gmp_mul_int_big(Int i, Term t)
 {
   CELL *pt = RepAppl(t);
+#if USE_INT128_BIGS
+  Int128 v, r;
+
+  if (Int128OfBig(t, &v) && !__builtin_mul_overflow((Int128)i, v, &r))
+    return MkInt128Term(r);
+#endif
   if (pt[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b = Yap_BigIntOfTerm(t);
@@ -191,6 +301,12 @@ Term
 Yap_gmp_sub_big_int(Term t, Int i)
 {
   CELL *pt = RepAppl(t);
+#if USE_INT128_BIGS
+  Int128 v, r;
+
+  if (Int128OfBig(t, &v) && !__builtin_sub_overflow(v, (Int128)i, &r))
+    return MkInt128Term(r);
+#endif
   if (pt[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b = Yap_BigIntOfTerm(t);
@@ -421,6 +537,13 @@ Yap_gmp_add_big_big(Term t1, Term t2)
 {
   CELL *pt1 = RepAppl(t1);
   CELL *pt2 = RepAppl(t2);
+#if USE_INT128_BIGS
+  Int128 v1, v2, r;
+
+  if (Int128OfBig(t1, &v1) && Int128OfBig(t2, &v2) &&
+      !__builtin_add_overflow(v1, v2, &r))
+    return MkInt128Term(r);
+#endif
   if (pt1[1] == BIG_INT && pt2[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b1 = Yap_BigIntOfTerm(t1);
@@ -458,6 +581,13 @@ Yap_gmp_sub_big_big(Term t1, Term t2)
 {
   CELL *pt1 = RepAppl(t1);
   CELL *pt2 = RepAppl(t2);
+#if USE_INT128_BIGS
+  Int128 v1, v2, r;
+
+  if (Int128OfBig(t1, &v1) && Int128OfBig(t2, &v2) &&
+      !__builtin_sub_overflow(v1, v2, &r))
+    return MkInt128Term(r);
+#endif
   if (pt1[1] == BIG_INT && pt2[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b1 = Yap_BigIntOfTerm(t1);
@@ -495,6 +625,13 @@ Yap_gmp_mul_big_big(Term t1, Term t2)
 {
   CELL *pt1 = RepAppl(t1);
   CELL *pt2 = RepAppl(t2);
+#if USE_INT128_BIGS
+  Int128 v1, v2, r;
+
+  if (Int128OfBig(t1, &v1) && Int128OfBig(t2, &v2) &&
+      !__builtin_mul_overflow(v1, v2, &r))
+    return MkInt128Term(r);
+#endif
   if (pt1[1] == BIG_INT && pt2[1] == BIG_INT) {
     MP_INT new;
     MP_INT *b1 = Yap_BigIntOfTerm(t1);
@@ -1370,17 +1507,28 @@ Yap_gmp_tcmp_big_big(Term t1, Term t2)
 Term
 Yap_gmp_neg_int(Int i)
 {
+
+#if USE_INT128_BIGS
+  return MkInt128Term(-(Int128)i);
+#else
   MP_INT new;
 
   mpz_init_set_si(&new, Int_MIN);
   mpz_neg(&new, &new);
   return MkBigAndClose(&new);
+#endif
 }
 
 Term
 Yap_gmp_neg_big(Term t)
 {
   CELL *pt = RepAppl(t);
+#if USE_INT128_BIGS
+  Int128 v;
+
+  if (Int128OfBig(t, &v))
+    return MkInt128Term(-v);
+#endif
   if (pt[1] == BIG_INT) {
     MP_INT *b = Yap_BigIntOfTerm(t);
     MP_INT new;
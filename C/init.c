@@ -1121,6 +1121,7 @@ static void InitInvisibleAtoms(void) {
 void Yap_init_yapor_workers(void) {
   CACHE_REGS
   int proc;
+  Yap_bind_yapor_worker(0);
 #ifdef YAPOR_THREADS
   return;
 #endif /* YAPOR_THREADS */
@@ -1159,6 +1160,7 @@ void Yap_init_yapor_workers(void) {
       LOCAL = REMOTE(worker_id);
       memcpy(REMOTE(worker_id), REMOTE(0), sizeof(struct worker_local));
       InitWorker(worker_id);
+      Yap_bind_yapor_worker(worker_id);
       break;
     } else
       GLOBAL_worker_pid(proc) = son;
@@ -1470,6 +1470,11 @@ TokEntry *Yap_tokenizer(struct stream_desc *inp_stream, bool store_comments,
           /* huge atom or variable, we are in trouble */
         }
         add_ch_to_buff(ch);
+        if (!wcharp) {
+          /* take the ASCII part of the name straight from the stream buffer */
+          charp += Yap_GetAlnumRun(inp_stream, charp,
+                                   ((char *)AuxSp - 1024) - charp);
+        }
       }
       while (ch == '\'' && isvar &&
              trueGlobalPrologFlag(VARIABLE_NAMES_MAY_END_WITH_QUOTES_FLAG)) {
@@ -20,6 +20,14 @@
 #include "Yap.h"
 #include "Yatom.h"
 #include "YapHeap.h"
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifndef NULL
 #define NULL (void *)0
 #endif
@@ -328,6 +336,321 @@ Int compact_mergesort(CELL *pt, Int size, int my_p)
   }
 }
 
+/*
+ * Fast path: when the keys are all integers, all floats, or all atoms
+ * with narrow names, take them out of the terms once and sort machine
+ * values instead of calling the generic comparison. Numbers go through a
+ * stable radix sort, atoms through a merge sort on their names, and large
+ * lists are split among several threads, whose runs are then merged.
+ */
+
+#define SORT_FAST_MIN     64
+#define SORT_CHUNK_MIN    (1 << 16)
+#define MAX_SORT_THREADS  16
+
+/* integer and float keys are encoded differently, so they must not be
+   mixed in one fast sort */
+typedef enum { KEYS_NONE, KEYS_INTS, KEYS_FLOATS, KEYS_ATOMS } sort_keys;
+
+typedef struct sort_item {
+  union {
+    uint64_t num;
+    const char *name;
+  } key;
+  CELL t;
+} sort_item;
+
+typedef struct sort_chunk {
+  sort_item *a, *tmp;
+  size_t n, n2;
+  sort_keys kind;
+} sort_chunk;
+
+/* what kind of key t is, and its value */
+static sort_keys
+item_key(Term t, sort_item *it)
+{
+  if (IsVarTerm(t))
+    return KEYS_NONE;
+  if (IsIntegerTerm(t)) {
+    /* flip the sign, so that unsigned order is numeric order */
+    it->key.num = (uint64_t)(int64_t)IntegerOfTerm(t) ^ ((uint64_t)1 << 63);
+    return KEYS_INTS;
+  }
+  if (IsFloatTerm(t)) {
+    union { double d; uint64_t u; } f;
+
+    f.d = FloatOfTerm(t);
+    if (f.d != f.d)
+      return KEYS_NONE;
+    if (f.d == 0.0)
+      f.d = 0.0;		/* -0.0 compares equal to 0.0 */
+    it->key.num =
+        (f.u & ((uint64_t)1 << 63) ? ~f.u : f.u | ((uint64_t)1 << 63));
+    return KEYS_FLOATS;
+  }
+  if (IsAtomTerm(t) && !IsWideAtom(AtomOfTerm(t))) {
+    it->key.name = (const char *)RepAtom(AtomOfTerm(t))->StrOfAE;
+    return KEYS_ATOMS;
+  }
+  return KEYS_NONE;
+}
+
+/* collect the elements in the even cells of pt, if their keys are all of
+   the same kind */
+static sort_keys
+get_sort_items(CELL *pt, Int size, int keyed, sort_item *items)
+{
+  sort_keys kind = KEYS_NONE;
+  Int i;
+
+  for (i = 0; i < size; i++) {
+    Term t = Deref(pt[2*i]), k = t;
+    sort_keys ki;
+
+    if (keyed) {
+      if (IsVarTerm(t) || !IsApplTerm(t) || FunctorOfTerm(t) != FunctorMinus)
+	return KEYS_NONE;
+      k = Deref(ArgOfTerm(1, t));
+    }
+    ki = item_key(k, items+i);
+    if (ki == KEYS_NONE || (i && ki != kind))
+      return KEYS_NONE;
+    kind = ki;
+    items[i].t = t;
+  }
+  return kind;
+}
+
+static inline int
+item_cmp(const sort_item *a, const sort_item *b, sort_keys kind)
+{
+  if (kind != KEYS_ATOMS)
+    return (a->key.num > b->key.num) - (a->key.num < b->key.num);
+  return strcmp(a->key.name, b->key.name);
+}
+
+/* stable merge of a[0..na) and b[0..nb) into out */
+static void
+merge_items(const sort_item *a, size_t na, const sort_item *b, size_t nb,
+	    sort_item *out, sort_keys kind)
+{
+  const sort_item *ea = a+na, *eb = b+nb;
+
+  while (a < ea && b < eb) {
+    if (item_cmp(a, b, kind) <= 0)
+      *out++ = *a++;
+    else
+      *out++ = *b++;
+  }
+  while (a < ea)
+    *out++ = *a++;
+  while (b < eb)
+    *out++ = *b++;
+}
+
+/* least significant digit first, skipping digits that are all the same */
+static void
+radix_sort_items(sort_item *a, sort_item *tmp, size_t n)
+{
+  size_t count[8][256];
+  sort_item *from = a, *to = tmp;
+  size_t i;
+  int d;
+
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < n; i++) {
+    uint64_t k = a[i].key.num;
+    for (d = 0; d < 8; d++)
+      count[d][(k >> (8*d)) & 0xff]++;
+  }
+  for (d = 0; d < 8; d++) {
+    size_t sum = 0, c;
+    int shift = 8*d;
+    sort_item *swap;
+
+    if (count[d][(from[0].key.num >> shift) & 0xff] == n)
+      continue;
+    for (i = 0; i < 256; i++) {
+      c = count[d][i];
+      count[d][i] = sum;
+      sum += c;
+    }
+    for (i = 0; i < n; i++)
+      to[count[d][(from[i].key.num >> shift) & 0xff]++] = from[i];
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != a)
+    memcpy(a, from, n*sizeof(sort_item));
+}
+
+/* bottom-up, starting from sorted runs of 16 elements */
+static void
+merge_sort_items(sort_item *a, sort_item *tmp, size_t n, sort_keys kind)
+{
+  sort_item *from = a, *to = tmp;
+  size_t i, j, width;
+
+  for (i = 0; i < n; i += 16) {
+    size_t end = (i+16 < n ? i+16 : n);
+    for (j = i+1; j < end; j++) {
+      sort_item x = a[j];
+      size_t k = j;
+      while (k > i && item_cmp(a+k-1, &x, kind) > 0) {
+	a[k] = a[k-1];
+	k--;
+      }
+      a[k] = x;
+    }
+  }
+  for (width = 16; width < n; width *= 2) {
+    sort_item *swap;
+
+    for (i = 0; i < n; i += 2*width) {
+      size_t na = (i+width < n ? width : n-i);
+      size_t nb = (i+width < n ? (i+2*width < n ? width : n-i-width) : 0);
+      merge_items(from+i, na, from+i+na, nb, to+i, kind);
+    }
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != a)
+    memcpy(a, from, n*sizeof(sort_item));
+}
+
+static void *
+sort_chunk_items(void *p)
+{
+  sort_chunk *c = (sort_chunk *)p;
+
+  if (c->kind != KEYS_ATOMS)
+    radix_sort_items(c->a, c->tmp, c->n);
+  else
+    merge_sort_items(c->a, c->tmp, c->n, c->kind);
+  return NULL;
+}
+
+static void *
+merge_chunk_items(void *p)
+{
+  sort_chunk *c = (sort_chunk *)p;
+
+  merge_items(c->a, c->n, c->a+c->n, c->n2, c->tmp, c->kind);
+  return NULL;
+}
+
+static void
+run_sort_chunks(void *(*f)(void *), sort_chunk *c, int n)
+{
+  int i;
+#if HAVE_PTHREAD_H
+  pthread_t th[MAX_SORT_THREADS];
+  bool started[MAX_SORT_THREADS];
+
+  for (i = 1; i < n; i++)
+    started[i] = (pthread_create(th+i, NULL, f, c+i) == 0);
+  f(c);
+  for (i = 1; i < n; i++) {
+    if (started[i])
+      pthread_join(th[i], NULL);
+    else
+      f(c+i);
+  }
+#else
+  for (i = 0; i < n; i++)
+    f(c+i);
+#endif
+}
+
+static void
+sort_items(sort_item *a, sort_item *tmp, size_t n, sort_keys kind)
+{
+  sort_chunk chunks[MAX_SORT_THREADS];
+  size_t start[MAX_SORT_THREADS+1];
+  int nthreads = 1, nruns, i;
+  sort_item *from = a, *to = tmp, *swap;
+
+#if HAVE_PTHREAD_H && defined(_SC_NPROCESSORS_ONLN)
+  nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (nthreads > MAX_SORT_THREADS)
+    nthreads = MAX_SORT_THREADS;
+  if ((size_t)nthreads > n/SORT_CHUNK_MIN)
+    nthreads = n/SORT_CHUNK_MIN;
+  if (nthreads <= 1) {
+    chunks[0].a = a;
+    chunks[0].tmp = tmp;
+    chunks[0].n = n;
+    chunks[0].kind = kind;
+    sort_chunk_items(chunks);
+    return;
+  }
+  for (i = 0; i <= nthreads; i++)
+    start[i] = (n/nthreads)*i + (i == nthreads ? n%nthreads : 0);
+  for (i = 0; i < nthreads; i++) {
+    chunks[i].a = a+start[i];
+    chunks[i].tmp = tmp+start[i];
+    chunks[i].n = start[i+1]-start[i];
+    chunks[i].kind = kind;
+  }
+  run_sort_chunks(sort_chunk_items, chunks, nthreads);
+  /* merge neighbouring runs, in parallel, until a single one is left */
+  for (nruns = nthreads; nruns > 1; nruns = (nruns+1)/2) {
+    int nmerges = 0;
+
+    for (i = 0; i+1 < nruns; i += 2) {
+      sort_chunk *c = chunks+nmerges++;
+      c->a = from+start[i];
+      c->tmp = to+start[i];
+      c->n = start[i+1]-start[i];
+      c->n2 = start[i+2]-start[i+1];
+      c->kind = kind;
+    }
+    run_sort_chunks(merge_chunk_items, chunks, nmerges);
+    if (nruns & 1)
+      memcpy(to+start[nruns-1], from+start[nruns-1],
+	     (start[nruns]-start[nruns-1])*sizeof(sort_item));
+    for (i = 0; i <= (nruns+1)/2; i++)
+      start[i] = start[2*i < nruns ? 2*i : nruns];
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != a)
+    memcpy(a, from, n*sizeof(sort_item));
+}
+
+/* sort the size elements in the even cells of pt on their keys, if they
+   are all of the same simple kind. Returns the new number of elements, or
+   -1 if the generic sort must be used */
+static Int
+fast_sort(CELL *pt, Int size, int keyed, int compact)
+{
+  sort_item *items;
+  sort_keys kind;
+  Int i, j;
+
+  if (size < SORT_FAST_MIN ||
+      !(items = (sort_item *)malloc(2*size*sizeof(sort_item))))
+    return -1;
+  if ((kind = get_sort_items(pt, size, keyed, items)) == KEYS_NONE) {
+    free(items);
+    return -1;
+  }
+  sort_items(items, items+size, size, kind);
+  for (i = j = 0; i < size; i++) {
+    if (compact && j && item_cmp(items+i, items+i-1, kind) == 0)
+      continue;
+    pt[2*j] = items[i].t;
+    j++;
+  }
+  free(items);
+  return j;
+}
+
 static void
 adjust_vector(CELL *pt, Int size)
 {
@@ -349,7 +672,7 @@ p_sort( USES_REGS1 )
   CELL *pt = HR;
   Term out;
   /* list size */
-  Int size;
+  Int size, nsize;
   size = build_new_list(pt, Deref(ARG1) PASS_REGS);
   if (size < 0)
     return(FALSE);
@@ -359,7 +682,10 @@ p_sort( USES_REGS1 )
   /* make sure no one writes on our temp data structure */
   HR += size*2;
   /* reserve the necessary space */
-  size = compact_mergesort(pt, size, M_EVEN);
+  if ((nsize = fast_sort(pt, size, FALSE, TRUE)) >= 0)
+    size = nsize;
+  else
+    size = compact_mergesort(pt, size, M_EVEN);
   /* reajust space */
   HR = pt+size*2;
   adjust_vector(pt, size);
@@ -383,7 +709,8 @@ p_msort( USES_REGS1 )
   pt = HR;            /* because of possible garbage collection */
   /* reserve the necessary space */
   HR += size*2;
-  simple_mergesort(pt, size, M_EVEN);
+  if (fast_sort(pt, size, FALSE, FALSE) < 0)
+    simple_mergesort(pt, size, M_EVEN);
   adjust_vector(pt, size);
   out = AbsPair(pt);
   return(Yap_unify(out, ARG2));
@@ -405,7 +732,8 @@ p_ksort( USES_REGS1 )
   /* reserve the necessary space */
   pt = HR;            /* because of possible garbage collection */
   HR += size*2;
-  if (!key_mergesort(pt, size, M_EVEN, FunctorMinus))
+  if (fast_sort(pt, size, TRUE, FALSE) < 0 &&
+      !key_mergesort(pt, size, M_EVEN, FunctorMinus))
     return(FALSE);
   adjust_vector(pt, size);
   out = AbsPair(pt);
@@ -1580,6 +1580,7 @@ void Yap_InitCPreds(void) {
   Yap_InitUserCPreds();
   Yap_InitUtilCPreds();
   Yap_InitSortPreds();
+  Yap_InitCHashPreds();
   Yap_InitMaVarCPreds();
 #ifdef DEPTH_LIMIT
   Yap_InitItDeepenPreds();
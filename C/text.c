@@ -1334,9 +1334,23 @@ static void *concat(int n, seq_tv_t *out, void *sv[], encoding_t encv[],
                     size_t lengv[] USES_REGS) {
   if (out->type == YAP_STRING_STRING) {
     /* we assume we concatenate strings only, or ASCII stuff like numbers */
-    Term t = init_tstring(PASS_REGS1);
-    unsigned char *buf = buf_from_tstring(HR);
+    Term t;
+    unsigned char *buf;
+    size_t sz = 0;
     int i;
+
+    /* an upper bound on the UTF-8 size of the result */
+    for (i = 0; i < n; i++) {
+      if (encv[i] == ENC_WCHAR)
+        sz += 4 * wcslen(sv[i]);
+      else if (encv[i] == ENC_ISO_LATIN1)
+        sz += 2 * strlen(sv[i]);
+      else
+        sz += strlen(sv[i]);
+    }
+    LOCAL_ERROR(TermNil, sz / sizeof(CELL) + 4);
+    t = init_tstring(PASS_REGS1);
+    buf = buf_from_tstring(HR);
     for (i = 0; i < n; i++) {
       if (encv[i] == ENC_WCHAR) {
         wchar_t *ptr = sv[i];
@@ -34,8 +34,14 @@ typedef struct {
 	Term            new_var;
 }              *vcell;
 
+/* the largest ground compound subterms of a term, as an open hash set */
+typedef struct ground_set {
+  CELL **keys;
+  UInt mask;
+} ground_set;
 
-static int   copy_complex_term(CELL *, CELL *, int, int, CELL *, CELL * CACHE_TYPE);
+
+static int   copy_complex_term(CELL *, CELL *, int, int, CELL *, CELL *, ground_set * CACHE_TYPE);
 static CELL  vars_in_complex_term(CELL *, CELL *, Term CACHE_TYPE);
 static Int   p_non_singletons_in_term( USES_REGS1);
 static CELL  non_singletons_in_complex_term(CELL *, CELL * CACHE_TYPE);
@@ -72,8 +78,174 @@ clean_dirty_tr(tr_fr_ptr TR0 USES_REGS) {
   }
 }
 
+/* frames for find_ground_subterms() */
+typedef struct gs_frame {
+  CELL *start;
+  CELL *end;
+  CELL *mark;
+  CELL oldv;
+  CELL *ap;
+  CELL **found;
+  int ground;
+} gs_frame;
+
+#define GS_HASH(AP, MASK) ((((CELL)(AP) >> 3) * 0x9e3779b97f4a7c15ULL >> 20) & (MASK))
+
+static inline int
+in_ground_set(ground_set *gs, CELL *ap)
+{
+  UInt i = GS_HASH(ap, gs->mask);
+  CELL *k;
+
+  while ((k = gs->keys[i]) != NULL) {
+    if (k == ap)
+      return TRUE;
+    i = (i+1) & gs->mask;
+  }
+  return FALSE;
+}
+
+static void
+free_ground_set(ground_set *gs)
+{
+  if (gs->keys) {
+    free(gs->keys);
+    gs->keys = NULL;
+  }
+}
+
+/*
+  Pre-pass for copy_term/2: walk the term once, bottom-up, and collect
+  the compound subterms that are ground but whose parent is not. The
+  copy then points at those instead of building a copy and throwing it
+  away. The addresses are collected on the free global stack and then
+  moved to a hash set; returns TRUE if the whole term is ground. If we
+  run out of space we just give up, and the copy shares nothing up
+  front.
+
+  As in Eval(), a compound term being visited has its functor cell
+  replaced by AtomFoundVar; a list cell, that has no functor, is cut
+  at the cell we came from. Meeting either again means we are going
+  round a cycle: we cannot tell yet whether the cycle is ground, so
+  the term and everything above it count as not ground.
+*/
+static int
+find_ground_subterms(CELL *pt0, CELL *pt0_end, ground_set *gs USES_REGS)
+{
+  gs_frame *to_visit0, *to_visit = (gs_frame *)Yap_PreAllocCodeSpace();
+  CELL **found0 = (CELL **)HR, **found = found0;
+  CELL **found_max = (CELL **)(ASP - 4096);
+  int ground = TRUE;
+  UInt n, sz;
+
+  gs->keys = NULL;
+  to_visit0 = to_visit;
+ loop:
+  while (pt0 < pt0_end) {
+    register CELL d0;
+    register CELL *ptd0;
+    CELL *ap2, *next, *next_end;
+    int nground;
+
+    ++pt0;
+    ptd0 = pt0;
+    d0 = *ptd0;
+    deref_head(d0, ground_subterms_unk);
+  ground_subterms_nvar:
+    {
+      if (IsPairTerm(d0)) {
+	ap2 = RepPair(d0);
+	nground = TRUE;
+	next = ap2 - 1;
+	next_end = ap2 + 1;
+      } else if (IsApplTerm(d0)) {
+	Functor f;
+
+	ap2 = RepAppl(d0);
+	f = (Functor)(*ap2);
+	if ((Atom)f == AtomFoundVar) {
+	  /* back to a term we are visiting */
+	  ground = FALSE;
+	  continue;
+	}
+	if (IsExtensionFunctor(f))
+	  continue;
+	nground = (f != FunctorMutable);
+	next = ap2;
+	next_end = ap2 + ArityOfFunctor(f);
+      } else {
+	if (d0 == MkAtomTerm(AtomFoundVar))
+	  ground = FALSE;
+	continue;
+      }
+      if (to_visit + 1 >= (gs_frame *)AuxSp) {
+	goto aux_overflow;
+      }
+      to_visit->start = pt0;
+      to_visit->end = pt0_end;
+      to_visit->mark = (IsPairTerm(d0) ? pt0 : ap2);
+      to_visit->oldv = *to_visit->mark;
+      to_visit->ap = ap2;
+      to_visit->found = found;
+      to_visit->ground = ground;
+      /* cut cycles */
+      if (IsPairTerm(d0))
+	*pt0 = MkAtomTerm(AtomFoundVar);
+      else
+	*ap2 = (CELL)AtomFoundVar;
+      to_visit++;
+      ground = nground;
+      pt0 = next;
+      pt0_end = next_end;
+      continue;
+    }
+
+    derefa_body(d0, ptd0, ground_subterms_unk, ground_subterms_nvar);
+    ground = FALSE;
+  }
+  /* Do we still have compound terms to visit */
+  if (to_visit > to_visit0) {
+    to_visit--;
+    pt0 = to_visit->start;
+    pt0_end = to_visit->end;
+    *to_visit->mark = to_visit->oldv;
+    if (ground && to_visit->found < found_max) {
+      /* forget its own ground subterms, the parent covers them */
+      found = to_visit->found;
+      *found++ = to_visit->ap;
+    }
+    ground = (ground && to_visit->ground);
+    goto loop;
+  }
+  if (ground)
+    return TRUE;
+  n = found-found0;
+  if (n == 0)
+    return FALSE;
+  for (sz = 16; sz < 2*n; sz *= 2);
+  if (!(gs->keys = (CELL **)calloc(sz, sizeof(CELL *))))
+    return FALSE;
+  gs->mask = sz-1;
+  while (found > found0) {
+    CELL *ap = *--found;
+    UInt i = GS_HASH(ap, gs->mask);
+
+    while (gs->keys[i] != NULL && gs->keys[i] != ap)
+      i = (i+1) & gs->mask;
+    gs->keys[i] = ap;
+  }
+  return FALSE;
+
+ aux_overflow:
+  while (to_visit > to_visit0) {
+    to_visit--;
+    *to_visit->mark = to_visit->oldv;
+  }
+  return FALSE;
+}
+
 static int
-copy_complex_term(CELL *pt0, CELL *pt0_end, int share, int newattvs, CELL *ptf, CELL *HLow USES_REGS)
+copy_complex_term(CELL *pt0, CELL *pt0_end, int share, int newattvs, CELL *ptf, CELL *HLow, ground_set *gs USES_REGS)
 {
 
   struct cp_frame *to_visit0, *to_visit = (struct cp_frame *)Yap_PreAllocCodeSpace();
@@ -100,6 +272,11 @@ copy_complex_term(CELL *pt0, CELL *pt0_end, int share, int newattvs, CELL *ptf,
 	  *ptf++ = d0;
 	  continue;
 	} 
+	if (gs && in_ground_set(gs, ap2)) {
+	  /* ground, share it */
+	  *ptf++ = d0;
+	  continue;
+	}
 	*ptf = AbsPair(HR);
 	ptf++;
 #ifdef RATIONAL_TREES
@@ -144,6 +321,11 @@ copy_complex_term(CELL *pt0, CELL *pt0_end, int share, int newattvs, CELL *ptf,
 	  *ptf++ = d0;
 	  continue;
 	} 
+	if (gs && in_ground_set(gs, ap2)) {
+	  /* ground, share it */
+	  *ptf++ = d0;
+	  continue;
+	}
 	f = (Functor)(*ap2);
 
 	if (IsExtensionFunctor(f)) {
@@ -404,6 +586,7 @@ static Term
 CopyTerm(Term inp, UInt arity, int share, int newattvs USES_REGS) {
   Term t = Deref(inp);
   tr_fr_ptr TR0 = TR;
+  ground_set gs;
 
   if (IsVarTerm(t)) {
 #if COROUTINING
@@ -415,7 +598,7 @@ CopyTerm(Term inp, UInt arity, int share, int newattvs USES_REGS) {
       *HR = t;
       Hi = HR+1;
       HR += 2;
-      if ((res = copy_complex_term(Hi-2, Hi-1, share, newattvs, Hi, Hi PASS_REGS)) < 0) {
+      if ((res = copy_complex_term(Hi-2, Hi-1, share, newattvs, Hi, Hi, NULL PASS_REGS)) < 0) {
 	HR = Hi-1;
 	if ((t = handle_cp_overflow(res, TR0, arity, t))== 0L)
 	  return FALSE;
@@ -434,12 +617,18 @@ CopyTerm(Term inp, UInt arity, int share, int newattvs USES_REGS) {
 
   restart_list:
     ap = RepPair(t);
+    gs.keys = NULL;
+    if (share && find_ground_subterms(ap-1, ap+1, &gs PASS_REGS))
+      return t;
     Hi = HR;
     tf = AbsPair(HR);
     HR += 2;
     {
       int res;
-      if ((res = copy_complex_term(ap-1, ap+1, share, newattvs, Hi, Hi PASS_REGS)) < 0) {
+
+      res = copy_complex_term(ap-1, ap+1, share, newattvs, Hi, Hi, (gs.keys ? &gs : NULL) PASS_REGS);
+      free_ground_set(&gs);
+      if (res < 0) {
 	HR = Hi;
 	if ((t = handle_cp_overflow(res, TR0, arity, t))== 0L)
 	  return FALSE;
@@ -458,20 +647,27 @@ CopyTerm(Term inp, UInt arity, int share, int newattvs USES_REGS) {
 
   restart_appl:
     f = FunctorOfTerm(t);
-    HB0 = HR;
     ap = RepAppl(t);
+    gs.keys = NULL;
+    if (share && find_ground_subterms(ap, ap+ArityOfFunctor(f), &gs PASS_REGS) &&
+	f != FunctorMutable)
+      return t;
+    HB0 = HR;
     tf = AbsAppl(HR);
     HR[0] = (CELL)f;
     HR += 1+ArityOfFunctor(f);
     if (HR > ASP-128) {
       HR = HB0;
+      free_ground_set(&gs);
       if ((t = handle_cp_overflow(-1, TR0, arity, t))== 0L)
 	return FALSE;
       goto restart_appl;
     } else {
       int res;
 
-      if ((res = copy_complex_term(ap, ap+ArityOfFunctor(f), share, newattvs, HB0+1, HB0 PASS_REGS)) < 0) {
+      res = copy_complex_term(ap, ap+ArityOfFunctor(f), share, newattvs, HB0+1, HB0, (gs.keys ? &gs : NULL) PASS_REGS);
+      free_ground_set(&gs);
+      if (res < 0) {
 	HR = HB0;
 	if ((t = handle_cp_overflow(res, TR0, arity, t))== 0L)
 	  return FALSE;
@@ -3321,100 +3517,118 @@ p_var_in_term( USES_REGS1 )
 
 /* This code with max_depth == -1 will loop for infinite trees */
 
+/*
+  The term is hashed as it is walked: every atom, number or functor is
+  folded into a 64 bit state with the MurmurHash3 x64 round, so nothing
+  is copied to the global stack. Text and big numbers are hashed eight
+  bytes at a time over four independent lanes, and the hash of an atom
+  name is computed once and kept in HashOfAE.
 
-//-----------------------------------------------------------------------------
-// MurmurHash2, by Austin Appleby
-
-// Note - This code makes a few assumptions about how your machine behaves -
-
-// 1. We can read a 4-byte value from any address without crashing
-// 2. sizeof(int) == 4
-
-// And it has a few limitations -
+  The hash does not depend on where atoms live, so it is the same across
+  sessions and saved states, but it does depend on the byte order.
+*/
 
-// 1. It will not work incrementally.
-// 2. It will not produce the same results on little-endian and big-endian
-//    machines.
+#define TH_C1   0x87c37b91114253d5ULL
+#define TH_C2   0x4cf5ad432745937fULL
+#define TH_SEED 0x1a3be34aULL
+#define TH_ATOM 0xa700000000000000ULL
+#define TH_FUNC 0xf500000000000000ULL
 
-static unsigned int
-MurmurHashNeutral2 ( const void * key, int len, unsigned int seed )
+static inline uint64_t
+th_rotl(uint64_t x, int r)
 {
-	const unsigned int m = 0x5bd1e995;
-	const int r = 24;
-
-	unsigned int h = seed ^ len;
-
-	const unsigned char * data = (const unsigned char *)key;
+  return (x << r) | (x >> (64 - r));
+}
 
-	while(len >= 4)
-	{
-		unsigned int k;
+static inline uint64_t
+th_mix(uint64_t h, uint64_t k)
+{
+  k *= TH_C1;
+  k = th_rotl(k, 31);
+  k *= TH_C2;
+  h ^= k;
+  h = th_rotl(h, 27);
+  return h * 5 + 0x52dce729;
+}
 
-		k  = data[0];
-		k |= data[1] << 8;
-		k |= data[2] << 16;
-		k |= data[3] << 24;
+static inline uint64_t
+th_final(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
 
-		k *= m; 
-		k ^= k >> r; 
-		k *= m;
+static inline uint64_t
+th_load(const unsigned char *p)
+{
+  uint64_t w;
 
-		h *= m;
-		h ^= k;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
 
-		data += 4;
-		len -= 4;
-	}
-	
-	switch(len)
-	{
-	case 3: h ^= data[2] << 16;
-	case 2: h ^= data[1] << 8;
-	case 1: h ^= data[0];
-	        h *= m;
-	};
+static uint64_t
+th_bytes(uint64_t h, const void *key, size_t len)
+{
+  const unsigned char *data = (const unsigned char *)key;
+  uint64_t w;
 
-	h ^= h >> 13;
-	h *= m;
-	h ^= h >> 15;
+  h = th_mix(h, len);
+  if (len >= 32) {
+    /* the four lanes do not depend on each other */
+    uint64_t h0 = h, h1 = h ^ TH_C1, h2 = h ^ TH_C2, h3 = ~h;
 
-	return h;
-} 
+    do {
+      h0 = th_mix(h0, th_load(data));
+      h1 = th_mix(h1, th_load(data+8));
+      h2 = th_mix(h2, th_load(data+16));
+      h3 = th_mix(h3, th_load(data+24));
+      data += 32;
+      len -= 32;
+    } while (len >= 32);
+    h = th_mix(th_mix(th_mix(h0, h1), h2), h3);
+  }
+  while (len >= 8) {
+    h = th_mix(h, th_load(data));
+    data += 8;
+    len -= 8;
+  }
+  if (len) {
+    w = 0;
+    memcpy(&w, data, len);
+    h = th_mix(h, w);
+  }
+  return h;
+}
 
-static CELL *
-addAtomToHash(CELL *st, Atom at)
+/* hash of the atom's name, computed on first use */
+static inline uint64_t
+AtomHash(Atom at)
 {
-  unsigned int len;
+  AtomEntry *ae = RepAtom(at);
+  unsigned int hv = ae->HashOfAE;
 
-  if (IsWideAtom(at)) {
-    wchar_t *c = RepAtom(at)->WStrOfAE;
-    int ulen = wcslen(c);
-    len = ulen*sizeof(wchar_t);
-    if (len % CellSize == 0) {
-      len /= CellSize;
-    } else {
-      len /= CellSize;
-      len++;
-    }
-    st[len-1] = 0L;
-    wcsncpy((wchar_t *)st, c, ulen);
-  } else {
-    char *c = RepAtom(at)->StrOfAE;
-    int ulen = strlen(c);
-    /* fix hashing over empty atom */
-    if (!ulen) {
-      return st;
-    }
-    if (ulen % CellSize == 0) {
-      len = ulen/CellSize;
+  if (!hv) {
+    uint64_t h;
+
+    if (IsWideAtom(at)) {
+      wchar_t *c = ae->WStrOfAE;
+      h = th_bytes(TH_SEED, c, wcslen(c)*sizeof(wchar_t));
     } else {
-      len = ulen/CellSize;
-      len++;
+      char *c = ae->StrOfAE;
+      h = th_bytes(TH_SEED, c, strlen(c));
     }
-    st[len-1] = 0L;
-    strncpy((char *)st, c, ulen);
+    h = th_final(h);
+    hv = (unsigned int)(h ^ (h >> 32));
+    if (!hv)
+      hv = 1;
+    ae->HashOfAE = hv;
   }
-  return st+len;
+  return hv;
 }
 
 typedef struct visited {
@@ -3424,14 +3638,19 @@ typedef struct visited {
   UInt vdepth;
 } visited_t;
 
-static CELL *
+/*
+  returns 1 and the hash in *hp, 0 if an unbound variable was found
+  and variant is false, or -1 if we ran out of auxiliary space.
+*/
+static int
 hash_complex_term(register CELL *pt0,
 		  register CELL *pt0_end,
 		  Int depth,
-		  CELL *st,
-		  int variant USES_REGS)
+		  int variant,
+		  uint64_t *hp USES_REGS)
 {
   register visited_t *to_visit0, *to_visit = (visited_t *)Yap_PreAllocCodeSpace();
+  uint64_t h = *hp;
 
   to_visit0 = to_visit;
  loop:
@@ -3444,20 +3663,17 @@ hash_complex_term(register CELL *pt0,
     deref_head(d0, hash_complex_unk);
   hash_complex_nvar:
     {
-      if (st + 1024 >= ASP) {
-	goto global_overflow;
-      }
       if (IsAtomOrIntTerm(d0)) {
 	if (d0 != TermFoundVar) {
 	  if (IsAtomTerm(d0)) {
-	    st = addAtomToHash(st, AtomOfTerm(d0));
+	    h = th_mix(h, AtomHash(AtomOfTerm(d0)) | TH_ATOM);
 	  } else {
-	    *st++ = IntOfTerm(d0);
+	    h = th_mix(h, (uint64_t)IntOfTerm(d0));
 	  }
 	}
 	continue;
       } else if (IsPairTerm(d0)) {
-	st = addAtomToHash(st, AtomDot);
+	h = th_mix(h, AtomHash(AtomDot) | TH_FUNC | ((uint64_t)2 << 32));
 	if (depth == 1)
 	  continue;
 	if (to_visit + 256 >= (visited_t *)AuxSp) {
@@ -3486,45 +3702,48 @@ hash_complex_term(register CELL *pt0,
 	  switch(fc) {
 	    
 	  case (CELL)FunctorDBRef:
-	    *st++ = fc;
+	    h = th_mix(h, fc);
 	    break;
 	  case (CELL)FunctorLongInt:
-	    *st++ = LongIntOfTerm(d0);
+	    h = th_mix(h, (uint64_t)LongIntOfTerm(d0));
 	    break;
 	  case (CELL)FunctorString:
-	    memcpy(st, RepAppl(d0), (3+RepAppl(d0)[1])*sizeof(CELL));
-	    st += 3+RepAppl(d0)[1];
+	    h = th_bytes(h, RepAppl(d0), (3+RepAppl(d0)[1])*sizeof(CELL));
 	    break;
 #ifdef USE_GMP
 	  case (CELL)FunctorBigInt:
 	    {
 	      CELL *pt = RepAppl(d0);
-	      Int sz = 
-		sizeof(MP_INT)+1+
-		(((MP_INT *)(pt+2))->_mp_alloc*sizeof(mp_limb_t));
-
-	      if (st + (1024 + sz/CellSize) >= ASP) {
-		goto global_overflow;
+	      MP_INT *b = (MP_INT *)(pt+2);
+	      Int n = (b->_mp_size < 0 ? -b->_mp_size : b->_mp_size);
+
+	      /* only the significant limbs, whatever was allocated */
+	      if (pt[1] == BIG_INT) {
+		h = th_mix(h, b->_mp_size);
+		h = th_bytes(h, b+1, n*sizeof(mp_limb_t));
+	      } else {
+		Int sz = 
+		  sizeof(MP_INT)+1+
+		  (b->_mp_alloc*sizeof(mp_limb_t));
+		h = th_bytes(h, pt+1, sz);
 	      }
-	      /* then the actual number */
-	      memcpy((void *)(st+1), (void *)(pt+1), sz);
-	      st = st+sz/CellSize;
 	    }
 	    break;
 #endif
 	  case (CELL)FunctorDouble:
 	    {
 	      CELL *pt = RepAppl(d0);
-	      *st++ = pt[1];
+	      h = th_mix(h, pt[1]);
 #if  SIZEOF_DOUBLE == 2*SIZEOF_INT_P
-	      *st++ = pt[2];
+	      h = th_mix(h, pt[2]);
 #endif
 	      break;
 	    }
 	  }
 	  continue;
 	}
-	st = addAtomToHash(st, NameOfFunctor(f));
+	h = th_mix(h, AtomHash(NameOfFunctor(f)) | TH_FUNC |
+		   ((uint64_t)(ArityOfFunctor(f) & 0xffffff) << 32));
 	if (depth == 1)
 	  continue;
 	if (to_visit + 1024 >= (visited_t *)AuxSp) {
@@ -3546,9 +3765,15 @@ hash_complex_term(register CELL *pt0,
     
 
     deref_body(d0, ptd0, hash_complex_unk, hash_complex_nvar);
-    if (!variant)
-      return NULL;
-    else
+    if (!variant) {
+      /* unwind stack */
+      while (to_visit > to_visit0) {
+	to_visit --;
+	pt0 = to_visit->start;
+	*pt0 = to_visit->old;
+      }
+      return 0;
+    } else
       continue;
   }
   /* Do we still have compound terms to visit */
@@ -3560,7 +3785,8 @@ hash_complex_term(register CELL *pt0,
     depth = to_visit->vdepth;
     goto loop;
   }
-  return st;
+  *hp = h;
+  return 1;
 
  aux_overflow:
   /* unwind stack */
@@ -3569,47 +3795,40 @@ hash_complex_term(register CELL *pt0,
     pt0 = to_visit->start;
     *pt0 = to_visit->old;
   }
-  return (CELL *)-1;
-
- global_overflow:
-  /* unwind stack */
-  while (to_visit > to_visit0) {
-    to_visit --;
-    pt0 = to_visit->start;
-    *pt0 = to_visit->old;
-  }
-  return (CELL *) -2;
+  return -1;
 }
- 
-Int
-Yap_TermHash(Term t, Int size, Int depth, int variant)
-{
-  CACHE_REGS
-  unsigned int i1;
-  Term t1 = Deref(t);
 
+/* 0 if t is not ground and variant is false */
+static int
+term_hash(Term t1, Int depth, int variant, unsigned int *out USES_REGS)
+{
   while (TRUE) {
-    CELL *ar = hash_complex_term(&t1-1, &t1, depth, HR, FALSE PASS_REGS);
-    if (ar == (CELL *)-1) {
+    uint64_t h = TH_SEED;
+    int rc = hash_complex_term(&t1-1, &t1, depth, variant, &h PASS_REGS);
+
+    if (rc < 0) {
       if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
-	Yap_Error(RESOURCE_ERROR_AUXILIARY_STACK, ARG1, "overflow in term_hash");
+	Yap_Error(RESOURCE_ERROR_AUXILIARY_STACK, t1, "overflow in term_hash");
 	return FALSE;
       } 
-      t1 = Deref(ARG1);
-    } else if(ar == (CELL *)-2) {
-      if (!Yap_gcl((ASP-HR)*sizeof(CELL), 0, ENV, gc_P(P,CP))) {
-	Yap_Error(RESOURCE_ERROR_STACK, TermNil, "in term_hash");
-	return FALSE;
-      }
-      t1 = Deref(ARG1);
-    } else if (ar == NULL) {
+    } else if (rc == 0) {
       return FALSE;
     } else {
-      i1 = MurmurHashNeutral2((const void *)HR, CellSize*(ar-HR),0x1a3be34a);
-      break;
+      h = th_final(h);
+      *out = (unsigned int)(h ^ (h >> 32));
+      return TRUE;
     }
   }
-  /* got the seed and hash from SWI-Prolog */
+}
+ 
+Int
+Yap_TermHash(Term t, Int size, Int depth, int variant)
+{
+  CACHE_REGS
+  unsigned int i1;
+
+  if (!term_hash(Deref(t), depth, variant, &i1 PASS_REGS))
+    return FALSE;
   return i1 % size;
 }
 
@@ -3645,28 +3864,8 @@ p_term_hash( USES_REGS1 )
     return(FALSE);
   }
   size = IntegerOfTerm(t3);
-  while (TRUE) {
-    CELL *ar = hash_complex_term(&t1-1, &t1, depth, HR, FALSE PASS_REGS);
-    if (ar == (CELL *)-1) {
-      if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
-	Yap_Error(RESOURCE_ERROR_AUXILIARY_STACK, ARG1, "overflow in term_hash");
-	return FALSE;
-      } 
-      t1 = Deref(ARG1);
-    } else if(ar == (CELL *)-2) {
-      if (!Yap_gcl((ASP-HR)*sizeof(CELL), 4, ENV, gc_P(P,CP))) {
-	Yap_Error(RESOURCE_ERROR_STACK, TermNil, "in term_hash");
-	return FALSE;
-      }
-      t1 = Deref(ARG1);
-    } else if (ar == NULL) {
-      return FALSE;
-    } else {
-      i1 = MurmurHashNeutral2((const void *)HR, CellSize*(ar-HR),0x1a3be34a);
-      break;
-    }
-  }
-  /* got the seed and hash from SWI-Prolog */
+  if (!term_hash(t1, depth, FALSE, &i1 PASS_REGS))
+    return FALSE;
   result = MkIntegerTerm(i1 % size);
   return Yap_unify(ARG4,result);
 }
@@ -3703,28 +3902,8 @@ p_instantiated_term_hash( USES_REGS1 )
     return(FALSE);
   }
   size = IntegerOfTerm(t3);
-  while (TRUE) {
-    CELL *ar = hash_complex_term(&t1-1, &t1, depth, HR, TRUE PASS_REGS);
-    if (ar == (CELL *)-1) {
-      if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
-	Yap_Error(RESOURCE_ERROR_AUXILIARY_STACK, ARG1, "overflow in term_hash");
-	return FALSE;
-      } 
-      t1 = Deref(ARG1);
-    } else if(ar == (CELL *)-2) {
-      if (!Yap_gcl((ASP-HR)*sizeof(CELL), 4, ENV, gc_P(P,CP))) {
-	Yap_Error(RESOURCE_ERROR_STACK, TermNil, "in term_hash");
-	return FALSE;
-      }
-      t1 = Deref(ARG1);
-    } else if (ar == NULL) {
-      return FALSE;
-    } else {
-      i1 = MurmurHashNeutral2((const void *)HR, CellSize*(ar-HR),0x1a3be34a);
-      break;
-    }
-  }
-  /* got the seed and hash from SWI-Prolog */
+  if (!term_hash(t1, depth, TRUE, &i1 PASS_REGS))
+    return FALSE;
   result = MkIntegerTerm(i1 % size);
   return Yap_unify(ARG4,result);
 }
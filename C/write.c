@@ -162,31 +162,60 @@ static void protect_close_number(struct write_globs *wglb, int used_bracket) {
   last_minus = FALSE;
 }
 
+inline static void wrputs(char *s, StreamDesc *stream) {
+  int c;
+  /* plain file streams take the ASCII prefix in one go */
+  s += Yap_PutAsciiRun(stream, s);
+  while ((c = *s++))
+    wrputc(c, stream);
+}
+
+static const char digit_pairs[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+
+/* fill s backwards with the decimal digits of n, two at a time */
+static char *format_int(Int n, char *s) {
+  UInt u = (n < 0 ? -(UInt)n : (UInt)n);
+
+  *--s = '\0';
+  while (u >= 100) {
+    const char *d = digit_pairs + 2 * (u % 100);
+    u /= 100;
+    *--s = d[1];
+    *--s = d[0];
+  }
+  if (u >= 10) {
+    *--s = digit_pairs[2 * u + 1];
+    *--s = digit_pairs[2 * u];
+  } else {
+    *--s = '0' + u;
+  }
+  if (n < 0)
+    *--s = '-';
+  return s;
+}
+
 static void wrputn(Int n,
                    struct write_globs *wglb) /* writes an integer	 */
 {
   wrf stream = wglb->stream;
-  char s[256], *s1 = s; /* that should be enough for most integers */
+  char s[64]; /* that is enough for any Int */
   int has_minus = (n < 0);
   int ob;
 
   ob = protect_open_number(wglb, last_minus, has_minus);
-#if HAVE_SNPRINTF
-  snprintf(s, 256, Int_FORMAT, n);
-#else
-  sprintf(s, Int_FORMAT, n);
-#endif
-  while (*s1)
-    wrputc(*s1++, stream);
+  wrputs(format_int(n, s + sizeof(s)), stream);
   protect_close_number(wglb, ob);
 }
 
-inline static void wrputs(char *s, StreamDesc *stream) {
-  int c;
-  while ((c = *s++))
-    wrputc(c, stream);
-}
-
 static void wrputws(wchar_t *s, wrf stream) /* writes a string	 */
 {
   while (*s)
@@ -290,6 +319,36 @@ static void writebig(Term t, int p, int depth, int rinfixarg,
   wrputs("0", wglb->stream);
 }
 
+/*
+  print a float with the user's float_format, or, for the default '', with
+  the fewest digits that read back as the same number.
+*/
+static void format_float(Float f, char *s) {
+  const char *fmt = floatFormat();
+  int prec;
+
+  if (fmt[0] != '\0') {
+    sprintf(s, fmt, f);
+    return;
+  }
+  for (prec = 15; prec < 17; prec++) {
+    sprintf(s, "%.*g", prec, f);
+    if (strtod(s, NULL) == f)
+      break;
+  }
+  if (prec == 17)
+    sprintf(s, "%.17g", f);
+  /* make sure it reads back as a float */
+  if (!strpbrk(s, ".,eEni")) {
+    strcat(s, ".0");
+  } else if (!strpbrk(s, ".,ni")) {
+    char *e = strpbrk(s, "eE");
+    memmove(e + 2, e, strlen(e) + 1);
+    e[0] = '.';
+    e[1] = '0';
+  }
+}
+
 static void wrputf(Float f, struct write_globs *wglb) /* writes a float	 */
 
 {
@@ -339,8 +398,7 @@ static void wrputf(Float f, struct write_globs *wglb) /* writes a float	 */
     wrputc(' ', stream);
   }
   lastw = alphanum;
-  //  sprintf(s, "%.15g", f);
-  sprintf(s, floatFormat(), f);
+  format_float(f, s);
   while (*pt == ' ')
     pt++;
   if (*pt == '-') {
@@ -374,8 +432,7 @@ static void wrputf(Float f, struct write_globs *wglb) /* writes a float	 */
   if (lastw == symbol || lastw == alphanum) {
     wrputc(' ', stream);
   }
-  /* use SWI's format_float */
-  sprintf(buf, (char *)floatFormat(), f);
+  format_float(f, buf);
 
   wrputs(buf, stream);
 #endif
@@ -579,10 +636,19 @@ static void write_string(const unsigned char *s,
   wrputc(qt, stream);
 }
 
+/*
+  how an atom is written only depends on its text, so the token class and
+  whether it needs quotes are computed once and kept in WriteInfoOfAE.
+*/
+#define WI_KNOWN 0x1
+#define WI_LEGAL 0x2
+#define WI_TYPE_SHIFT 2
+
 /* writes an atom	 */
 static void putAtom(Atom atom, int Quote_illegal, struct write_globs *wglb) {
   unsigned char *s;
   wtype atom_or_symbol;
+  unsigned int info;
   wrf stream = wglb->stream;
 
   if (IsBlob(atom)) {
@@ -617,11 +683,18 @@ static void putAtom(Atom atom, int Quote_illegal, struct write_globs *wglb) {
 #endif
   /* if symbol then last_minus is important */
   last_minus = FALSE;
-  atom_or_symbol = AtomIsSymbols(s);
+  info = RepAtom(atom)->WriteInfoOfAE;
+  if (!(info & WI_KNOWN)) {
+    info = WI_KNOWN | (AtomIsSymbols(s) << WI_TYPE_SHIFT);
+    if (legalAtom(s))
+      info |= WI_LEGAL;
+    RepAtom(atom)->WriteInfoOfAE = info;
+  }
+  atom_or_symbol = (wtype)(info >> WI_TYPE_SHIFT);
   if (lastw == atom_or_symbol && atom_or_symbol != separator /* solo */)
     wrputc(' ', stream);
   lastw = atom_or_symbol;
-  if (Quote_illegal && !legalAtom(s)) {
+  if (Quote_illegal && !(info & WI_LEGAL)) {
     wrputc('\'', stream);
     while (*s) {
       wchar_t ch = *s++;
@@ -54,6 +54,8 @@ typedef struct AtomEntryStruct
 {
   Atom NextOfAE;		/* used to build hash chains                    */
   Prop PropsOfAE;		/* property list for this atom                  */
+  unsigned int WriteInfoOfAE;	/* token class and quoting, cached by writer    */
+  unsigned int HashOfAE;	/* hash of the name for term_hash/4, 0 if unset */
 #if defined(YAPOR) || defined(THREADS)
   rwlock_t ARWLock;
 #endif
@@ -72,6 +74,8 @@ typedef struct ExtraAtomEntryStruct
 {
   Atom NextOfAE;                /* used to build hash chains                    */
   Prop PropsOfAE;               /* property list for this atom                  */
+  unsigned int WriteInfoOfAE;   /* token class and quoting, cached by writer    */
+  unsigned int HashOfAE;        /* hash of the name for term_hash/4, 0 if unset */
 #if defined(YAPOR) || defined(THREADS)
   rwlock_t ARWLock;
 #endif
@@ -188,15 +188,15 @@ available in experimental implementations.
  */
     YAP_FLAG(FILE_NAME_VARIABLES_FLAG, "file_name_variables", true, booleanFlag,
              "true", NULL),
-    YAP_FLAG(FLOAT_FORMAT_FLAG, "float_format", true, isatom, "%15f",
+    YAP_FLAG(FLOAT_FORMAT_FLAG, "float_format", true, isatom, "",
              NULL),                                    /**< + `float_format `
 
                                     C-library `printf()` format specification used by write/1 and
                                     friends to determine how floating point numbers are printed. The
-                                    default is `%.15g`. The specified value is passed to `printf()`
+                                    default, `''`, prints the shortest form that reads back as the
+                                    same float. Any other value is passed to `printf()`
                                     without further checking. For example, if you want less digits
-                                    printed, `%g` will print all floats using 6 digits instead of the
-                                    default 15.
+                                    printed, `%g` will print all floats using 6 digits.
                                     */
     YAP_FLAG(GC_FLAG, "gc", true, booleanFlag, "on", NULL), /**< `gc`
 
@@ -124,6 +124,10 @@ X_API Int YAP_ExecuteOnCut(struct pred_entry *, CPredicate, struct cut_c_str *);
 X_API Int YAP_RunGoalOnce(Term);
 #endif
 
+/* chash.c */
+void Yap_InitCHashPreds(void);
+void Yap_CHashRelease(Atom);
+
 /* cdmgr.c */
 Term Yap_all_calls(void);
 Atom Yap_ConsultingFile(USES_REGS1);
@@ -158,6 +158,7 @@ typedef struct global_entry {
   struct global_entry *NextGE;      /* linked list of global entries */
   Term global;                      /* index in module table                */
   Term AttChain;                    /* index in module table                */
+  UInt SizeOfGE; /* cells taken by an unseen value at the top of the arena */
 } GlobalEntry;
 
 #if USE_OFFSETS_IN_PROPS
@@ -1121,7 +1122,8 @@ typedef enum {
   STATIC_ARRAY = 1,
   DYNAMIC_ARRAY = 2,
   MMAP_ARRAY = 4,
-  FIXED_ARRAY = 8
+  FIXED_ARRAY = 8,
+  SHARED_ARRAY = 16 /* C code holds the address of the elements */
 } array_type;
 
 /*		array property entry structure				*/
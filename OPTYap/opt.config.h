@@ -117,6 +117,16 @@
 ******************************************************/
 /* #define INCOMPLETE_TABLING 1 */
 
+/***************************************************************
+**      freeze completed tables into answer arrays ? (optional)  **
+****************************************************************/
+#define TABLING_ANSWER_ARRAYS 1
+
+/*************************************************************
+**      profile the evaluation of tables ? (optional)       **
+*************************************************************/
+#define TABLING_PROFILER 1
+
 /******************************************************
 **      limit the table space size ? (optional)      **
 ******************************************************/
@@ -137,6 +147,11 @@
 *********************************************************************/
 #define TIMESTAMP_CHECK 1
 
+/***************************************************************************
+**      bind YapOr workers to processors and NUMA nodes ? (optional)      **
+***************************************************************************/
+#define YAPOR_NUMA_PLACEMENT 1
+
 /*************************************************
 **      enable error checking ? (optional)      **
 *************************************************/
@@ -335,6 +350,10 @@
 #undef OUTPUT_THREADS_TABLING
 #endif
 
+#if !defined(YAPOR) || !defined(__linux__)
+#undef YAPOR_NUMA_PLACEMENT
+#endif
+
 #if defined(DEBUG_YAPOR) && defined(DEBUG_TABLING)
 #define DEBUG_OPTYAP
 #endif
@@ -356,3 +375,11 @@
 #if defined(YAPOR)
 #undef MODE_DIRECTED_TABLING
 #endif
+
+#if !defined(TABLING) || defined(YAPOR) || defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING) || defined(LIMIT_TABLING)
+#undef TABLING_ANSWER_ARRAYS
+#endif
+
+#if !defined(TABLING) || defined(YAPOR) || defined(THREADS)
+#undef TABLING_PROFILER
+#endif
@@ -15,6 +15,9 @@
 **      Includes      **
 ***********************/
 
+#ifdef __linux__
+#define _GNU_SOURCE /* sched_setaffinity() */
+#endif /* __linux__ */
 #include "Yap.h"
 #if defined(YAPOR) || defined(TABLING)
 #define OPT_MAVAR_STATIC
@@ -35,6 +38,10 @@
 #ifdef YAPOR_COW
 #include "sys/wait.h"
 #endif /* YAPOR_COW */
+#ifdef YAPOR_NUMA_PLACEMENT
+#include <stdio.h>
+#include <sched.h>
+#endif /* YAPOR_NUMA_PLACEMENT */
 
 /*********************
 **      Macros      **
@@ -63,6 +70,77 @@
 #define INIT_LOCAL_PAGE_ENTRY(PG, STR_TYPE) PgEnt_strs_in_use(PG) = 0
 #endif /* USE_PAGES_MALLOC */
 
+#ifdef YAPOR_NUMA_PLACEMENT
+#define MAX_NUMA_NODES 64
+#define NUMA_NODE_PATH "/sys/devices/system/node/node%d"
+#endif /* YAPOR_NUMA_PLACEMENT */
+
+/******************************
+**      Local functions      **
+******************************/
+
+#ifdef YAPOR_NUMA_PLACEMENT
+static int node_cpus(int node, int *cpus, int max) {
+  /* read the processors of a node from its cpulist, as in "0-3,8-11";
+     returns -1 if there is no such node */
+  char path[64];
+  FILE *f;
+  int n = 0, lo, hi, c;
+
+  snprintf(path, sizeof(path), NUMA_NODE_PATH "/cpulist", node);
+  if (!(f = fopen(path, "r")))
+    return -1;
+  while (n < max && fscanf(f, "%d", &lo) == 1) {
+    hi = lo;
+    if ((c = fgetc(f)) == '-') {
+      if (fscanf(f, "%d", &hi) != 1)
+        break;
+      c = fgetc(f);
+    }
+    while (lo <= hi && n < max)
+      cpus[n++] = lo++;
+    if (c != ',')
+      break;
+  }
+  fclose(f);
+  return n;
+}
+
+static void place_worker(int wid) {
+  /* processors are handed out node by node, so that workers with close
+     identifiers (which mostly share work among them) end up in the same
+     NUMA domain; without NUMA information the processors are taken in order */
+  int cpus[CPU_SETSIZE];
+  int n_cpus, total, slot, node, n;
+
+  REMOTE_cpu(wid) = -1;
+  REMOTE_numa_node(wid) = 0;
+  if ((n_cpus = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+    return;
+  /* node numbers may have holes, and so may processor numbers */
+  total = 0;
+  for (node = 0; node < MAX_NUMA_NODES; node++)
+    if ((n = node_cpus(node, cpus, CPU_SETSIZE)) > 0)
+      total += n;
+  if (total == 0) {
+    REMOTE_cpu(wid) = wid % n_cpus;
+    return;
+  }
+  slot = wid % total;
+  for (node = 0; node < MAX_NUMA_NODES; node++) {
+    if ((n = node_cpus(node, cpus, CPU_SETSIZE)) <= 0)
+      continue;
+    if (slot < n) {
+      REMOTE_cpu(wid) = cpus[slot];
+      REMOTE_numa_node(wid) = node;
+      return;
+    }
+    slot -= n;
+  }
+  return;
+}
+#endif /* YAPOR_NUMA_PLACEMENT */
+
 /*******************************
 **      Global functions      **
 *******************************/
@@ -118,6 +196,7 @@ void Yap_init_global_optyap_data(int max_table_size, int n_workers,
     GLOBAL_worker_pid(i) = 0;
   GLOBAL_scheduler_loop = sch_loop;
   GLOBAL_delayed_release_load = delay_load;
+  GLOBAL_release_load = delay_load;
 
   /* global data related to or-parallelism */
   ALLOC_OR_FRAME(GLOBAL_root_or_fr);
@@ -140,6 +219,7 @@ void Yap_init_global_optyap_data(int max_table_size, int n_workers,
   GLOBAL_locks_who_locked_heap = MAX_WORKERS;
   INIT_LOCK(GLOBAL_locks_heap_access);
   INIT_LOCK(GLOBAL_locks_alloc_block);
+  INIT_LOCK(GLOBAL_locks_release_load);
   if (GLOBAL_number_workers == 1)
     GLOBAL_parallel_mode = PARALLEL_MODE_OFF;
   else
@@ -172,6 +252,11 @@ void Yap_init_global_optyap_data(int max_table_size, int n_workers,
   for (i = 0; i < TRIE_LOCK_BUCKETS; i++)
     INIT_LOCK(GLOBAL_trie_locks(i));
 #endif /* TRIE_LOCK_USING_GLOBAL_ARRAY */
+#ifdef TABLING_PROFILER
+  GLOBAL_table_profiler = FALSE;
+  GLOBAL_table_profiler_start = 0;
+  GLOBAL_table_profiler_session = 0;
+#endif /* TABLING_PROFILER */
 #endif /* TABLING */
 
   return;
@@ -214,6 +299,14 @@ void Yap_init_local_optyap_data(int wid) {
   REMOTE_top_or_fr(wid) = GLOBAL_root_or_fr;
   REMOTE_load(wid) = 0;
   REMOTE_share_request(wid) = MAX_WORKERS;
+  REMOTE_share_time(wid) = 0;
+  REMOTE_share_cost(wid) = 0;
+#ifdef YAPOR_NUMA_PLACEMENT
+  place_worker(wid);
+#else
+  REMOTE_cpu(wid) = -1;
+  REMOTE_numa_node(wid) = 0;
+#endif /* YAPOR_NUMA_PLACEMENT */
   REMOTE_reply_signal(wid) = worker_ready;
 #ifdef YAPOR_COPY
   INIT_LOCK(REMOTE_lock_signals(wid));
@@ -283,6 +376,25 @@ void Yap_init_root_frames(void) {
 #endif /* TABLING */
 }
 
+#ifdef YAPOR
+void Yap_bind_yapor_worker(int wid) {
+  /* must be called by the worker itself, before it touches its stacks,
+     so that the first touch policy of the kernel allocates them in the
+     memory of its NUMA node */
+#ifdef YAPOR_NUMA_PLACEMENT
+  cpu_set_t cpus;
+
+  if (GLOBAL_number_workers == 1 || REMOTE_cpu(wid) == -1)
+    return;
+  CPU_ZERO(&cpus);
+  CPU_SET(REMOTE_cpu(wid), &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+    REMOTE_cpu(wid) = -1;
+#endif /* YAPOR_NUMA_PLACEMENT */
+  return;
+}
+#endif /* YAPOR */
+
 void itos(int i, char *s) {
   int n, r, j;
   n = 10;
@@ -30,6 +30,9 @@
 #endif /* YAPOR */
 #ifdef TABLING
 #include "tab.macros.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
 #endif /* TABLING */
 #include "iopreds.h"
 
@@ -46,6 +49,12 @@ static Int p_show_tabled_predicates(USES_REGS1);
 static Int p_show_table(USES_REGS1);
 static Int p_show_all_tables(USES_REGS1);
 static Int p_show_global_trie(USES_REGS1);
+static Int p_save_tables(USES_REGS1);
+static Int p_load_tables(USES_REGS1);
+static Int p_parallel_tabling_workers(USES_REGS1);
+static Int p_table_profile(USES_REGS1);
+static Int p_table_profile_statistics(USES_REGS1);
+static Int p_table_profile_csv(USES_REGS1);
 static Int p_show_statistics_table(USES_REGS1);
 static Int p_show_statistics_tabling(USES_REGS1);
 static Int p_show_statistics_global_trie(USES_REGS1);
@@ -251,6 +260,18 @@ void Yap_init_optyap_preds(void) {
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("show_global_trie", 1, p_show_global_trie,
                 SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_save_tables", 2, p_save_tables,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_load_tables", 3, p_load_tables,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_parallel_tabling_workers", 1, p_parallel_tabling_workers,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_table_profile", 1, p_table_profile,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_table_profile_statistics", 1, p_table_profile_statistics,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_table_profile_csv", 1, p_table_profile_csv,
+                SafePredFlag | SyncPredFlag);
   Yap_InitCPred("$c_table_statistics", 3, p_show_statistics_table,
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("tabling_statistics", 1, p_show_statistics_tabling,
@@ -327,6 +348,8 @@ static Int p_table(USES_REGS1) {
   tab_ent_ptr tab_ent;
 #ifdef MODE_DIRECTED_TABLING
   int *mode_directed = NULL;
+  int lattice = -1;
+  Int lattice_param = 0;
 #endif /* MODE_DIRECTED_TABLING */
 
   mod = Deref(ARG1);
@@ -357,7 +380,8 @@ static Int p_table(USES_REGS1) {
          2. arguments with mode 'min' and 'max' (any number, following the
     original order)
          3. arguments with mode 'all'           (any number)
-         4. arguments with mode 'sum' or 'last' (only one of the two is allowed)
+         4. arguments with mode 'sum', 'last' or 'lattice' (only one of them
+    is allowed)
          5. arguments with mode 'first'         (any number)
     *************************************************************************************/
     int pos_index = 0;
@@ -370,19 +394,34 @@ static Int p_table(USES_REGS1) {
 
     aux_mode_directed = malloc(arity * sizeof(int));
     for (i = 0; i < arity; i++) {
-      int mode = IntOfTerm(HeadOfTerm(list));
+      Term head = HeadOfTerm(list);
+      int mode;
+      if (IsApplTerm(head)) { /* Mode-Operator (mode 'lattice') */
+        mode = IntOfTerm(ArgOfTerm(1, head));
+        lattice = lattice_operator(ArgOfTerm(2, head), &lattice_param);
+        if (lattice < 0) {
+          free(aux_mode_directed);
+          Yap_Error(SYSTEM_ERROR_COMPILER, TermNil,
+                    "invalid tabling declaration for %s/%d (unknown lattice "
+                    "operator)",
+                    AtomName(at), arity);
+          return (FALSE);
+        }
+      } else
+        mode = IntOfTerm(head);
       if (mode == MODE_DIRECTED_INDEX)
         pos_index++;
       else if (mode == MODE_DIRECTED_MIN || mode == MODE_DIRECTED_MAX)
         pos_min_max++;
       else if (mode == MODE_DIRECTED_ALL)
         pos_all++;
-      else if (mode == MODE_DIRECTED_SUM || mode == MODE_DIRECTED_LAST) {
+      else if (mode == MODE_DIRECTED_SUM || mode == MODE_DIRECTED_LAST ||
+               mode == MODE_DIRECTED_LATTICE) {
         if (pos_sum_last) {
           free(aux_mode_directed);
           Yap_Error(SYSTEM_ERROR_COMPILER, TermNil,
                     "invalid tabling declaration for %s/%d (more than one "
-                    "argument with modes 'sum' and/or 'last')",
+                    "argument with modes 'sum', 'last' and/or 'lattice')",
                     AtomName(at), arity);
           return (FALSE);
         } else
@@ -407,7 +446,8 @@ static Int p_table(USES_REGS1) {
       else if (aux_mode_directed[i] == MODE_DIRECTED_ALL)
         aux_pos = pos_all++;
       else if (aux_mode_directed[i] == MODE_DIRECTED_SUM ||
-               aux_mode_directed[i] == MODE_DIRECTED_LAST)
+               aux_mode_directed[i] == MODE_DIRECTED_LAST ||
+               aux_mode_directed[i] == MODE_DIRECTED_LATTICE)
         aux_pos = pos_sum_last++;
       else if (aux_mode_directed[i] == MODE_DIRECTED_FIRST)
         aux_pos = pos_first++;
@@ -423,6 +463,10 @@ static Int p_table(USES_REGS1) {
   if (!(pe->PredFlags & TabledPredFlag)) {
     pe->PredFlags |= TabledPredFlag;
     new_table_entry(tab_ent, pe, at, arity, mode_directed);
+#ifdef MODE_DIRECTED_TABLING
+    TabEnt_lattice(tab_ent) = lattice;
+    TabEnt_lattice_param(tab_ent) = lattice_param;
+#endif /* MODE_DIRECTED_TABLING */
     pe->TableOfPred = tab_ent;
   }
   return (TRUE);
@@ -622,6 +666,130 @@ static Int p_show_global_trie(USES_REGS1) {
   return (TRUE);
 }
 
+static Int p_save_tables(USES_REGS1) {
+  Term t = Deref(ARG1);
+  FILE *out;
+
+  if (!IsStreamTerm(t))
+    return FALSE;
+  if (!(out = Yap_GetStreamHandle(t)->file))
+    return FALSE;
+  return save_tables(Deref(ARG2), out);
+}
+
+static Int p_load_tables(USES_REGS1) {
+  Term t = Deref(ARG1), t_loaded = Deref(ARG2), t_skipped = Deref(ARG3);
+  Term loaded, skipped;
+  FILE *in;
+
+  if (!IsStreamTerm(t))
+    return FALSE;
+  if (!(in = Yap_GetStreamHandle(t)->file))
+    return FALSE;
+  /* load_tables() uses the argument registers to search the subgoals */
+  if (!load_tables(in, &loaded, &skipped))
+    return FALSE;
+  return Yap_unify(t_loaded, loaded) && Yap_unify(t_skipped, skipped);
+}
+
+static Int p_parallel_tabling_workers(USES_REGS1) {
+#if defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING)
+  /* answers are only visible to other threads if the subgoal frames are
+     shared, otherwise each thread would compute its own tables */
+  long workers = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  workers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers < 1)
+    workers = 1;
+#endif /* _SC_NPROCESSORS_ONLN */
+  return Yap_unify(ARG1, MkIntegerTerm(workers));
+#else
+  return (FALSE);
+#endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
+}
+
+static Int p_table_profile(USES_REGS1) {
+#ifdef TABLING_PROFILER
+  if (IntOfTerm(Deref(ARG1))) {
+    tab_ent_ptr tab_ent = GLOBAL_root_tab_ent;
+    while (tab_ent) {
+      memset(&TabEnt_profile(tab_ent), 0, sizeof(struct table_profile));
+      tab_ent = TabEnt_next(tab_ent);
+    }
+    /* the subgoal frames drop their counts when they see the new session */
+    GLOBAL_table_profiler_session++;
+    GLOBAL_table_profiler_start = Yap_walltime();
+    GLOBAL_table_profiler = TRUE;
+  } else
+    GLOBAL_table_profiler = FALSE;
+  return (TRUE);
+#else
+  return (FALSE);
+#endif /* TABLING_PROFILER */
+}
+
+static Int p_table_profile_statistics(USES_REGS1) {
+#ifdef TABLING_PROFILER
+  Functor f = Yap_MkFunctor(Yap_LookupAtom("table_profile"), 8);
+  tab_ent_ptr tab_ent = GLOBAL_root_tab_ent;
+  Term list = TermNil;
+
+  while (tab_ent) {
+    struct table_profile *prof = &TabEnt_profile(tab_ent);
+    if (prof->subgoals || prof->answers || prof->duplicates ||
+        prof->consumers) {
+      Term mod = TabEnt_pe(tab_ent)->ModuleOfPred;
+      Term aux[8], pred;
+      if (HR + 64 > ASP - 1024) {
+        Yap_Error(RESOURCE_ERROR_STACK, TermNil, "table_profile_statistics");
+        return (FALSE);
+      }
+      aux[0] = MkAtomTerm(TabEnt_atom(tab_ent));
+      aux[1] = MkIntTerm(TabEnt_arity(tab_ent));
+      pred = Yap_MkApplTerm(FunctorSlash, 2, aux);
+      aux[0] = mod ? mod : TermProlog;
+      aux[1] = pred;
+      aux[0] = Yap_MkApplTerm(FunctorModule, 2, aux);
+      aux[1] = MkIntegerTerm(prof->subgoals);
+      aux[2] = MkIntegerTerm(prof->subgoals_complete);
+      aux[3] = MkIntegerTerm(prof->answers);
+      aux[4] = MkIntegerTerm(prof->duplicates);
+      aux[5] = MkIntegerTerm(prof->consumers);
+      aux[6] = MkFloatTerm((Float)prof->time / 1.0e9);
+      aux[7] = MkFloatTerm((Float)prof->max_time / 1.0e9);
+      list = MkPairTerm(Yap_MkApplTerm(f, 8, aux), list);
+    }
+    tab_ent = TabEnt_next(tab_ent);
+  }
+  return Yap_unify(ARG1, list);
+#else
+  return (FALSE);
+#endif /* TABLING_PROFILER */
+}
+
+static Int p_table_profile_csv(USES_REGS1) {
+#ifdef TABLING_PROFILER
+  tab_ent_ptr tab_ent;
+  Term t = Deref(ARG1);
+  FILE *out;
+
+  if (!IsStreamTerm(t))
+    return FALSE;
+  if (!(out = Yap_GetStreamHandle(t)->file))
+    return FALSE;
+  fprintf(out, "predicate,subgoal,state,answers,duplicates,consumers,time,"
+               "completion\n");
+  tab_ent = GLOBAL_root_tab_ent;
+  while (tab_ent) {
+    profileTable(tab_ent, out);
+    tab_ent = TabEnt_next(tab_ent);
+  }
+  return (TRUE);
+#else
+  return (FALSE);
+#endif /* TABLING_PROFILER */
+}
+
 static Int p_show_statistics_table(USES_REGS1) {
   Term mod, t;
   tab_ent_ptr tab_ent;
@@ -787,6 +955,7 @@ static Int p_yapor_workers(USES_REGS1) {
 }
 
 static Int p_worker(USES_REGS1) {
+  Yap_bind_yapor_worker(worker_id);
   CurrentModule = USER_MODULE;
   P = GETWORK_FIRST_TIME;
   return TRUE;
@@ -20,6 +20,9 @@
 void Yap_init_global_optyap_data(int, int, int, int);
 void Yap_init_local_optyap_data(int);
 void Yap_init_root_frames(void);
+#ifdef YAPOR
+void Yap_bind_yapor_worker(int);
+#endif /* YAPOR */
 void itos(int, char *);
 
 
@@ -43,20 +46,39 @@ sg_fr_ptr subgoal_search(yamop *, CELL **);
 ans_node_ptr answer_search(sg_fr_ptr, CELL *);
 #ifdef MODE_DIRECTED_TABLING
 ans_node_ptr mode_directed_answer_search(sg_fr_ptr, CELL *);
+int lattice_operator(Term, Int *);
 #endif /* MODE_DIRECTED_TABLING */
 void load_answer(ans_node_ptr, CELL *);
 CELL *exec_substitution(gt_node_ptr, CELL *);
 void update_answer_trie(sg_fr_ptr);
+#ifdef TABLING_ANSWER_ARRAYS
+ans_arr_ptr freeze_answer_trie(sg_fr_ptr);
+void load_answer_row(Term *, CELL *);
+#endif /* TABLING_ANSWER_ARRAYS */
 void free_subgoal_trie(sg_node_ptr, int, int);
 void free_answer_trie(ans_node_ptr, int, int);
 void free_answer_hash_chain(ans_hash_ptr);
 void abolish_table(tab_ent_ptr);
 void showTable(tab_ent_ptr, int, FILE *);
+#ifdef TABLING_PROFILER
+void profileTable(tab_ent_ptr, FILE *);
+#endif /* TABLING_PROFILER */
 void showGlobalTrie(int, FILE *);
 #endif /* TABLING */
 
 
 
+/****************************
+**      tab.persist.c      **
+****************************/
+
+#ifdef TABLING
+int save_tables(Term, FILE *);
+int load_tables(FILE *, Term *, Term *);
+#endif /* TABLING */
+
+
+
 /*******************************
 **      tab.completion.c      **
 *******************************/
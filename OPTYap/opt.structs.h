@@ -243,6 +243,7 @@ struct global_optyap_locks {
   int who_locked_heap;
   lockvar heap_access;
   lockvar alloc_block;
+  lockvar release_load;
 };
 #endif /* YAPOR */
 
@@ -297,6 +298,7 @@ struct global_optyap_data {
 
   /* global data related to or-parallelism */
   realtime execution_time;
+  volatile int release_load;
 #ifdef YAPOR_THREADS
   Int  root_choice_point_offset;
 #else
@@ -340,6 +342,11 @@ struct global_optyap_data {
 #ifdef TIMESTAMP_CHECK
   long timestamp;
 #endif /* TIMESTAMP_CHECK */
+#ifdef TABLING_PROFILER
+  int table_profiler;
+  uint64_t table_profiler_start;
+  long table_profiler_session;
+#endif /* TABLING_PROFILER */
 #endif /* TABLING */
 };
 
@@ -364,6 +371,7 @@ struct global_optyap_data {
 #define GLOBAL_pages_tg_ans_fr                  (GLOBAL_optyap_data.pages.table_subgoal_answer_frame_pages)
 #define GLOBAL_scheduler_loop                   (GLOBAL_optyap_data.scheduler_loop)
 #define GLOBAL_delayed_release_load             (GLOBAL_optyap_data.delayed_release_load)
+#define GLOBAL_release_load                     (GLOBAL_optyap_data.release_load)
 #define GLOBAL_number_workers                   (GLOBAL_optyap_data.number_workers)
 #define GLOBAL_worker_pid(worker)               (GLOBAL_optyap_data.worker_pid[worker])
 #define GLOBAL_master_worker                    (GLOBAL_optyap_data.master_worker)
@@ -393,6 +401,7 @@ struct global_optyap_data {
 #define GLOBAL_locks_who_locked_heap            (GLOBAL_optyap_data.locks.who_locked_heap)
 #define GLOBAL_locks_heap_access                (GLOBAL_optyap_data.locks.heap_access)
 #define GLOBAL_locks_alloc_block                (GLOBAL_optyap_data.locks.alloc_block)
+#define GLOBAL_locks_release_load               (GLOBAL_optyap_data.locks.release_load)
 #define GLOBAL_branch(worker, depth)            (GLOBAL_optyap_data.branch[worker][depth])
 #define GLOBAL_parallel_mode                    (GLOBAL_optyap_data.parallel_mode)
 #define GLOBAL_root_gt                          (GLOBAL_optyap_data.root_global_trie)
@@ -407,6 +416,9 @@ struct global_optyap_data {
 #define GLOBAL_table_var_enumerator_addr(index) (GLOBAL_optyap_data.table_var_enumerator + (index))
 #define GLOBAL_trie_locks(index)                (GLOBAL_optyap_data.trie_locks[index])
 #define GLOBAL_timestamp                        (GLOBAL_optyap_data.timestamp)
+#define GLOBAL_table_profiler                   (GLOBAL_optyap_data.table_profiler)
+#define GLOBAL_table_profiler_start             (GLOBAL_optyap_data.table_profiler_start)
+#define GLOBAL_table_profiler_session           (GLOBAL_optyap_data.table_profiler_session)
 
 
 
@@ -436,6 +448,10 @@ struct local_optyap_data {
   choiceptr prune_request;
 #endif /* YAPOR_THREADS */
   volatile int share_request;
+  uint64_t share_time;  /* when the last shared work was installed */
+  uint64_t share_cost;  /* how long it took to get it */
+  int cpu;              /* processor the worker is bound to (-1 if none) */
+  int numa_node;        /* memory node of that processor */
   struct local_optyap_signals share_signals;
   volatile struct {
     CELL start;
@@ -503,6 +519,10 @@ struct local_optyap_data {
 #define Set_LOCAL_prune_request(cpt)       (LOCAL_optyap_data.prune_request = cpt)
 #endif /* YAPOR_THREADS */
 #define LOCAL_share_request                (LOCAL_optyap_data.share_request)
+#define LOCAL_share_time                   (LOCAL_optyap_data.share_time)
+#define LOCAL_share_cost                   (LOCAL_optyap_data.share_cost)
+#define LOCAL_cpu                          (LOCAL_optyap_data.cpu)
+#define LOCAL_numa_node                    (LOCAL_optyap_data.numa_node)
 #define LOCAL_reply_signal                 (LOCAL_optyap_data.share_signals.reply_signal)
 #define LOCAL_p_fase_signal                (LOCAL_optyap_data.share_signals.P_fase)
 #define LOCAL_q_fase_signal                (LOCAL_optyap_data.share_signals.Q_fase)
@@ -562,6 +582,10 @@ struct local_optyap_data {
 #define Set_REMOTE_prune_request(wid,cp)       (REMOTE(wid)->optyap_data_.prune_request = cp)
 #endif /* YAPOR_THREADS */
 #define REMOTE_share_request(wid)              (REMOTE(wid)->optyap_data_.share_request)
+#define REMOTE_share_time(wid)                 (REMOTE(wid)->optyap_data_.share_time)
+#define REMOTE_share_cost(wid)                 (REMOTE(wid)->optyap_data_.share_cost)
+#define REMOTE_cpu(wid)                        (REMOTE(wid)->optyap_data_.cpu)
+#define REMOTE_numa_node(wid)                  (REMOTE(wid)->optyap_data_.numa_node)
 #define REMOTE_reply_signal(wid)               (REMOTE(wid)->optyap_data_.share_signals.reply_signal)
 #define REMOTE_p_fase_signal(wid)              (REMOTE(wid)->optyap_data_.share_signals.P_fase)
 #define REMOTE_q_fase_signal(wid)              (REMOTE(wid)->optyap_data_.share_signals.Q_fase)
@@ -26,6 +26,15 @@
 
 
 
+/* ----------------- **
+**      Defines      **
+** ----------------- */
+
+#define SHARE_WORK_COST_RATIO  4
+#define MAX_RELEASE_LOAD       1024
+
+
+
 /* ------------------------------------- **
 **      Local functions declaration      **
 ** ------------------------------------- */
@@ -35,6 +44,7 @@ static int get_work_below(void);
 static int get_work_above(void);
 static int find_a_better_position(void);
 static int search_for_hidden_shared_work(bitmap stable_busy);
+static int share_work(int worker_p);
 
 
 
@@ -46,6 +56,8 @@ static inline void PUT_NO_WORK_IN_UPPER_NODES(void);
 static inline void PUT_IDLE(int);
 static inline void PUT_BUSY(int);
 static inline void move_up_to_prune_request(void);
+static inline void update_release_load(void);
+static inline int better_victim(int, int);
 
 
 static inline
@@ -61,6 +73,53 @@ void PUT_NO_WORK_IN_UPPER_NODES(void) {
 }
 
 
+static inline
+void update_release_load(void) {
+  /* a share is too fine grained when the work it gave lasted less than
+     SHARE_WORK_COST_RATIO times what it took to get it; then workers only
+     release work with larger loads, otherwise the threshold moves back to
+     the initial one */
+  CACHE_REGS
+  uint64_t work_time;
+
+  if (LOCAL_share_time == 0)
+    return;
+  work_time = Yap_walltime() - LOCAL_share_time;
+  LOCAL_share_time = 0;
+  LOCK(GLOBAL_locks_release_load);
+  if (work_time < SHARE_WORK_COST_RATIO * LOCAL_share_cost) {
+    if (GLOBAL_release_load < MAX_RELEASE_LOAD)
+      GLOBAL_release_load = GLOBAL_release_load * 2 + 1;
+  } else if (GLOBAL_release_load > GLOBAL_delayed_release_load)
+    GLOBAL_release_load--;
+  UNLOCK(GLOBAL_locks_release_load);
+  return;
+}
+
+
+static inline
+int better_victim(int worker_num, int worker_p) {
+  /* a worker only gives work with a load above the release threshold; among
+     those, workers in our NUMA node are preferred to the others, then the
+     highest load wins and, if tied, the oldest work */
+  CACHE_REGS
+  int local_num, local_p;
+
+  if (REMOTE_load(worker_num) <= GLOBAL_release_load)
+    return FALSE;
+  if (worker_p == -1)
+    return TRUE;
+  /* workers in two other nodes are as far, and compare by load */
+  local_num = REMOTE_numa_node(worker_num) == LOCAL_numa_node;
+  local_p = REMOTE_numa_node(worker_p) == LOCAL_numa_node;
+  if (local_num != local_p)
+    return local_num;
+  return REMOTE_load(worker_num) > REMOTE_load(worker_p) ||
+         (REMOTE_load(worker_num) == REMOTE_load(worker_p) &&
+          OrFr_depth(REMOTE_top_or_fr(worker_num)) < OrFr_depth(REMOTE_top_or_fr(worker_p)));
+}
+
+
 static inline
 void PUT_IDLE(int worker_num) {
   LOCK(GLOBAL_locks_bm_idle_workers);
@@ -169,6 +228,7 @@ int get_work(void) {
   }
 
   /* no nodes with available work */
+  update_release_load();
   PUT_NO_WORK_IN_UPPER_NODES();
 #ifdef TABLING
   if (leader_node) {
@@ -508,11 +568,10 @@ int move_up_one_node(or_fr_ptr nearest_livenode) {
 static
 int get_work_below(void){
   CACHE_REGS
-  int i, worker_p, big_load;
+  int i, worker_p;
   bitmap busy_below, idle_below;
 
   worker_p = -1;
-  big_load = GLOBAL_delayed_release_load ;
   BITMAP_difference(busy_below, OrFr_members(LOCAL_top_or_fr), GLOBAL_bm_idle_workers);
   BITMAP_difference(idle_below, OrFr_members(LOCAL_top_or_fr), busy_below);
   BITMAP_delete(idle_below, worker_id);
@@ -522,27 +581,24 @@ int get_work_below(void){
   }
   if (BITMAP_empty(busy_below))
     return FALSE;
-  /* choose the worker with highest load */
+  /* choose the worker with highest load (see better_victim) */
   for (i = 0 ; i < GLOBAL_number_workers; i++) {
-    if (BITMAP_member(busy_below ,i) && REMOTE_load(i) > big_load) {
+    if (BITMAP_member(busy_below ,i) && better_victim(i, worker_p))
       worker_p = i;
-      big_load = REMOTE_load(i);
-    }
   }
   if (worker_p == -1) 
     return FALSE;
-  return (q_share_work(worker_p));
+  return (share_work(worker_p));
 }
 
 
 static
 int get_work_above(void){
   CACHE_REGS
-  int i, worker_p, big_load;
+  int i, worker_p;
   bitmap visible_busy_above, visible_idle_above;
 
   worker_p = -1; 
-  big_load = GLOBAL_delayed_release_load ;
   BITMAP_difference(visible_busy_above, GLOBAL_bm_present_workers, OrFr_members(LOCAL_top_or_fr));
   BITMAP_minus(visible_busy_above, GLOBAL_bm_invisible_workers);
   BITMAP_copy(visible_idle_above, visible_busy_above); 
@@ -556,12 +612,10 @@ int get_work_above(void){
   if (!BITMAP_member(visible_busy_above, worker_id) || BITMAP_alone(visible_busy_above, worker_id))
     return FALSE;
   BITMAP_delete(visible_busy_above, worker_id);
-  /* choose the worker with higher load */
+  /* choose the worker with higher load (see better_victim) */
   for (i = 0; i < GLOBAL_number_workers; i++) {
-    if (BITMAP_member(visible_busy_above ,i) && REMOTE_load(i) > big_load) {
+    if (BITMAP_member(visible_busy_above ,i) && better_victim(i, worker_p))
       worker_p = i;
-      big_load = REMOTE_load(i);
-    }
   }
   if (worker_p == -1)
     return FALSE;
@@ -585,7 +639,7 @@ int get_work_above(void){
   BITMAP_delete(GLOBAL_bm_invisible_workers, worker_id);
   BITMAP_delete(GLOBAL_bm_invisible_workers, worker_p);
   UNLOCK(GLOBAL_locks_bm_invisible_workers);
-  return (q_share_work(worker_p));
+  return (share_work(worker_p));
 }
 
 
@@ -638,6 +692,50 @@ int search_for_hidden_shared_work(bitmap stable_busy){
     if (BITMAP_member(invisible_work ,i))
       break;
   }
-  return (q_share_work(i));
+  return (share_work(i));
+}
+
+
+static
+int share_work(int worker_p) {
+  CACHE_REGS
+  uint64_t start = Yap_walltime();
+#ifndef TABLING
+  or_fr_ptr or_fr, old_top_or_fr = LOCAL_top_or_fr, oldest_or_fr = NULL;
+#endif /* TABLING */
+
+  if (! q_share_work(worker_p))
+    return FALSE;
+  LOCAL_share_time = Yap_walltime();
+  LOCAL_share_cost = LOCAL_share_time - start;
+#ifndef TABLING
+  /* all the private nodes of worker p were shared; start with the oldest
+     one with untried alternatives, as it usually roots the largest subtree,
+     and leave the younger ones to worker p. With tabling, the subgoal,
+     dependency and suspension frames of the younger nodes would need the
+     bookkeeping of move_up_one_node(), so the worker starts at the top */
+  for (or_fr = LOCAL_top_or_fr; or_fr && or_fr != old_top_or_fr; or_fr = OrFr_next(or_fr)) {
+    yamop *alt = OrFr_alternative(or_fr);
+    if (alt && ! YAMOP_SEQ(alt))
+      oldest_or_fr = or_fr;
+  }
+  if (oldest_or_fr == NULL || Get_LOCAL_prune_request())
+    return TRUE;
+  /* leave each younger node while worker p is still there to run it, and
+     install at the first one we would be left alone in, as q_share_work()
+     does: shared_fail then backtracks to the new top */
+  while (LOCAL_top_or_fr != oldest_or_fr) {
+    LOCK_OR_FRAME(LOCAL_top_or_fr);
+    if (BITMAP_alone(OrFr_members(LOCAL_top_or_fr), worker_id) ||
+        Get_OrFr_pend_prune_cp(LOCAL_top_or_fr)) {
+      UNLOCK_OR_FRAME(LOCAL_top_or_fr);
+      break;
+    }
+    BITMAP_delete(OrFr_members(LOCAL_top_or_fr), worker_id);
+    UNLOCK_OR_FRAME(LOCAL_top_or_fr);
+    SCH_update_local_or_tops();
+  }
+#endif /* TABLING */
+  return TRUE;
 }
 #endif /* YAPOR */
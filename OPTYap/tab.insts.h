@@ -209,6 +209,7 @@
           new_dependency_frame(new_dep_fr, DEP_ON_STACK, LOCAL_top_or_fr,        \
                                LEADER_CP, ccp, SG_FR, FALSE, LOCAL_top_dep_fr);  \
           LOCAL_top_dep_fr = new_dep_fr;                                         \
+          TABLE_PROFILE_CONSUMER(SG_FR);                                         \
           /* store consumer choice point */                                      \
           HBREG = HR;                                                             \
           store_yaam_reg_cpdepth(ccp);                                           \
@@ -296,6 +297,7 @@
           lcp->cp_env= ENV;                                   \
           lcp->cp_cp = CPREG;                                 \
           LOAD_CP(lcp)->cp_last_answer = ANSWER;              \
+          LoadCp_init_answer_array_fields(lcp);               \
           store_low_level_trace_info(LOAD_CP(lcp), TAB_ENT);  \
           /* set_cut((CELL *)lcp, B); --> no effect */        \
           B = lcp;                                            \
@@ -305,6 +307,31 @@
         }
 
 
+#ifdef TABLING_ANSWER_ARRAYS
+#define LoadCp_init_answer_array_fields(CP)                                    \
+        LOAD_CP(CP)->cp_last_row = NULL
+
+#define load_answers_from_array(TAB_ENT, SG_FR, ANSWER)                        \
+        if (SgFr_answer_array(SG_FR) &&                                        \
+            AnsArr_subs_arity(SgFr_answer_array(SG_FR)) == (int) *YENV) {      \
+          ans_arr_ptr ans_arr = SgFr_answer_array(SG_FR);                      \
+          if (AnsArr_num_answers(ans_arr) > 1) {                               \
+            store_loader_node(TAB_ENT, ANSWER);                                \
+            LOAD_CP(B)->cp_last_row = AnsArr_answers(ans_arr);                 \
+            LOAD_CP(B)->cp_end_row = AnsArr_last_row(ans_arr);                 \
+          }                                                                    \
+          PREG = (yamop *) CPREG;                                              \
+          PREFETCH_OP(PREG);                                                   \
+          load_answer_row(AnsArr_answers(ans_arr), YENV);                      \
+          YENV = ENV;                                                          \
+          GONext();                                                            \
+        }
+#else
+#define LoadCp_init_answer_array_fields(CP)
+#define load_answers_from_array(TAB_ENT, SG_FR, ANSWER)
+#endif /* TABLING_ANSWER_ARRAYS */
+
+
 #define restore_loader_node(ANSWER)           \
         HR = HBREG = PROTECT_FROZEN_H(B);      \
         restore_yaam_reg_cpdepth(B);          \
@@ -383,6 +410,23 @@
     }
 #endif /* YAPOR */
     subs_ptr = (CELL *) (LOAD_CP(B) + 1);
+#ifdef TABLING_ANSWER_ARRAYS
+    if (LOAD_CP(B)->cp_last_row) {
+      /* answers frozen in an answer array --> load the next row */
+      Term *row = LOAD_CP(B)->cp_last_row + *subs_ptr;
+      if (row != LOAD_CP(B)->cp_end_row) {
+        restore_loader_node(LOAD_CP(B)->cp_last_answer);
+        LOAD_CP(B)->cp_last_row = row;
+      } else {
+        pop_loader_node();
+      }
+      PREG = (yamop *) CPREG;
+      PREFETCH_OP(PREG);
+      load_answer_row(row, subs_ptr);
+      YENV = ENV;
+      GONext();
+    }
+#endif /* TABLING_ANSWER_ARRAYS */
     ans_node = TrNode_child(LOAD_CP(B)->cp_last_answer);
     if(TrNode_child(ans_node) != NULL) {
       restore_loader_node(ans_node);
@@ -602,6 +646,7 @@
 #endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
           /* load answers from the trie */
 	  UNLOCK_SG_FR(sg_fr);
+	  load_answers_from_array(tab_ent, sg_fr, ans_node);
 	  if(TrNode_child(ans_node) != NULL) {
 	    store_loader_node(tab_ent, ans_node);
 	  }
@@ -754,6 +799,7 @@
 #endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
           /* load answers from the trie */
 	  UNLOCK_SG_FR(sg_fr);
+	  load_answers_from_array(tab_ent, sg_fr, ans_node);
 	  if(TrNode_child(ans_node) != NULL) {
 	    store_loader_node(tab_ent, ans_node);
 	  }
@@ -916,6 +962,7 @@
 #endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
           /* load answers from the trie */
 	  UNLOCK_SG_FR(sg_fr);
+	  load_answers_from_array(tab_ent, sg_fr, ans_node);
 	  if(TrNode_child(ans_node) != NULL) {
 	    store_loader_node(tab_ent, ans_node);
 	  }
@@ -1086,8 +1133,14 @@
 #ifdef MODE_DIRECTED_TABLING
     if (SgFr_mode_directed(sg_fr)) {
       ans_node = mode_directed_answer_search(sg_fr, subs_ptr);
+      if (ans_node == MODE_DIRECTED_ANSWER_ERROR) {
+	/* the error was raised, go to the handler */
+	UNLOCK_ANSWER_TRIE(sg_fr);
+	goto fail;
+      }
       if (ans_node == NULL) {
 	/* no answer inserted */
+	TABLE_PROFILE_REPEATED_ANSWER(sg_fr);
 	UNLOCK_ANSWER_TRIE(sg_fr);
 	goto fail;
       }
@@ -1097,6 +1150,7 @@
     LOCK_ANSWER_NODE(ans_node);
     if (! IS_ANSWER_LEAF_NODE(ans_node)) {
       /* new answer */
+      TABLE_PROFILE_NEW_ANSWER(sg_fr);
 #ifdef TABLING_INNER_CUTS
       /* check for potencial prunings */
       if (! BITMAP_empty(GLOBAL_bm_pruning_workers)) {
@@ -1288,6 +1342,7 @@
       }
     } else {
       /* repeated answer */
+      TABLE_PROFILE_REPEATED_ANSWER(sg_fr);
 #ifdef THREADS_FULL_SHARING
       if (IsMode_Batched(TabEnt_mode(SgFr_tab_ent(sg_fr)))){
 	if (worker_id >= ANSWER_LEAF_NODE_MAX_THREADS) {
@@ -1961,6 +2016,7 @@ complete_all:
 #endif /* LIMIT_TABLING */
 	  if (IsMode_LoadAnswers(TabEnt_mode(tab_ent))) {
             /* load answers from the trie */
+	    load_answers_from_array(tab_ent, sg_fr, ans_node);
 	    if(TrNode_child(ans_node) != NULL) {
 	      store_loader_node(tab_ent, ans_node);
 	    }
@@ -1975,6 +2031,7 @@ complete_all:
 	    if (SgFr_active_workers(sg_fr) > 0) {
 	      /* load answers from the trie */
 	      UNLOCK_SG_FR(sg_fr);
+	      load_answers_from_array(tab_ent, sg_fr, ans_node);
 	      if(TrNode_child(ans_node) != NULL) {
 		store_loader_node(tab_ent, ans_node);
 	      }
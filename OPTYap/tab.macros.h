@@ -117,6 +117,7 @@ static inline tg_sol_fr_ptr CUT_prune_tg_solution_frames(tg_sol_fr_ptr, int);
 /* traverse macros */
 #define SHOW_MODE_STRUCTURE        0
 #define SHOW_MODE_STATISTICS       1
+#define SHOW_MODE_PROFILE          2
 typedef enum {
   TRAVERSE_MODE_NORMAL =       0,
   TRAVERSE_MODE_DOUBLE =       1,
@@ -147,9 +148,12 @@ typedef enum {
 #define MODE_DIRECTED_SUM             5
 #define MODE_DIRECTED_LAST            6
 #define MODE_DIRECTED_FIRST           7
+#define MODE_DIRECTED_LATTICE         8
 #define MODE_DIRECTED_SET(ARG,MODE)   (((ARG) << MODE_DIRECTED_NUMBER_TAGBITS) + MODE)
 #define MODE_DIRECTED_GET_ARG(X)      ((X) >> MODE_DIRECTED_NUMBER_TAGBITS)
 #define MODE_DIRECTED_GET_MODE(X)     ((X) & MODE_DIRECTED_TAGBITS)
+/* returned by mode_directed_answer_search() after raising an error */
+#define MODE_DIRECTED_ANSWER_ERROR    ((ans_node_ptr) -1)
 
 /* LowTagBits is 3 for 32 bit-machines and 7 for 64 bit-machines */
 #define NumberOfLowTagBits         (LowTagBits == 3 ? 2 : 3)
@@ -313,7 +317,9 @@ typedef enum {
 
 #ifdef MODE_DIRECTED_TABLING
 #define TabEnt_init_mode_directed_field(TAB_ENT, MODE_ARRAY)  \
-        TabEnt_mode_directed(TAB_ENT) = MODE_ARRAY
+        TabEnt_mode_directed(TAB_ENT) = MODE_ARRAY;           \
+        TabEnt_lattice(TAB_ENT) = -1;                         \
+        TabEnt_lattice_param(TAB_ENT) = 0
 #define SgEnt_init_mode_directed_fields(SG_ENT, MODE_ARRAY)   \
         SgEnt_invalid_chain(SG_ENT) = NULL;                   \
         SgEnt_mode_directed(SG_ENT) = MODE_ARRAY
@@ -331,6 +337,72 @@ typedef enum {
 #define AnsHash_init_previous_field(HASH, SG_FR)
 #endif /* MODE_DIRECTED_TABLING */
 
+#ifdef TABLING_ANSWER_ARRAYS
+#define SgFr_init_answer_array_field(SG_FR)  \
+        SgFr_answer_array(SG_FR) = NULL
+#else
+#define SgFr_init_answer_array_field(SG_FR)
+#endif /* TABLING_ANSWER_ARRAYS */
+
+#ifdef TABLING_PROFILER
+#define SgFr_init_profile_fields(SG_FR)                                       \
+        memset(&SgFr_profile(SG_FR), 0, sizeof(struct subgoal_profile))
+/* counts left by an earlier table_profile(on) session are dropped */
+#define SgFr_check_profile_session(SG_FR)                                     \
+        if (SgFr_profile(SG_FR).session != GLOBAL_table_profiler_session) {   \
+          SgFr_init_profile_fields(SG_FR);                                    \
+          SgFr_profile(SG_FR).session = GLOBAL_table_profiler_session;        \
+        }
+#define TABLE_PROFILE_SUBGOAL_CALL(SG_FR)                                     \
+        if (GLOBAL_table_profiler) {                                          \
+          SgFr_check_profile_session(SG_FR);                                  \
+          SgFr_profile(SG_FR).start = Yap_walltime();                         \
+          TabEnt_profile(SgFr_tab_ent(SG_FR)).subgoals++;                     \
+        }
+#define TABLE_PROFILE_NEW_ANSWER(SG_FR)                                       \
+        if (GLOBAL_table_profiler) {                                          \
+          SgFr_check_profile_session(SG_FR);                                  \
+          SgFr_profile(SG_FR).answers++;                                      \
+          TabEnt_profile(SgFr_tab_ent(SG_FR)).answers++;                      \
+        }
+#define TABLE_PROFILE_REPEATED_ANSWER(SG_FR)                                  \
+        if (GLOBAL_table_profiler) {                                          \
+          SgFr_check_profile_session(SG_FR);                                  \
+          SgFr_profile(SG_FR).duplicates++;                                   \
+          TabEnt_profile(SgFr_tab_ent(SG_FR)).duplicates++;                   \
+        }
+#define TABLE_PROFILE_CONSUMER(SG_FR)                                         \
+        if (GLOBAL_table_profiler) {                                          \
+          SgFr_check_profile_session(SG_FR);                                  \
+          SgFr_profile(SG_FR).consumers++;                                    \
+          TabEnt_profile(SgFr_tab_ent(SG_FR)).consumers++;                    \
+        }
+#define TABLE_PROFILE_SUBGOAL_COMPLETION(SG_FR)                               \
+        if (GLOBAL_table_profiler) {                                          \
+          SgFr_check_profile_session(SG_FR);                                  \
+          if (SgFr_profile(SG_FR).start &&                                    \
+              SgFr_profile(SG_FR).completion == 0) {                          \
+            struct table_profile *prof =                                      \
+                &TabEnt_profile(SgFr_tab_ent(SG_FR));                         \
+            uint64_t time;                                                    \
+            SgFr_profile(SG_FR).completion = Yap_walltime();                  \
+            time =                                                            \
+                SgFr_profile(SG_FR).completion - SgFr_profile(SG_FR).start;   \
+            prof->subgoals_complete++;                                        \
+            prof->time += time;                                               \
+            if (time > prof->max_time)                                        \
+              prof->max_time = time;                                          \
+          }                                                                   \
+        }
+#else
+#define SgFr_init_profile_fields(SG_FR)
+#define TABLE_PROFILE_SUBGOAL_CALL(SG_FR)
+#define TABLE_PROFILE_NEW_ANSWER(SG_FR)
+#define TABLE_PROFILE_REPEATED_ANSWER(SG_FR)
+#define TABLE_PROFILE_CONSUMER(SG_FR)
+#define TABLE_PROFILE_SUBGOAL_COMPLETION(SG_FR)
+#endif /* TABLING_PROFILER */
+
 #if defined(YAPOR) || defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING)
 #define INIT_LOCK_SG_FR(SG_FR)  INIT_LOCK(SgFr_lock(SG_FR))
 #define LOCK_SG_FR(SG_FR)       LOCK(SgFr_lock(SG_FR))
@@ -538,6 +610,8 @@ typedef enum {
           SgFr_first_answer(SG_FR) = NULL;                         \
           SgFr_last_answer(SG_FR) = NULL;                          \
 	  SgFr_init_mode_directed_fields(SG_FR, MODE_ARRAY);	   \
+          SgFr_init_answer_array_field(SG_FR);                     \
+          SgFr_init_profile_fields(SG_FR);                         \
           SgFr_state(SG_FR) = ready;                               \
 	}
 
@@ -546,6 +620,7 @@ typedef enum {
           SgFr_state(SG_FR) = evaluating;                          \
           SgFr_next(SG_FR) = LOCAL_top_sg_fr;                      \
           LOCAL_top_sg_fr = SG_FR;                                 \
+          TABLE_PROFILE_SUBGOAL_CALL(SG_FR);                       \
 	}
 #endif /* THREADS_FULL_SHARING) || THREADS_CONSUMER_SHARING */
 
@@ -1061,6 +1136,7 @@ static inline void __mark_as_completed(sg_fr_ptr sg_fr USES_REGS) {
 #endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
   SgFr_state(sg_fr) = complete;
   UNLOCK_SG_FR(sg_fr);
+  TABLE_PROFILE_SUBGOAL_COMPLETION(sg_fr);
 #ifdef MODE_DIRECTED_TABLING
   if (SgFr_invalid_chain(sg_fr)) {
     ans_node_ptr current_node, next_node;
@@ -1091,6 +1167,10 @@ static inline void __mark_as_completed(sg_fr_ptr sg_fr USES_REGS) {
 #endif /* !THREADS_FULL_SHARING && !THREADS_CONSUMER_SHARING */
   }
 #endif /* MODE_DIRECTED_TABLING */
+#ifdef TABLING_ANSWER_ARRAYS
+  if (SgFr_answer_array(sg_fr) == NULL && IsMode_LoadAnswers(TabEnt_mode(SgFr_tab_ent(sg_fr))))
+    SgFr_answer_array(sg_fr) = freeze_answer_trie(sg_fr);
+#endif /* TABLING_ANSWER_ARRAYS */
   return;
 }
 
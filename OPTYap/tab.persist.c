@@ -0,0 +1,839 @@
+/************************************************************************
+**                                                                     **
+**                   The YapTab/YapOr/OPTYap systems                   **
+**                                                                     **
+** YapTab extends the Yap Prolog engine to support sequential tabling  **
+** YapOr extends the Yap Prolog engine to support or-parallelism       **
+** OPTYap extends the Yap Prolog engine to support or-parallel tabling **
+**                                                                     **
+**                                                                     **
+**      Yap Prolog was developed at University of Porto, Portugal      **
+**                                                                     **
+************************************************************************/
+
+/***********************
+**      Includes      **
+***********************/
+
+#include "Yap.h"
+#ifdef TABLING
+#include "Yatom.h"
+#include "YapHeap.h"
+#include "tab.macros.h"
+
+
+
+/************************************************************************
+**                          Table file format                          **
+*************************************************************************
+** A table file starts with TABLE_FILE_MAGIC and TABLE_FILE_VERSION,   **
+** followed by a sequence of table records and a final RECORD_END.     **
+** Integers are written in little-endian order and floats as IEEE-754  **
+** doubles, so the files do not depend on the host that produced them. **
+**                                                                     **
+**   table   : RECORD_TABLE atom(module) atom(name) u32(arity)         **
+**             { RECORD_SUBGOAL path { RECORD_ANSWER path } RECORD_END }**
+**             RECORD_END                                              **
+**   path    : { token } TOKEN_END                                     **
+**   atom    : u32(index) [ u8(wide) u32(length) chars ]               **
+**                                                                     **
+** Atoms are remapped to consecutive indexes in order of appearance,   **
+** and the characters of an atom are only written the first time its   **
+** index shows up. A path is the sequence of trie entries from the     **
+** root to a leaf node, after removing the entries that only make      **
+** sense in memory (the functor marks around extension terms and the   **
+** opaque pointers to strings). Subgoal and answer paths are rebuilt   **
+** as Prolog terms when loading, therefore the file does not depend on **
+** the trie configuration (TRIE_COMPACT_PAIRS) used to save it.        **
+************************************************************************/
+
+#define TABLE_FILE_MAGIC    "YAPTAB\r\n"
+#define TABLE_FILE_VERSION  1
+
+#define RECORD_END          0
+#define RECORD_TABLE        1
+#define RECORD_SUBGOAL      2
+#define RECORD_ANSWER       3
+
+#define TOKEN_END           0
+#define TOKEN_VAR           1
+#define TOKEN_ATOM          2
+#define TOKEN_INT           3
+#define TOKEN_FLOAT         4
+#define TOKEN_LONGINT       5
+#define TOKEN_STRING        6
+#define TOKEN_APPL          7
+#define TOKEN_PAIR          8
+#define TOKEN_PAIR_INIT     9
+#define TOKEN_PAIR_END_LIST 10
+#define TOKEN_PAIR_END_TERM 11
+
+typedef struct table_writer {
+  FILE *out;
+  Atom *atoms;          /* open addressing hash of the atoms already written */
+  UInt *atom_index;
+  UInt atoms_size;
+  UInt number_of_atoms;
+  Term *path;           /* trie entries of the current path (leaf first) */
+  UInt path_size;
+} *tab_wr_ptr;
+
+typedef struct table_token {
+  int kind;
+  int arity;
+  union {
+    Int integer;
+    Float dbl;
+    Atom atom;
+    char *string;
+  } u;
+} *tab_tk_ptr;
+
+typedef struct table_reader {
+  FILE *in;
+  Atom *atoms;          /* atoms indexed as in the file */
+  UInt atoms_size;
+  UInt number_of_atoms;
+  struct table_token *tokens;
+  UInt tokens_size;
+  UInt number_of_tokens;
+  UInt heap_cells;      /* upper bound on the cells needed to rebuild the tokens */
+  int error;
+} *tab_rd_ptr;
+
+#define TABLE_IO_ERROR(MSG)                                                   \
+        { Yap_Error(SYSTEM_ERROR_SAVED_STATE, TermNil, MSG);                  \
+          return FALSE;                                                       \
+        }
+
+
+
+/******************************
+**      Local functions      **
+******************************/
+
+static void put_byte(tab_wr_ptr wr, int c) {
+  putc(c, wr->out);
+}
+
+static void put_u32(tab_wr_ptr wr, UInt n) {
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    putc((int)(n & 0xff), wr->out);
+    n >>= 8;
+  }
+}
+
+static void put_u64(tab_wr_ptr wr, uint64_t n) {
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    putc((int)(n & 0xff), wr->out);
+    n >>= 8;
+  }
+}
+
+static int get_byte(tab_rd_ptr rd) {
+  int c = getc(rd->in);
+
+  if (c == EOF) {
+    rd->error = TRUE;
+    return RECORD_END;
+  }
+  return c;
+}
+
+static UInt get_u32(tab_rd_ptr rd) {
+  UInt n = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    n |= ((UInt)get_byte(rd) & 0xff) << (8 * i);
+  return n;
+}
+
+static uint64_t get_u64(tab_rd_ptr rd) {
+  uint64_t n = 0;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    n |= ((uint64_t)get_byte(rd) & 0xff) << (8 * i);
+  return n;
+}
+
+
+static void put_atom(tab_wr_ptr wr, Atom at) {
+  UInt i, mask;
+
+  if (2 * (wr->number_of_atoms + 1) > wr->atoms_size) {
+    /* keep the hash at most half full */
+    Atom *old_atoms = wr->atoms;
+    UInt *old_index = wr->atom_index;
+    UInt old_size = wr->atoms_size;
+    wr->atoms_size = old_size ? 2 * old_size : 256;
+    wr->atoms = (Atom *)calloc(wr->atoms_size, sizeof(Atom));
+    wr->atom_index = (UInt *)malloc(wr->atoms_size * sizeof(UInt));
+    mask = wr->atoms_size - 1;
+    for (i = 0; i < old_size; i++)
+      if (old_atoms[i]) {
+        UInt j = ((CELL)old_atoms[i] >> 3) & mask;
+        while (wr->atoms[j])
+          j = (j + 1) & mask;
+        wr->atoms[j] = old_atoms[i];
+        wr->atom_index[j] = old_index[i];
+      }
+    free(old_atoms);
+    free(old_index);
+  }
+  mask = wr->atoms_size - 1;
+  i = ((CELL)at >> 3) & mask;
+  while (wr->atoms[i]) {
+    if (wr->atoms[i] == at) {
+      put_u32(wr, wr->atom_index[i]);
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  wr->atoms[i] = at;
+  wr->atom_index[i] = wr->number_of_atoms;
+  put_u32(wr, wr->number_of_atoms++);
+  if (IsWideAtom(at)) {
+    wchar_t *ws = RepAtom(at)->WStrOfAE;
+    UInt len = wcslen(ws);
+    put_byte(wr, TRUE);
+    put_u32(wr, len);
+    while (len--)
+      put_u32(wr, (UInt)*ws++);
+  } else {
+    const char *s = AtomName(at);
+    UInt len = strlen(s);
+    put_byte(wr, FALSE);
+    put_u32(wr, len);
+    fwrite(s, 1, len, wr->out);
+  }
+  return;
+}
+
+
+static Atom get_atom(tab_rd_ptr rd) {
+  UInt index = get_u32(rd);
+  Atom at;
+
+  if (rd->error || index > rd->number_of_atoms) {
+    rd->error = TRUE;
+    return NIL;
+  }
+  if (index < rd->number_of_atoms)
+    return rd->atoms[index];
+  /* first occurrence of the atom: its name follows the index */
+  {
+    int wide = get_byte(rd);
+    UInt i, len = get_u32(rd);
+    if (rd->error)
+      return NIL;
+    if (wide) {
+      wchar_t *ws = (wchar_t *)malloc((len + 1) * sizeof(wchar_t));
+      for (i = 0; i < len; i++)
+        ws[i] = (wchar_t)get_u32(rd);
+      ws[len] = 0;
+      at = rd->error ? NIL : Yap_LookupMaybeWideAtom(ws);
+      free(ws);
+    } else {
+      char *s = (char *)malloc(len + 1);
+      if (fread(s, 1, len, rd->in) != len)
+        rd->error = TRUE;
+      s[len] = '\0';
+      at = rd->error ? NIL : Yap_LookupAtom(s);
+      free(s);
+    }
+  }
+  if (at == NIL) {
+    rd->error = TRUE;
+    return NIL;
+  }
+  if (rd->number_of_atoms == rd->atoms_size) {
+    rd->atoms_size = rd->atoms_size ? 2 * rd->atoms_size : 256;
+    rd->atoms = (Atom *)realloc(rd->atoms, rd->atoms_size * sizeof(Atom));
+  }
+  rd->atoms[rd->number_of_atoms++] = at;
+  return at;
+}
+
+
+static void path_push(tab_wr_ptr wr, UInt *depth, Term t) {
+  if (*depth == wr->path_size) {
+    wr->path_size = wr->path_size ? 2 * wr->path_size : 256;
+    wr->path = (Term *)realloc(wr->path, wr->path_size * sizeof(Term));
+  }
+  wr->path[(*depth)++] = t;
+}
+
+
+/* writes the trie entries in wr->path[0..depth-1] (leaf first) as a path of
+** tokens. The answer tries close the extension terms with a second functor
+** mark, while the subgoal tries do not. */
+static int put_path(tab_wr_ptr wr, UInt depth, int answer_path) {
+  Term *entry = wr->path + depth;
+
+  while (entry != wr->path) {
+    Term t = *--entry;
+    if (IsVarTerm(t)) {
+      if (t >= MakeTableVarTerm(MAX_TABLE_VARS)) {
+        /* global trie references and rational terms are not supported */
+        Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+                  "save_tables: unsupported trie entry");
+        return FALSE;
+      }
+      put_byte(wr, TOKEN_VAR);
+      put_u32(wr, VarIndexOfTableTerm(t));
+    } else if (IsAtomTerm(t)) {
+      put_byte(wr, TOKEN_ATOM);
+      put_atom(wr, AtomOfTerm(t));
+    } else if (IsIntTerm(t)) {
+      put_byte(wr, TOKEN_INT);
+      put_u64(wr, (uint64_t)(int64_t)IntOfTerm(t));
+    } else if (IsPairTerm(t)) {
+#ifdef TRIE_COMPACT_PAIRS
+      if (t == CompactPairInit)
+        put_byte(wr, TOKEN_PAIR_INIT);
+      else if (t == CompactPairEndList)
+        put_byte(wr, TOKEN_PAIR_END_LIST);
+      else /* CompactPairEndTerm */
+        put_byte(wr, TOKEN_PAIR_END_TERM);
+#else
+      put_byte(wr, TOKEN_PAIR);
+#endif /* TRIE_COMPACT_PAIRS */
+    } else if (IsApplTerm(t)) {
+      Functor f = (Functor)RepAppl(t);
+      if (f == FunctorDouble) {
+        union {
+          Term t_dbl[sizeof(Float) / sizeof(Term)];
+          Float dbl;
+          uint64_t bits;
+        } u;
+#if SIZEOF_DOUBLE == 2 * SIZEOF_INT_P
+        u.t_dbl[1] = *--entry;
+#endif /* SIZEOF_DOUBLE x SIZEOF_INT_P */
+        u.t_dbl[0] = *--entry;
+        put_byte(wr, TOKEN_FLOAT);
+        put_u64(wr, u.bits);
+      } else if (f == FunctorLongInt) {
+        put_byte(wr, TOKEN_LONGINT);
+        put_u64(wr, (uint64_t)(int64_t)(Int)*--entry);
+      } else if (f == FunctorString) {
+        const char *s = StringOfTerm(AbsAppl((CELL *)*--entry));
+        UInt len = strlen(s);
+        put_byte(wr, TOKEN_STRING);
+        put_u32(wr, len);
+        fwrite(s, 1, len, wr->out);
+      } else if (f == FunctorBigInt) {
+        Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+                  "save_tables: unsupported bigint or blob entry");
+        return FALSE;
+      } else {
+        put_byte(wr, TOKEN_APPL);
+        put_atom(wr, NameOfFunctor(f));
+        put_u32(wr, ArityOfFunctor(f));
+        continue;
+      }
+      if (answer_path)
+        entry--;
+    } else {
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+                "save_tables: unknown type tag");
+      return FALSE;
+    }
+  }
+  put_byte(wr, TOKEN_END);
+  return TRUE;
+}
+
+
+static int put_subgoal(tab_wr_ptr wr, sg_fr_ptr sg_fr, UInt sg_depth) {
+  ans_node_ptr ans_node, root_node;
+
+  if (!put_path(wr, sg_depth, FALSE))
+    return FALSE;
+  root_node = SgFr_answer_trie(sg_fr);
+  for (ans_node = SgFr_first_answer(sg_fr); ans_node;
+       ans_node = TrNode_child(ans_node)) {
+    ans_node_ptr current_node = ans_node;
+    UInt depth = 0;
+    while (current_node != root_node) {
+      path_push(wr, &depth, TrNode_entry(current_node));
+      current_node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(current_node));
+    }
+    put_byte(wr, RECORD_ANSWER);
+    if (!put_path(wr, depth, TRUE))
+      return FALSE;
+    if (ans_node == root_node)  /* yes answer */
+      break;
+  }
+  put_byte(wr, RECORD_END);
+  return TRUE;
+}
+
+
+static int put_subgoal_trie(tab_wr_ptr wr, sg_node_ptr current_node,
+                            sg_node_ptr root_node) {
+  if (IS_SUBGOAL_TRIE_HASH(current_node)) {
+    sg_node_ptr *bucket, *last_bucket;
+    sg_hash_ptr hash;
+    hash = (sg_hash_ptr)current_node;
+    bucket = Hash_buckets(hash);
+    last_bucket = bucket + Hash_num_buckets(hash);
+    do {
+      if (*bucket && !put_subgoal_trie(wr, *bucket, root_node))
+        return FALSE;
+    } while (++bucket != last_bucket);
+    return TRUE;
+  }
+  while (current_node) {
+    if (IS_SUBGOAL_LEAF_NODE(current_node)) {
+      sg_fr_ptr sg_fr = get_subgoal_frame(current_node);
+      if (sg_fr && SgFr_state(sg_fr) >= complete) {
+        sg_node_ptr aux_node = current_node;
+        UInt depth = 0;
+        while (aux_node != root_node) {
+          path_push(wr, &depth, TrNode_entry(aux_node));
+          aux_node = TrNode_parent(aux_node);
+        }
+        put_byte(wr, RECORD_SUBGOAL);
+        if (!put_subgoal(wr, sg_fr, depth))
+          return FALSE;
+      }
+    } else if (!put_subgoal_trie(wr, TrNode_child(current_node), root_node))
+      return FALSE;
+    current_node = TrNode_next(current_node);
+  }
+  return TRUE;
+}
+
+
+static int put_table(tab_wr_ptr wr, Term mod, tab_ent_ptr tab_ent) {
+  CACHE_REGS
+  sg_node_ptr sg_node;
+
+#ifdef MODE_DIRECTED_TABLING
+  if (TabEnt_mode_directed(tab_ent)) {
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "save_tables: mode-directed tables are not supported");
+    return FALSE;
+  }
+#endif /* MODE_DIRECTED_TABLING */
+  if (IsMode_GlobalTrie(TabEnt_mode(tab_ent))) {
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "save_tables: global trie tables are not supported");
+    return FALSE;
+  }
+  put_byte(wr, RECORD_TABLE);
+  put_atom(wr, AtomOfTerm(mod));
+  put_atom(wr, TabEnt_atom(tab_ent));
+  put_u32(wr, TabEnt_arity(tab_ent));
+  sg_node = get_subgoal_trie(tab_ent);
+  if (sg_node && TrNode_child(sg_node)) {
+    if (TabEnt_arity(tab_ent)) {
+      if (!put_subgoal_trie(wr, TrNode_child(sg_node), sg_node))
+        return FALSE;
+    } else {
+      sg_fr_ptr sg_fr = get_subgoal_frame(sg_node);
+      if (sg_fr && SgFr_state(sg_fr) >= complete) {
+        put_byte(wr, RECORD_SUBGOAL);
+        if (!put_subgoal(wr, sg_fr, 0))
+          return FALSE;
+      }
+    }
+  }
+  put_byte(wr, RECORD_END);
+  return TRUE;
+}
+
+
+static tab_tk_ptr new_token(tab_rd_ptr rd, int kind) {
+  tab_tk_ptr tk;
+
+  if (rd->number_of_tokens == rd->tokens_size) {
+    rd->tokens_size = rd->tokens_size ? 2 * rd->tokens_size : 256;
+    rd->tokens = (tab_tk_ptr)realloc(rd->tokens, rd->tokens_size * sizeof(struct table_token));
+  }
+  tk = rd->tokens + rd->number_of_tokens++;
+  tk->kind = kind;
+  tk->arity = 0;
+  tk->u.string = NULL;
+  return tk;
+}
+
+
+static void free_tokens(tab_rd_ptr rd) {
+  UInt i;
+
+  for (i = 0; i < rd->number_of_tokens; i++)
+    if (rd->tokens[i].kind == TOKEN_STRING)
+      free(rd->tokens[i].u.string);
+  rd->number_of_tokens = 0;
+  rd->heap_cells = 0;
+}
+
+
+/* reads a path of tokens into rd->tokens and computes an upper bound on
+** the heap cells needed to rebuild its terms */
+static int get_path(tab_rd_ptr rd) {
+  free_tokens(rd);
+  for (;;) {
+    int kind = get_byte(rd);
+    tab_tk_ptr tk;
+    if (rd->error)
+      return FALSE;
+    if (kind == TOKEN_END)
+      return TRUE;
+    tk = new_token(rd, kind);
+    rd->heap_cells += 2;
+    switch (kind) {
+    case TOKEN_VAR:
+      tk->u.integer = get_u32(rd);
+      break;
+    case TOKEN_ATOM:
+      tk->u.atom = get_atom(rd);
+      break;
+    case TOKEN_INT:
+    case TOKEN_LONGINT:
+      tk->u.integer = (Int)(int64_t)get_u64(rd);
+      rd->heap_cells += 2;
+      break;
+    case TOKEN_FLOAT: {
+      union {
+        Float dbl;
+        uint64_t bits;
+      } u;
+      u.bits = get_u64(rd);
+      tk->u.dbl = u.dbl;
+      rd->heap_cells += 2 + sizeof(Float) / sizeof(CELL);
+    } break;
+    case TOKEN_STRING: {
+      UInt len = get_u32(rd);
+      if (rd->error)
+        return FALSE;
+      tk->u.string = (char *)malloc(len + 1);
+      if (fread(tk->u.string, 1, len, rd->in) != len)
+        rd->error = TRUE;
+      tk->u.string[len] = '\0';
+      rd->heap_cells += 4 + len + sizeof(CELL);
+    } break;
+    case TOKEN_APPL:
+      tk->u.atom = get_atom(rd);
+      tk->arity = get_u32(rd);
+      if (tk->arity <= 0)
+        rd->error = TRUE;
+      rd->heap_cells += tk->arity;
+      break;
+    case TOKEN_PAIR:
+    case TOKEN_PAIR_INIT:
+    case TOKEN_PAIR_END_LIST:
+    case TOKEN_PAIR_END_TERM:
+      break;
+    default:
+      rd->error = TRUE;
+    }
+  }
+}
+
+
+/* rebuilds on the heap the term starting at token *pos_ptr. Variables are
+** numbered by order of first occurrence, as in the tries. */
+static Term build_term(tab_rd_ptr rd, UInt *pos_ptr, Term *vars, int *vars_arity_ptr USES_REGS) {
+  tab_tk_ptr tk;
+
+  if (*pos_ptr >= rd->number_of_tokens) {
+    rd->error = TRUE;
+    return TermNil;
+  }
+  tk = rd->tokens + (*pos_ptr)++;
+  switch (tk->kind) {
+  case TOKEN_VAR:
+    if (tk->u.integer < *vars_arity_ptr)
+      return vars[tk->u.integer];
+    if (tk->u.integer != *vars_arity_ptr || *vars_arity_ptr == MAX_TABLE_VARS)
+      break;
+    RESET_VARIABLE(HR);
+    vars[(*vars_arity_ptr)++] = (Term)HR;
+    return (Term)(HR++);
+  case TOKEN_ATOM:
+    return MkAtomTerm(tk->u.atom);
+  case TOKEN_INT:
+  case TOKEN_LONGINT:
+    return MkIntegerTerm(tk->u.integer);
+  case TOKEN_FLOAT:
+    return MkFloatTerm(tk->u.dbl);
+  case TOKEN_STRING:
+    return MkStringTerm(tk->u.string);
+  case TOKEN_APPL: {
+    CELL *aux_appl = HR;
+    int i;
+    HR += tk->arity + 1;
+    aux_appl[0] = (CELL)Yap_MkFunctor(tk->u.atom, tk->arity);
+    for (i = 1; i <= tk->arity; i++)
+      aux_appl[i] = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+    return AbsAppl(aux_appl);
+  }
+  case TOKEN_PAIR: {
+    CELL *aux_pair = HR;
+    HR += 2;
+    aux_pair[0] = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+    aux_pair[1] = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+    return AbsPair(aux_pair);
+  }
+  case TOKEN_PAIR_INIT: {
+    /* [a,b,c] is written as PAIR_INIT a b PAIR_END_LIST c and
+    ** [a,b|T] is written as PAIR_INIT a b PAIR_END_TERM T */
+    Term list;
+    CELL *tail = &list;
+    while (*pos_ptr < rd->number_of_tokens) {
+      int kind = rd->tokens[*pos_ptr].kind;
+      if (kind == TOKEN_PAIR_END_TERM) {
+        (*pos_ptr)++;
+        *tail = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+        return list;
+      } else {
+        CELL *aux_pair = HR;
+        HR += 2;
+        *tail = AbsPair(aux_pair);
+        if (kind == TOKEN_PAIR_END_LIST) {
+          (*pos_ptr)++;
+          aux_pair[0] = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+          aux_pair[1] = TermNil;
+          return list;
+        }
+        aux_pair[0] = build_term(rd, pos_ptr, vars, vars_arity_ptr PASS_REGS);
+        tail = aux_pair + 1;
+      }
+    }
+  } break;
+  }
+  rd->error = TRUE;
+  return TermNil;
+}
+
+
+/* rebuilds the terms of the last path read into the argument vector
+** args[0..arity-1] and returns the number of variables found */
+static int build_terms(tab_rd_ptr rd, Term *args, int arity USES_REGS) {
+  Term vars[MAX_TABLE_VARS];
+  int i, vars_arity = 0;
+  UInt pos = 0;
+
+  for (i = 0; i < arity; i++)
+    args[i] = build_term(rd, &pos, vars, &vars_arity PASS_REGS);
+  if (pos != rd->number_of_tokens)
+    rd->error = TRUE;
+  return vars_arity;
+}
+
+
+static int get_subgoal(tab_rd_ptr rd, yamop *code, int pred_arity) {
+  CACHE_REGS
+  CELL *saved_HR = HR;
+  CELL subs_buffer[MAX_TABLE_VARS + 1], *subs_ptr;
+  sg_fr_ptr sg_fr = NULL;
+  int record;
+
+  if (!get_path(rd))
+    TABLE_IO_ERROR("load_tables: corrupted table file");
+  if (code) {
+    if (HR + rd->heap_cells > ASP - 1024) {
+      Yap_Error(RESOURCE_ERROR_STACK, TermNil, "load_tables");
+      return FALSE;
+    }
+    if (pred_arity >= MaxTemps)
+      rd->error = TRUE;
+    else
+      build_terms(rd, XREGS + 1, pred_arity PASS_REGS);
+    if (rd->error) {
+      HR = saved_HR;
+      TABLE_IO_ERROR("load_tables: corrupted table file");
+    }
+    subs_ptr = subs_buffer + MAX_TABLE_VARS + 1;
+    sg_fr = subgoal_search(code, &subs_ptr);
+    HR = saved_HR;
+    /* only fill the subgoals that were never called before */
+    if (SgFr_state(sg_fr) != ready)
+      sg_fr = NULL;
+  }
+  while ((record = get_byte(rd)) == RECORD_ANSWER) {
+    if (!get_path(rd))
+      TABLE_IO_ERROR("load_tables: corrupted table file");
+    if (sg_fr) {
+      Term subs[MAX_TABLE_VARS + 1];
+      ans_node_ptr ans_node;
+      int i, subs_arity = *subs_ptr;
+      if (HR + rd->heap_cells > ASP - 1024) {
+        Yap_Error(RESOURCE_ERROR_STACK, TermNil, "load_tables");
+        return FALSE;
+      }
+      build_terms(rd, subs + 1, subs_arity PASS_REGS);
+      if (rd->error) {
+        HR = saved_HR;
+        TABLE_IO_ERROR("load_tables: corrupted table file");
+      }
+      /* the answer paths start with the last substitution term */
+      for (i = 1; i <= subs_arity / 2; i++) {
+        Term aux = subs[i];
+        subs[i] = subs[subs_arity + 1 - i];
+        subs[subs_arity + 1 - i] = aux;
+      }
+      subs[0] = (Term)subs_arity;
+      ans_node = answer_search(sg_fr, subs);
+      HR = saved_HR;
+      if (!IS_ANSWER_LEAF_NODE(ans_node)) {
+        TAG_AS_ANSWER_LEAF_NODE(ans_node);
+        if (SgFr_first_answer(sg_fr) == NULL)
+          SgFr_first_answer(sg_fr) = ans_node;
+        else
+          TrNode_child(SgFr_last_answer(sg_fr)) = ans_node;
+        SgFr_last_answer(sg_fr) = ans_node;
+      }
+    }
+  }
+  if (rd->error || record != RECORD_END)
+    TABLE_IO_ERROR("load_tables: corrupted table file");
+  if (sg_fr)
+    mark_as_completed(sg_fr);
+  return TRUE;
+}
+
+
+
+/*******************************
+**      Global functions      **
+*******************************/
+
+int save_tables(Term list, FILE *out) {
+  struct table_writer wr;
+  int ok = TRUE;
+
+  memset(&wr, 0, sizeof(struct table_writer));
+  wr.out = out;
+  fwrite(TABLE_FILE_MAGIC, 1, strlen(TABLE_FILE_MAGIC), out);
+  put_u32(&wr, TABLE_FILE_VERSION);
+  while (ok && IsPairTerm(list)) {
+    Term t = Deref(HeadOfTerm(list));
+    Term mod, pred;
+    tab_ent_ptr tab_ent;
+    list = Deref(TailOfTerm(list));
+    if (!IsApplTerm(t) || FunctorOfTerm(t) != FunctorModule)
+      continue;
+    mod = Deref(ArgOfTerm(1, t));
+    pred = Deref(ArgOfTerm(2, t));
+    if (IsAtomTerm(pred))
+      tab_ent = RepPredProp(PredPropByAtom(AtomOfTerm(pred), mod))->TableOfPred;
+    else if (IsApplTerm(pred))
+      tab_ent = RepPredProp(PredPropByFunc(FunctorOfTerm(pred), mod))->TableOfPred;
+    else
+      continue;
+    ok = put_table(&wr, mod, tab_ent);
+  }
+  put_byte(&wr, RECORD_END);
+  free(wr.atoms);
+  free(wr.atom_index);
+  free(wr.path);
+  if (ok && ferror(out)) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, TermNil,
+              "save_tables: error writing table file");
+    ok = FALSE;
+  }
+  return ok;
+}
+
+
+/* loads the tables of a file written by save_tables(). The tables for
+** predicates that are not tabled in the current program are read but
+** ignored and returned in *skipped, the remaining ones in *loaded, both
+** as lists of Mod:Name/Arity terms. */
+int load_tables(FILE *in, Term *loaded, Term *skipped) {
+  CACHE_REGS
+  struct table_reader rd;
+  char magic[sizeof(TABLE_FILE_MAGIC)];
+  struct {
+    Atom module, name;
+    int arity, found;
+  } *preds = NULL;
+  UInt number_of_preds = 0, preds_size = 0, i;
+  int record = RECORD_END, ok = TRUE;
+
+  memset(&rd, 0, sizeof(struct table_reader));
+  rd.in = in;
+  if (fread(magic, 1, strlen(TABLE_FILE_MAGIC), in) != strlen(TABLE_FILE_MAGIC) ||
+      strncmp(magic, TABLE_FILE_MAGIC, strlen(TABLE_FILE_MAGIC)) ||
+      get_u32(&rd) != TABLE_FILE_VERSION)
+    TABLE_IO_ERROR("load_tables: not a table file or unsupported version");
+  while (ok && (record = get_byte(&rd)) == RECORD_TABLE) {
+    Atom mod = get_atom(&rd), name = get_atom(&rd);
+    int arity = get_u32(&rd);
+    Prop p = NIL;
+    yamop *code = NULL;
+    if (rd.error)
+      break;
+    if (arity == 0)
+      p = Yap_GetPredPropByAtom(name, MkAtomTerm(mod));
+    else
+      p = Yap_GetPredPropByFunc(Yap_MkFunctor(name, arity), MkAtomTerm(mod));
+    if (p != NIL) {
+      PredEntry *pe = RepPredProp(p);
+      tab_ent_ptr tab_ent = pe->TableOfPred;
+      if ((pe->PredFlags & TabledPredFlag) && tab_ent &&
+#ifdef MODE_DIRECTED_TABLING
+          !TabEnt_mode_directed(tab_ent) &&
+#endif /* MODE_DIRECTED_TABLING */
+          !IsMode_GlobalTrie(TabEnt_mode(tab_ent)) &&
+          pe->cs.p_code.FirstClause &&
+          pe->cs.p_code.FirstClause->opc == Yap_opcode(_table_try_single))
+        /* the first instruction of each tabled clause holds the table entry */
+        code = pe->cs.p_code.FirstClause;
+    }
+    while (ok && (record = get_byte(&rd)) == RECORD_SUBGOAL)
+      ok = get_subgoal(&rd, code, arity);
+    if (ok && record != RECORD_END)
+      break;
+    if (number_of_preds == preds_size) {
+      preds_size = preds_size ? 2 * preds_size : 16;
+      preds = realloc(preds, preds_size * sizeof(*preds));
+    }
+    preds[number_of_preds].module = mod;
+    preds[number_of_preds].name = name;
+    preds[number_of_preds].arity = arity;
+    preds[number_of_preds].found = (code != NULL);
+    number_of_preds++;
+  }
+  free_tokens(&rd);
+  free(rd.tokens);
+  free(rd.atoms);
+  if (ok && (rd.error || record != RECORD_END)) {
+    Yap_Error(SYSTEM_ERROR_SAVED_STATE, TermNil,
+              "load_tables: corrupted table file");
+    ok = FALSE;
+  }
+  if (ok && HR + 8 * number_of_preds > ASP - 1024) {
+    Yap_Error(RESOURCE_ERROR_STACK, TermNil, "load_tables");
+    ok = FALSE;
+  }
+  if (ok) {
+    /* build the Mod:Name/Arity lists */
+    *loaded = *skipped = TermNil;
+    for (i = number_of_preds; i > 0; i--) {
+      Term aux[2], pred;
+      aux[0] = MkAtomTerm(preds[i - 1].name);
+      aux[1] = MkIntTerm(preds[i - 1].arity);
+      pred = Yap_MkApplTerm(FunctorSlash, 2, aux);
+      aux[0] = MkAtomTerm(preds[i - 1].module);
+      aux[1] = pred;
+      pred = Yap_MkApplTerm(FunctorModule, 2, aux);
+      if (preds[i - 1].found)
+        *loaded = MkPairTerm(pred, *loaded);
+      else
+        *skipped = MkPairTerm(pred, *skipped);
+    }
+  }
+  free(preds);
+  return ok;
+}
+#endif /* TABLING */
@@ -19,6 +19,18 @@
 **      table_entry      **
 **************************/
 
+#ifdef TABLING_PROFILER
+struct table_profile {
+  long subgoals;          /* subgoals evaluated */
+  long subgoals_complete; /* subgoals completed */
+  long answers;           /* new answers */
+  long duplicates;        /* repeated answers */
+  long consumers;         /* consumer nodes (suspensions) */
+  uint64_t time;          /* sum of the completion times (nanoseconds) */
+  uint64_t max_time;      /* largest completion time (nanoseconds) */
+};
+#endif /* TABLING_PROFILER */
+
 typedef struct table_entry {
 #if defined(SUBGOAL_TRIE_LOCK_AT_ENTRY_LEVEL) || defined(THREADS_NO_SHARING)
   lockvar lock;
@@ -30,7 +42,12 @@ typedef struct table_entry {
   short execution_mode;  /* combines yap_flags with pred_flags */
 #ifdef MODE_DIRECTED_TABLING
   int* mode_directed_array;
+  int lattice_operator;
+  Int lattice_parameter;
 #endif /* MODE_DIRECTED_TABLING */
+#ifdef TABLING_PROFILER
+  struct table_profile profile;
+#endif /* TABLING_PROFILER */
 #ifdef THREADS_NO_SHARING
   struct subgoal_trie_node *subgoal_trie[THREADS_NUM_BUCKETS];
 #else
@@ -47,6 +64,9 @@ typedef struct table_entry {
 #define TabEnt_flags(X)           ((X)->pred_flags)
 #define TabEnt_mode(X)            ((X)->execution_mode)
 #define TabEnt_mode_directed(X)   ((X)->mode_directed_array)
+#define TabEnt_lattice(X)         ((X)->lattice_operator)
+#define TabEnt_lattice_param(X)   ((X)->lattice_parameter)
+#define TabEnt_profile(X)         ((X)->profile)
 #define TabEnt_subgoal_trie(X)    ((X)->subgoal_trie)
 #define TabEnt_hash_chain(X)      ((X)->hash_chain)
 #define TabEnt_next(X)            ((X)->next)
@@ -103,6 +123,25 @@ typedef struct global_trie_node {
 
 
 
+/***************************
+**      answer_array      **
+***************************/
+
+#ifdef TABLING_ANSWER_ARRAYS
+typedef struct answer_array {
+  int number_of_answers;
+  int subs_arity;
+  Term answers[1];  /* number_of_answers rows of subs_arity terms */
+} *ans_arr_ptr;
+#endif /* TABLING_ANSWER_ARRAYS */
+
+#define AnsArr_num_answers(X)  ((X)->number_of_answers)
+#define AnsArr_subs_arity(X)   ((X)->subs_arity)
+#define AnsArr_answers(X)      ((X)->answers)
+#define AnsArr_last_row(X)     ((X)->answers + ((X)->number_of_answers - 1) * (X)->subs_arity)
+
+
+
 /******************************
 **      answer_ref_node      **
 ******************************/
@@ -209,6 +248,10 @@ struct consumer_choicept {
 struct loader_choicept {
   struct choicept cp;
   struct answer_trie_node *cp_last_answer;
+#ifdef TABLING_ANSWER_ARRAYS
+  Term *cp_last_row;
+  Term *cp_end_row;
+#endif /* TABLING_ANSWER_ARRAYS */
 #ifdef LOW_LEVEL_TRACER
   struct pred_entry *cp_pred_entry;
 #endif /* LOW_LEVEL_TRACER */
@@ -237,6 +280,17 @@ typedef enum {          /* do not change order !!! */
 **      subgoal_entry      **
 ****************************/
 
+#ifdef TABLING_PROFILER
+struct subgoal_profile {
+  long answers;
+  long duplicates;
+  long consumers;
+  uint64_t start;       /* wall time when the evaluation started */
+  uint64_t completion;  /* wall time when the subgoal completed */
+  long session;         /* table_profile(on) session of the counts */
+};
+#endif /* TABLING_PROFILER */
+
 typedef struct subgoal_entry {
 #if defined(YAPOR) || defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING)
   lockvar lock;
@@ -250,9 +304,15 @@ typedef struct subgoal_entry {
   int* mode_directed_array;
   struct answer_trie_node *invalid_chain;
 #endif /* MODE_DIRECTED_TABLING */
+#ifdef TABLING_ANSWER_ARRAYS
+  struct answer_array *answer_array;
+#endif /* TABLING_ANSWER_ARRAYS */
 #ifdef INCOMPLETE_TABLING
   struct answer_trie_node *try_answer;
 #endif /* INCOMPLETE_TABLING */
+#ifdef TABLING_PROFILER
+  struct subgoal_profile profile;
+#endif /* TABLING_PROFILER */
 #ifdef LIMIT_TABLING
   struct subgoal_frame *previous;
 #endif /* LIMIT_TABLING */
@@ -324,7 +384,9 @@ typedef struct subgoal_frame {
 #define SgFr_last_answer(X)             (SUBGOAL_ENTRY(X) last_answer)
 #define SgFr_mode_directed(X)           (SUBGOAL_ENTRY(X) mode_directed_array)
 #define SgFr_invalid_chain(X)           (SUBGOAL_ENTRY(X) invalid_chain)
+#define SgFr_answer_array(X)            (SUBGOAL_ENTRY(X) answer_array)
 #define SgFr_try_answer(X)              (SUBGOAL_ENTRY(X) try_answer)
+#define SgFr_profile(X)                 (SUBGOAL_ENTRY(X) profile)
 #define SgFr_previous(X)                (SUBGOAL_ENTRY(X) previous)
 #define SgFr_gen_top_or_fr(X)           (SUBGOAL_ENTRY(X) top_or_frame_on_generator_branch)
 #define SgFr_gen_worker(X)              (SUBGOAL_ENTRY(X) generator_worker)
@@ -350,9 +412,14 @@ typedef struct subgoal_frame {
   SgFr_last_answer:             a pointer to the leaf answer trie node of the last answer.
   SgFr_mode_directed:           a pointer to the mode directed array.
   SgFr_invalid_chain:           a pointer to the first invalid leaf node when using mode directed tabling.
+  SgFr_answer_array:            a pointer to the flat array of answers built when a table with only atomic
+                                answers completes. Loading answers then reads contiguous rows instead of
+                                walking the answer trie leaf-to-root for every answer.
   SgFr_try_answer:              a pointer to the leaf answer trie node of the last tried answer.
                                 It is used when a subgoal was not completed during the previous evaluation.
                                 Not completed subgoals start by trying the answers already found.
+  SgFr_profile:                 the answers, repeated answers and consumers counted for the subgoal and
+                                the wall times of its first call and completion (tabling profiler).
   SgFr_previous:                a pointer to the previous subgoal frame on the chain.
   SgFr_gen_top_or_fr:           a pointer to the top or-frame in the generator choice point branch. 
                                 When the generator choice point is shared the pointer is updated 
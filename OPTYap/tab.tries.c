@@ -92,6 +92,9 @@ static void traverse_global_trie_for_term(gt_node_ptr, char *, int *, int *,
 static inline void traverse_trie_node(Term, char *, int *, int *, int *,
                                       int USES_REGS);
 static inline void traverse_update_arity(char *, int *, int *);
+#ifdef TABLING_PROFILER
+static void show_subgoal_profile(sg_fr_ptr, const char *);
+#endif /* TABLING_PROFILER */
 
 /*******************************
 **      Structs & Macros      **
@@ -705,6 +708,11 @@ static void traverse_subgoal_trie(sg_node_ptr current_node, char *str,
       str[str_index] = 0;
       SHOW_TABLE_STRUCTURE("%s.\n", str);
       TrStat_ans_nodes++;
+#ifdef TABLING_PROFILER
+      if (TrStat_show == SHOW_MODE_PROFILE)
+        show_subgoal_profile(sg_fr, str);
+      else
+#endif /* TABLING_PROFILER */
       if (SgFr_first_answer(sg_fr) == NULL) {
         if (SgFr_state(sg_fr) < complete) {
           TrStat_sg_incomplete++;
@@ -1289,6 +1297,187 @@ ans_node_ptr answer_search(sg_fr_ptr sg_fr, CELL *subs_ptr) {
 }
 
 #ifdef MODE_DIRECTED_TABLING
+/************************************************************************
+**                          lattice operators                          **
+************************************************************************/
+
+/* A lattice operator joins the value stored in the trie (0 if there is
+   none yet) with the value of a new answer. It stores the joined value
+   and returns LATTICE_JOINED, returns LATTICE_SAME if the new answer adds
+   nothing to the stored one, or LATTICE_ERROR after raising an error. */
+
+typedef enum { LATTICE_SAME, LATTICE_JOINED, LATTICE_ERROR } lattice_join_result;
+
+static lattice_join_result lattice_join_set(Term, Term, Int, Term *);
+static lattice_join_result lattice_join_top(Term, Term, Int, Term *);
+static lattice_join_result lattice_join_count(Term, Term, Int, Term *);
+
+static struct table_lattice {
+  const char *name;
+  int arity; /* 0 for 'name', 1 for 'name(Integer)' */
+  lattice_join_result (*join)(Term, Term, Int, Term *);
+} table_lattices[] = {{"set", 0, lattice_join_set},
+                      {"top", 1, lattice_join_top},
+                      {"count", 1, lattice_join_count}};
+
+#define NUMBER_OF_TABLE_LATTICES                                              \
+  ((int)(sizeof(table_lattices) / sizeof(struct table_lattice)))
+
+static int lattice_compare(const void *t1, const void *t2) {
+  Int cmp = Yap_compare_terms(*(Term *)t1, *(Term *)t2);
+  return (cmp > 0) - (cmp < 0);
+}
+
+static lattice_join_result lattice_join_list(Term old, Term new, Int limit,
+                                             Term *joined) {
+  CACHE_REGS
+  Term *elems, list, t;
+  Int len = 0, n, i;
+
+  for (t = old; t && IsPairTerm(t); t = TailOfTerm(t))
+    len++;
+  for (t = Deref(new); IsPairTerm(t); t = Deref(TailOfTerm(t)))
+    len++;
+  if (t != TermNil) {
+    Yap_Error(TYPE_ERROR_LIST, new, "lattice value");
+    return LATTICE_ERROR;
+  }
+  if (len == 0) {
+    if (old)
+      return LATTICE_SAME;
+    *joined = TermNil;
+    return LATTICE_JOINED;
+  }
+  if (!(elems = (Term *)malloc(len * sizeof(Term)))) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "lattice_join_list");
+    return LATTICE_ERROR;
+  }
+  n = 0;
+  for (t = old; t && IsPairTerm(t); t = TailOfTerm(t))
+    elems[n++] = HeadOfTerm(t);
+  for (t = Deref(new); IsPairTerm(t); t = Deref(TailOfTerm(t)))
+    elems[n++] = Deref(HeadOfTerm(t));
+  qsort(elems, len, sizeof(Term), lattice_compare);
+  for (i = 1, n = 1; i < len; i++)
+    if (Yap_compare_terms(elems[n - 1], elems[i]) != 0)
+      elems[n++] = elems[i];
+  if (limit >= 0 && n > limit)
+    n = limit;
+  if (old) { /* the stored value is already sorted and without duplicates */
+    for (t = old, i = 0; i < n && IsPairTerm(t); t = TailOfTerm(t), i++)
+      if (Yap_compare_terms(HeadOfTerm(t), elems[i]) != 0)
+        break;
+    if (i == n && t == TermNil) {
+      free(elems);
+      return LATTICE_SAME;
+    }
+  }
+  if (HR + 2 * n > ASP - 1024) {
+    free(elems);
+    Yap_Error(RESOURCE_ERROR_STACK, TermNil, "lattice_join_list");
+    return LATTICE_ERROR;
+  }
+  list = TermNil;
+  while (n--) {
+    HR[0] = elems[n];
+    HR[1] = list;
+    list = AbsPair(HR);
+    HR += 2;
+  }
+  free(elems);
+  *joined = list;
+  return LATTICE_JOINED;
+}
+
+static lattice_join_result lattice_join_set(Term old, Term new, Int param,
+                                            Term *joined) {
+  return lattice_join_list(old, new, -1, joined);
+}
+
+static lattice_join_result lattice_join_top(Term old, Term new, Int k,
+                                            Term *joined) {
+  return lattice_join_list(old, new, k, joined);
+}
+
+static lattice_join_result lattice_join_count(Term old, Term new, Int bound,
+                                              Term *joined) {
+  Int n;
+
+  new = Deref(new);
+  if (!IsIntegerTerm(new)) {
+    Yap_Error(TYPE_ERROR_INTEGER, new, "lattice value");
+    return LATTICE_ERROR;
+  }
+  n = IntegerOfTerm(new);
+  if (n < 0) {
+    Yap_Error(DOMAIN_ERROR_NOT_LESS_THAN_ZERO, new, "lattice value");
+    return LATTICE_ERROR;
+  }
+  if (old) {
+    Int o = IntegerOfTerm(old);
+    if (n == 0 || o >= bound)
+      return LATTICE_SAME;
+    n = (n > bound - o) ? bound : o + n;
+  } else if (n > bound)
+    n = bound;
+  *joined = MkIntegerTerm(n);
+  return LATTICE_JOINED;
+}
+
+int lattice_operator(Term spec, Int *param) {
+  Atom at;
+  int arity, i;
+
+  spec = Deref(spec);
+  *param = 0;
+  if (IsAtomTerm(spec)) {
+    at = AtomOfTerm(spec);
+    arity = 0;
+  } else if (IsApplTerm(spec) && ArityOfFunctor(FunctorOfTerm(spec)) == 1) {
+    Term t = Deref(ArgOfTerm(1, spec));
+    if (!IsIntegerTerm(t) || IntegerOfTerm(t) < 0)
+      return -1;
+    at = NameOfFunctor(FunctorOfTerm(spec));
+    arity = 1;
+    *param = IntegerOfTerm(t);
+  } else
+    return -1;
+  for (i = 0; i < NUMBER_OF_TABLE_LATTICES; i++)
+    if (table_lattices[i].arity == arity &&
+        !strcmp(table_lattices[i].name, AtomName(at)))
+      return i;
+  return -1;
+}
+
+static lattice_join_result
+answer_search_lattice(sg_fr_ptr sg_fr, ans_node_ptr current_node, Term t,
+                      int subs_arity, int subs_pos, int vars_arity,
+                      Term *joined USES_REGS) {
+  tab_ent_ptr tab_ent = SgFr_tab_ent(sg_fr);
+  ans_node_ptr child_node = TrNode_child(current_node);
+  Term trie_value = 0;
+
+  if (child_node) {
+    if (IsIntTerm(TrNode_entry(child_node))) {
+      /* small integers are stored in a single node */
+      trie_value = TrNode_entry(child_node);
+    } else {
+      /* load the stored answer, keeping the variables of the new answer
+         that are already on the stack, and take the lattice value */
+      tr_fr_ptr saved_TR = TR;
+      CELL *stack_terms;
+      while (!IS_ANSWER_LEAF_NODE(child_node))
+        child_node = TrNode_child(child_node);
+      TR = (tr_fr_ptr)((CELL *)TR + vars_arity);
+      stack_terms = load_answer_loop(child_node PASS_REGS);
+      TR = saved_TR;
+      trie_value = stack_terms[subs_arity - subs_pos];
+    }
+  }
+  return table_lattices[TabEnt_lattice(tab_ent)].join(
+      trie_value, t, TabEnt_lattice_param(tab_ent), joined);
+}
+
 ans_node_ptr mode_directed_answer_search(sg_fr_ptr sg_fr, CELL *subs_ptr) {
 #define subs_arity *subs_ptr
   CACHE_REGS
@@ -1296,6 +1485,7 @@ ans_node_ptr mode_directed_answer_search(sg_fr_ptr sg_fr, CELL *subs_ptr) {
   int i, j, vars_arity;
   ans_node_ptr current_ans_node, invalid_ans_node;
   int *mode_directed;
+  int error = FALSE;
 
   vars_arity = 0;
   current_ans_node = SgFr_answer_trie(sg_fr);
@@ -1313,7 +1503,38 @@ ans_node_ptr mode_directed_answer_search(sg_fr_ptr sg_fr, CELL *subs_ptr) {
             sg_fr, current_ans_node, Deref(subs_ptr[i]), &vars_arity PASS_REGS);
       } else {
         LOCK_ANSWER_NODE(current_ans_node);
-        if (TrNode_child(current_ans_node) == NULL) {
+        if (mode == MODE_DIRECTED_LATTICE) {
+          CELL *saved_HR = HR;
+          Term t;
+          lattice_join_result res = answer_search_lattice(
+              sg_fr, current_ans_node, Deref(subs_ptr[i]), subs_arity, i,
+              vars_arity, &t PASS_REGS);
+          if (res != LATTICE_JOINED) { /* nothing new, or an error */
+            error = (res == LATTICE_ERROR);
+            current_ans_node = NULL;
+          } else {
+#if defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING)
+            struct answer_trie_node
+                virtual_ans_node; /* necessary because the answer_search_loop()
+                                     procedure also locks the parent node */
+            ans_node_ptr parent_ans_node = current_ans_node;
+            invalid_ans_node = TrNode_child(parent_ans_node);
+            AnsNode_init_lock_field(&virtual_ans_node);
+            TrNode_parent(&virtual_ans_node) = NULL;
+            TrNode_child(&virtual_ans_node) = NULL;
+            current_ans_node = answer_search_loop(sg_fr, &virtual_ans_node, t,
+                                                  &vars_arity PASS_REGS);
+            TrNode_child(parent_ans_node) = TrNode_child(&virtual_ans_node);
+            TrNode_parent(TrNode_child(&virtual_ans_node)) = parent_ans_node;
+#else
+            invalid_ans_node = TrNode_child(current_ans_node);
+            TrNode_child(current_ans_node) = NULL;
+            current_ans_node = answer_search_loop(sg_fr, current_ans_node, t,
+                                                  &vars_arity PASS_REGS);
+#endif /* THREADS_FULL_SHARING || THREADS_CONSUMER_SHARING */
+          }
+          HR = saved_HR; /* the joined value was copied to the trie */
+        } else if (TrNode_child(current_ans_node) == NULL) {
 #if defined(THREADS_FULL_SHARING) || defined(THREADS_CONSUMER_SHARING)
           struct answer_trie_node
               virtual_ans_node; /* necessary because the answer_search_loop()
@@ -1392,6 +1613,8 @@ ans_node_ptr mode_directed_answer_search(sg_fr_ptr sg_fr, CELL *subs_ptr) {
     RESET_VARIABLE(t);
   }
 
+  if (error)
+    return MODE_DIRECTED_ANSWER_ERROR;
   return current_ans_node;
 #undef subs_arity
 }
@@ -1480,6 +1703,67 @@ void update_answer_trie(sg_fr_ptr sg_fr) {
   return;
 }
 
+#ifdef TABLING_ANSWER_ARRAYS
+ans_arr_ptr freeze_answer_trie(sg_fr_ptr sg_fr) {
+  ans_node_ptr leaf_node, current_node;
+  ans_arr_ptr ans_arr;
+  Term *row;
+  int subs_arity = 0, num_answers = 0;
+
+  leaf_node = SgFr_first_answer(sg_fr);
+  if (leaf_node == NULL || leaf_node == SgFr_answer_trie(sg_fr))
+    return NULL;
+  /* check that every answer is a flat substitution of atomic terms */
+  current_node = leaf_node;
+  do {
+    Term t = TrNode_entry(current_node);
+    if (IsVarTerm(t) || !IsAtomOrIntTerm(t))
+      return NULL;
+    subs_arity++;
+    current_node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(current_node));
+  } while (current_node != SgFr_answer_trie(sg_fr));
+  while (leaf_node) {
+    int depth = 0;
+    current_node = leaf_node;
+    do {
+      Term t = TrNode_entry(current_node);
+      if (IsVarTerm(t) || !IsAtomOrIntTerm(t))
+        return NULL;
+      depth++;
+      current_node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(current_node));
+    } while (current_node != SgFr_answer_trie(sg_fr));
+    if (depth != subs_arity)
+      return NULL;
+    num_answers++;
+    leaf_node = TrNode_child(leaf_node);
+  }
+  /* copy the answers, each row is ordered as the substitution factor */
+  ALLOC_BLOCK(ans_arr, sizeof(struct answer_array) + (num_answers * subs_arity - 1) * sizeof(Term), struct answer_array);
+  AnsArr_num_answers(ans_arr) = num_answers;
+  AnsArr_subs_arity(ans_arr) = subs_arity;
+  row = AnsArr_answers(ans_arr);
+  for (leaf_node = SgFr_first_answer(sg_fr); leaf_node; leaf_node = TrNode_child(leaf_node)) {
+    current_node = leaf_node;
+    do {
+      *row++ = TrNode_entry(current_node);
+      current_node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(current_node));
+    } while (current_node != SgFr_answer_trie(sg_fr));
+  }
+  return ans_arr;
+}
+
+void load_answer_row(Term *row, CELL *subs_ptr) {
+  CACHE_REGS
+#define subs_arity *subs_ptr
+  int i;
+
+  for (i = 1; i <= subs_arity; i++)
+    YapBind((CELL *)subs_ptr[i], row[i - 1]);
+  return;
+#undef subs_arity
+}
+#endif /* TABLING_ANSWER_ARRAYS */
+
 void free_subgoal_trie(sg_node_ptr current_node, int mode, int position) {
   CACHE_REGS
 
@@ -1576,6 +1860,10 @@ void free_subgoal_trie(sg_node_ptr current_node, int mode, int position) {
         FREE_BLOCK(SgFr_mode_directed(sg_fr));
 #endif /* MODE_DIRECTED_TABLING && !THREADS_FULL_SHARING &&                    \
           !THREADS_CONSUMER_SHARING */
+#ifdef TABLING_ANSWER_ARRAYS
+      if (SgFr_answer_array(sg_fr))
+        FREE_BLOCK(SgFr_answer_array(sg_fr));
+#endif /* TABLING_ANSWER_ARRAYS */
       FREE_SUBGOAL_FRAME(sg_fr);
     }
   }
@@ -1738,6 +2026,10 @@ void abolish_table(tab_ent_ptr tab_ent) {
 #ifdef LIMIT_TABLING
           remove_from_global_sg_fr_list(sg_fr);
 #endif /* LIMIT_TABLING */
+#ifdef TABLING_ANSWER_ARRAYS
+          if (SgFr_answer_array(sg_fr))
+            FREE_BLOCK(SgFr_answer_array(sg_fr));
+#endif /* TABLING_ANSWER_ARRAYS */
           FREE_SUBGOAL_FRAME(sg_fr);
         }
       }
@@ -1794,6 +2086,8 @@ void showTable(tab_ent_ptr tab_ent, int show_mode, FILE *out) {
         fprintf(TrStat_out, "last");
       } else if (mode == MODE_DIRECTED_FIRST) {
         fprintf(TrStat_out, "first");
+      } else if (mode == MODE_DIRECTED_LATTICE) {
+        fprintf(TrStat_out, "lattice");
       } else
         Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "show_table: unknown mode");
       if (i != MODE_DIRECTED_GET_ARG(mode_directed[i]))
@@ -1865,6 +2159,64 @@ void showTable(tab_ent_ptr tab_ent, int show_mode, FILE *out) {
   return;
 }
 
+#ifdef TABLING_PROFILER
+static void show_subgoal_profile(sg_fr_ptr sg_fr, const char *goal) {
+  tab_ent_ptr tab_ent = SgFr_tab_ent(sg_fr);
+  Term mod = TabEnt_pe(tab_ent)->ModuleOfPred;
+  struct subgoal_profile *prof = &SgFr_profile(sg_fr);
+
+  if (prof->session != GLOBAL_table_profiler_session ||
+      (prof->start == 0 && prof->answers == 0 && prof->duplicates == 0 &&
+       prof->consumers == 0))
+    return; /* not evaluated while profiling */
+  fprintf(TrStat_out, "%s:%s/%d,\"", AtomName(AtomOfTerm(mod ? mod : TermProlog)),
+          AtomName(TabEnt_atom(tab_ent)), TabEnt_arity(tab_ent));
+  for (; *goal; goal++) {
+    if (*goal == '"')
+      putc('"', TrStat_out);
+    putc(*goal, TrStat_out);
+  }
+  fprintf(TrStat_out, "\",%s,%ld,%ld,%ld,",
+          SgFr_state(sg_fr) < complete ? "incomplete" : "complete",
+          prof->answers, prof->duplicates, prof->consumers);
+  if (prof->start && prof->completion)
+    fprintf(TrStat_out, "%.6f,%.6f\n",
+            (double)(prof->completion - prof->start) / 1.0e9,
+            (double)(prof->completion - GLOBAL_table_profiler_start) / 1.0e9);
+  else
+    fprintf(TrStat_out, ",\n");
+  return;
+}
+
+void profileTable(tab_ent_ptr tab_ent, FILE *out) {
+  CACHE_REGS
+  sg_node_ptr sg_node;
+
+  TrStat_out = out;
+  TrStat_show = SHOW_MODE_PROFILE;
+  sg_node = get_subgoal_trie(tab_ent);
+  if (sg_node && TrNode_child(sg_node)) {
+    if (TabEnt_arity(tab_ent)) {
+      char *str = (char *)malloc(sizeof(char) * SHOW_TABLE_STR_ARRAY_SIZE);
+      int *arity = (int *)malloc(sizeof(int) * SHOW_TABLE_ARITY_ARRAY_SIZE);
+      arity[0] = 1;
+      arity[1] = TabEnt_arity(tab_ent);
+      int str_index = sprintf(str, "%s(", AtomName(TabEnt_atom(tab_ent)));
+      traverse_subgoal_trie(TrNode_child(sg_node), str, str_index, arity,
+                            TRAVERSE_MODE_NORMAL,
+                            TRAVERSE_POSITION_FIRST PASS_REGS);
+      free(str);
+      free(arity);
+    } else {
+      sg_fr_ptr sg_fr = get_subgoal_frame(sg_node);
+      if (sg_fr)
+        show_subgoal_profile(sg_fr, AtomName(TabEnt_atom(tab_ent)));
+    }
+  }
+  return;
+}
+#endif /* TABLING_PROFILER */
+
 void showGlobalTrie(int show_mode, FILE *out) {
   CACHE_REGS
 
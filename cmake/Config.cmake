@@ -55,6 +55,7 @@ check_include_file( sys/mman.h HAVE_SYS_MMAN_H )
 check_include_file( sys/ndir.h HAVE_SYS_NDIR_H )
 check_include_file( sys/param.h HAVE_SYS_PARAM_H )
 check_include_file( sys/resource.h HAVE_SYS_RESOURCE_H )
+check_include_file( sys/epoll.h HAVE_SYS_EPOLL_H )
 check_include_file( sys/select.h HAVE_SYS_SELECT_H )
 check_include_file( sys/shm.h HAVE_SYS_SHM_H )
 check_include_file( sys/socket.h HAVE_SYS_SOCKET_H )
@@ -36,6 +36,7 @@ set (ENGINE_SOURCES
   C/bb.c
   C/blobs.c
   C/cdmgr.c
+  C/chash.c
   C/cmppreds.c
   C/compiler.c
   C/computils.c
@@ -1396,6 +1396,11 @@ signal. */
 #cmakedefine HAVE_SYS_RESOURCE_H ${HAVE_SYS_RESOURCE_H}
 #endif
 
+/* Define to 1 if you have the <sys/epoll.h> header file. */
+#ifndef HAVE_SYS_EPOLL_H
+#cmakedefine HAVE_SYS_EPOLL_H ${HAVE_SYS_EPOLL_H}
+#endif
+
 /* Define to 1 if you have the <sys/select.h> header file. */
 #ifndef HAVE_SYS_SELECT_H
 #cmakedefine HAVE_SYS_SELECT_H ${HAVE_SYS_SELECT_H}
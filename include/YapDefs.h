@@ -396,7 +396,8 @@ typedef enum stream_f {
       0x1000000, /**< do not close the stream after an abort event */
   Readline_Stream_f = 0x2000000, /**< the stream is a readline stream */
   FreeOnClose_Stream_f =
-      0x4000000 /**< the stream buffer should be releaed on close */
+      0x4000000, /**< the stream buffer should be releaed on close */
+  Mmap_Stream_f = 0x8000000 /**< the stream reads a memory mapped file */
 } estream_f;
 
 typedef uint64_t stream_flags_t;
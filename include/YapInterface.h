@@ -684,6 +684,20 @@ These C-interface functions are useful when converting Prolog lists to arrays:
 They return the number of integers scanned, up to a maximum of <tt>sz</tt>,
 and <tt>-1</tt> on error.
 
+Static arrays of integers and floats can be shared with C code without
+copying:
+
+<ul>
+ <li>void \*YAP_StaticArrayData(YAP_Atom  _name_, YAP_Int \* _sz_, YAP_Bool \* _floats_)
+</li>
+</ul>
+returns the address of the elements of the static array  _name_,
+stores its number of elements in  _sz_, and sets  _floats_ if the
+elements are doubles rather than `YAP_Int`. It returns `NULL` if
+there is no such array, or if it holds other kinds of elements. From
+then on the array can no longer be resized or closed, so the address
+stays valid.
+
 @section Memory_Allocation Memory Allocation
 
 The next routine can be used to ask space from the Prolog data-base:
@@ -856,9 +870,11 @@ ignore_variables));
 
 </li>
 </ul>
-The first three arguments follow `term_has/4`. The last argument
-indicates what to do if we find a variable: if `0` fail, otherwise
-ignore the variable.
+The first three arguments follow `term_hash/4`. The last argument
+indicates what to do if we find a variable: if `0` return `FALSE`,
+otherwise skip the variable, so that terms that only differ in their
+variables get the same hash. Older versions did not look at this
+argument, and always returned `FALSE` for terms with variables.
 
 @section Calling_YAP_From_C From `C` back to Prolog
 
@@ -1966,6 +1982,9 @@ extern X_API YAP_Int YAP_ListToFloats(YAP_Term, YAP_Float *, size_t);
 extern X_API YAP_Term YAP_IntsToList(YAP_Int *, size_t);
 extern X_API YAP_Int YAP_ListToInts(YAP_Term, YAP_Int *, size_t);
 
+/*  void *YAP_StaticArrayData(YAP_Atom, YAP_Int *, YAP_Bool *) */
+extern X_API void *YAP_StaticArrayData(YAP_Atom, YAP_Int *, YAP_Bool *);
+
 /*  int StringToBuffer(YAP_Term,char *,unsigned int) */
 extern X_API char *YAP_StringToBuffer(YAP_Term, char *, unsigned int);
 
@@ -24,6 +24,14 @@
 #if HAVE_STRING_H
 #include <string.h>
 #endif
+#include <stdlib.h>
+#include <limits.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 /*
   A matrix is something of the form
@@ -38,6 +46,11 @@
 
   floating point matrixes may need to be aligned, so we always have an
   extra element at the end.
+
+  A view has the same header, but MAT_VIEW is set and DATA is replaced
+  by a pointer to storage owned by someone else, say a static array or
+  a memory mapped file. Views share that storage instead of copying
+  it, so they are only valid while the storage exists.
 */
 
 /* maximal number of dimensions, 1024 should be enough */
@@ -53,7 +66,7 @@ typedef enum {
   MAT_BASE=1,
   MAT_NDIMS=2,
   MAT_SIZE=3,
-  MAT_ALIGN=4,
+  MAT_VIEW=4,
   MAT_DIMS=5,
 } mat_type;
 
@@ -71,15 +84,29 @@ typedef enum {
 YAP_Functor FunctorM;
 YAP_Atom AtomC;
 
+static void *
+matrix_view_data(int *mat, int ndims)
+{
+  void *data;
+
+  /* the pointer may not be aligned */
+  memcpy(&data, mat+(MAT_DIMS+ndims), sizeof(data));
+  return data;
+}
+
 static long int *
 matrix_long_data(int *mat, int ndims)
 {
+  if (mat[MAT_VIEW])
+    return (long int *)matrix_view_data(mat, ndims);
   return (long int *)(mat+(MAT_DIMS+ndims));
 }
 
 static double *
 matrix_double_data(int *mat, int ndims)
 {
+  if (mat[MAT_VIEW])
+    return (double *)matrix_view_data(mat, ndims);
   return (double *)(mat+(MAT_DIMS+ndims));
 }
 
@@ -128,6 +155,471 @@ matrix_next_index(int *dims, int ndims, int* indx)
   }
 }
 
+/*
+  Kernels for the bulk operations. They work on the raw data with
+  size_t offsets, so that a large matrix can be split between
+  threads, and their inner loops are written so that the compiler can
+  vectorise them. With GCC on x86-64 we also build an AVX2 clone of
+  each kernel, and the dynamic loader picks the one that fits the CPU.
+*/
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 7 && defined(__x86_64__) && defined(__linux__)
+#define MATRIX_KERNEL __attribute__((target_clones("avx2","default")))
+#else
+#define MATRIX_KERNEL
+#endif
+
+/* below this many elements starting threads costs more than it saves */
+#define MATRIX_PAR_MIN (1<<18)
+#define MATRIX_MAX_THREADS 16
+
+typedef void (*matrix_kernel)(void *arg, size_t lo, size_t hi, int chunk);
+
+#if HAVE_PTHREAD_H
+typedef struct {
+  matrix_kernel fn;
+  void *arg;
+  size_t lo, hi;
+  int chunk;
+} matrix_job;
+
+static void *
+matrix_job_run(void *p)
+{
+  matrix_job *job = (matrix_job *)p;
+
+  job->fn(job->arg, job->lo, job->hi, job->chunk);
+  return NULL;
+}
+#endif
+
+static int
+matrix_nthreads(size_t n, size_t work)
+{
+#if HAVE_PTHREAD_H && HAVE_UNISTD_H && defined(_SC_NPROCESSORS_ONLN)
+  static long ncpus;
+  long nt;
+
+  if (work < MATRIX_PAR_MIN)
+    return 1;
+  if (!ncpus) {
+    long nc = sysconf(_SC_NPROCESSORS_ONLN);
+    ncpus = (nc > 0 ? nc : 1);
+  }
+  nt = ncpus;
+  if (nt > MATRIX_MAX_THREADS)
+    nt = MATRIX_MAX_THREADS;
+  if ((size_t)nt > work/(MATRIX_PAR_MIN/4))
+    nt = work/(MATRIX_PAR_MIN/4);
+  if ((size_t)nt > n)
+    nt = n;
+  return (nt > 0 ? nt : 1);
+#else
+  return 1;
+#endif
+}
+
+/*
+  run fn over [0,n), where n counts rows or elements and work is the
+  number of elements touched. Returns the number of chunks, so that
+  reductions know how many partial results to combine.
+*/
+static int
+matrix_parallel(size_t n, size_t work, matrix_kernel fn, void *arg)
+{
+  int nt = matrix_nthreads(n, work);
+#if HAVE_PTHREAD_H
+  pthread_t tids[MATRIX_MAX_THREADS];
+  matrix_job jobs[MATRIX_MAX_THREADS];
+  char started[MATRIX_MAX_THREADS];
+  int i;
+#endif
+
+  if (nt <= 1) {
+    fn(arg, 0, n, 0);
+    return 1;
+  }
+#if HAVE_PTHREAD_H
+  for (i = 0; i < nt; i++) {
+    jobs[i].fn = fn;
+    jobs[i].arg = arg;
+    jobs[i].lo = n*i/nt;
+    jobs[i].hi = n*(i+1)/nt;
+    jobs[i].chunk = i;
+  }
+  for (i = 1; i < nt; i++) {
+    started[i] = (pthread_create(tids+i, NULL, matrix_job_run, jobs+i) == 0);
+  }
+  matrix_job_run(jobs);
+  for (i = 1; i < nt; i++) {
+    if (started[i])
+      pthread_join(tids[i], NULL);
+    else
+      matrix_job_run(jobs+i);
+  }
+#endif
+  return nt;
+}
+
+MATRIX_KERNEL static long int
+sum_longs(const long int *data, size_t n)
+{
+  long int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i;
+
+  for (i = 0; i+4 <= n; i += 4) {
+    s0 += data[i];
+    s1 += data[i+1];
+    s2 += data[i+2];
+    s3 += data[i+3];
+  }
+  for (; i < n; i++)
+    s0 += data[i];
+  return (s0+s1)+(s2+s3);
+}
+
+/* separate accumulators let the additions run in parallel lanes */
+MATRIX_KERNEL static double
+sum_doubles(const double *data, size_t n)
+{
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  size_t i;
+
+  for (i = 0; i+4 <= n; i += 4) {
+    s0 += data[i];
+    s1 += data[i+1];
+    s2 += data[i+2];
+    s3 += data[i+3];
+  }
+  for (; i < n; i++)
+    s0 += data[i];
+  return (s0+s1)+(s2+s3);
+}
+
+MATRIX_KERNEL static long int
+dot_longs(const long int *a, const long int *b, size_t n)
+{
+  long int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i;
+
+  for (i = 0; i+4 <= n; i += 4) {
+    s0 += a[i]*b[i];
+    s1 += a[i+1]*b[i+1];
+    s2 += a[i+2]*b[i+2];
+    s3 += a[i+3]*b[i+3];
+  }
+  for (; i < n; i++)
+    s0 += a[i]*b[i];
+  return (s0+s1)+(s2+s3);
+}
+
+MATRIX_KERNEL static double
+dot_doubles(const double *a, const double *b, size_t n)
+{
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  size_t i;
+
+  for (i = 0; i+4 <= n; i += 4) {
+    s0 += a[i]*b[i];
+    s1 += a[i+1]*b[i+1];
+    s2 += a[i+2]*b[i+2];
+    s3 += a[i+3]*b[i+3];
+  }
+  for (; i < n; i++)
+    s0 += a[i]*b[i];
+  return (s0+s1)+(s2+s3);
+}
+
+/* reductions: each chunk leaves its result in its own slot */
+typedef struct {
+  const long int *ldata, *ldata2;
+  const double *ddata, *ddata2;
+  long int lsum[MATRIX_MAX_THREADS];
+  double dsum[MATRIX_MAX_THREADS];
+} sum_args;
+
+static void
+sum_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  sum_args *a = (sum_args *)arg;
+
+  if (a->ldata)
+    a->lsum[chunk] = sum_longs(a->ldata+lo, hi-lo);
+  else
+    a->dsum[chunk] = sum_doubles(a->ddata+lo, hi-lo);
+}
+
+static void
+dot_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  sum_args *a = (sum_args *)arg;
+
+  if (a->ldata)
+    a->lsum[chunk] = dot_longs(a->ldata+lo, a->ldata2+lo, hi-lo);
+  else
+    a->dsum[chunk] = dot_doubles(a->ddata+lo, a->ddata2+lo, hi-lo);
+}
+
+static long int
+matrix_sum_longs(const long int *data, size_t n)
+{
+  sum_args a;
+  int i, nt;
+  long int sum = 0;
+
+  a.ldata = data;
+  nt = matrix_parallel(n, n, sum_kernel, &a);
+  for (i = 0; i < nt; i++)
+    sum += a.lsum[i];
+  return sum;
+}
+
+static double
+matrix_sum_doubles(const double *data, size_t n)
+{
+  sum_args a;
+  int i, nt;
+  double sum = 0.0;
+
+  a.ldata = NULL;
+  a.ddata = data;
+  nt = matrix_parallel(n, n, sum_kernel, &a);
+  for (i = 0; i < nt; i++)
+    sum += a.dsum[i];
+  return sum;
+}
+
+/* element-wise maps: log, exp, and exp(x-shift) */
+typedef struct {
+  const long int *lsrc;
+  const double *dsrc;
+  double *dst;
+  op_type op;
+  double shift;
+} map_args;
+
+static void
+map_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  map_args *a = (map_args *)arg;
+  double *dst = a->dst;
+  size_t i;
+
+  if (a->lsrc) {
+    const long int *src = a->lsrc;
+    if (a->op == MAT_LOG) {
+      for (i = lo; i < hi; i++)
+	dst[i] = log((double)src[i]);
+    } else {
+      for (i = lo; i < hi; i++)
+	dst[i] = exp((double)src[i]);
+    }
+  } else {
+    const double *src = a->dsrc;
+    if (a->op == MAT_LOG) {
+      for (i = lo; i < hi; i++)
+	dst[i] = log(src[i]);
+    } else if (a->shift != 0.0) {
+      double shift = a->shift;
+      for (i = lo; i < hi; i++)
+	dst[i] = exp(src[i]-shift);
+    } else {
+      for (i = lo; i < hi; i++)
+	dst[i] = exp(src[i]);
+    }
+  }
+}
+
+static void
+matrix_map(op_type op, const long int *lsrc, const double *dsrc, double *dst, double shift, size_t n)
+{
+  map_args a;
+
+  a.lsrc = lsrc;
+  a.dsrc = dsrc;
+  a.dst = dst;
+  a.op = op;
+  a.shift = shift;
+  matrix_parallel(n, n, map_kernel, &a);
+}
+
+/*
+  row and column kernels for a matrix seen as nlines x ncols. Threads
+  own disjoint ranges of the output, so they never write the same
+  cell.
+*/
+typedef struct {
+  const long int *ldata, *ldata2;
+  const double *ddata, *ddata2;
+  long int *lout;
+  double *dout;
+  size_t nlines, ncols;
+} lines_args;
+
+/* sum the lines: split over columns, and walk each line in order */
+MATRIX_KERNEL static void
+add_lines_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  lines_args *a = (lines_args *)arg;
+  size_t i, j, ncols = a->ncols;
+
+  if (a->ldata) {
+    long int *out = a->lout;
+    for (j = lo; j < hi; j++)
+      out[j] = 0;
+    for (i = 0; i < a->nlines; i++) {
+      const long int *line = a->ldata+i*ncols;
+      for (j = lo; j < hi; j++)
+	out[j] += line[j];
+    }
+  } else {
+    double *out = a->dout;
+    for (j = lo; j < hi; j++)
+      out[j] = 0.0;
+    for (i = 0; i < a->nlines; i++) {
+      const double *line = a->ddata+i*ncols;
+      for (j = lo; j < hi; j++)
+	out[j] += line[j];
+    }
+  }
+}
+
+/* sum each line: split over lines */
+static void
+add_cols_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  lines_args *a = (lines_args *)arg;
+  size_t i, ncols = a->ncols;
+
+  for (i = lo; i < hi; i++) {
+    if (a->ldata)
+      a->lout[i] = sum_longs(a->ldata+i*ncols, ncols);
+    else
+      a->dout[i] = sum_doubles(a->ddata+i*ncols, ncols);
+  }
+}
+
+/* divide every line by the same vector: split over lines */
+MATRIX_KERNEL static void
+div_lines_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  lines_args *a = (lines_args *)arg;
+  size_t i, j, ncols = a->ncols;
+
+  for (i = lo; i < hi; i++) {
+    double *out = a->dout+i*ncols;
+    if (a->ldata) {
+      const long int *line = a->ldata+i*ncols;
+      if (a->ldata2) {
+	for (j = 0; j < ncols; j++)
+	  out[j] = ((double)line[j])/a->ldata2[j];
+      } else {
+	for (j = 0; j < ncols; j++)
+	  out[j] = line[j]/a->ddata2[j];
+      }
+    } else {
+      const double *line = a->ddata+i*ncols;
+      if (a->ldata2) {
+	for (j = 0; j < ncols; j++)
+	  out[j] = line[j]/a->ldata2[j];
+      } else {
+	for (j = 0; j < ncols; j++)
+	  out[j] = line[j]/a->ddata2[j];
+      }
+    }
+  }
+}
+
+/*
+  matrix product and transpose, blocked so that the tiles being
+  worked on stay in cache. The product is split over the lines of
+  the result.
+*/
+#define MATRIX_BLOCK 64
+
+typedef struct {
+  const long int *la, *lb;
+  const double *da, *db;
+  long int *lc;
+  double *dc;
+  size_t n, k, m;
+} mul_args;
+
+MATRIX_KERNEL static void
+mul_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  mul_args *a = (mul_args *)arg;
+  size_t i, j, l, ii, jj, ll, k = a->k, m = a->m;
+
+  if (a->lc) {
+    for (i = lo; i < hi; i++)
+      for (j = 0; j < m; j++)
+	a->lc[i*m+j] = 0;
+  } else {
+    for (i = lo; i < hi; i++)
+      for (j = 0; j < m; j++)
+	a->dc[i*m+j] = 0.0;
+  }
+  for (ii = lo; ii < hi; ii += MATRIX_BLOCK) {
+    size_t imax = (ii+MATRIX_BLOCK < hi ? ii+MATRIX_BLOCK : hi);
+    for (ll = 0; ll < k; ll += MATRIX_BLOCK) {
+      size_t lmax = (ll+MATRIX_BLOCK < k ? ll+MATRIX_BLOCK : k);
+      for (jj = 0; jj < m; jj += MATRIX_BLOCK) {
+	size_t jmax = (jj+MATRIX_BLOCK < m ? jj+MATRIX_BLOCK : m);
+	for (i = ii; i < imax; i++) {
+	  if (a->lc) {
+	    long int *c = a->lc+i*m;
+	    for (l = ll; l < lmax; l++) {
+	      long int x = a->la[i*k+l];
+	      const long int *b = a->lb+l*m;
+	      for (j = jj; j < jmax; j++)
+		c[j] += x*b[j];
+	    }
+	  } else {
+	    double *c = a->dc+i*m;
+	    for (l = ll; l < lmax; l++) {
+	      double x = a->da[i*k+l];
+	      const double *b = a->db+l*m;
+	      for (j = jj; j < jmax; j++)
+		c[j] += x*b[j];
+	    }
+	  }
+	}
+      }
+    }
+  }
+}
+
+typedef struct {
+  const long int *lsrc;
+  const double *dsrc;
+  long int *ldst;
+  double *ddst;
+  size_t nlines, ncols;
+} transpose_args;
+
+static void
+transpose_kernel(void *arg, size_t lo, size_t hi, int chunk)
+{
+  transpose_args *a = (transpose_args *)arg;
+  size_t i, j, ii, jj, n = a->nlines, m = a->ncols;
+
+  for (ii = lo; ii < hi; ii += MATRIX_BLOCK) {
+    size_t imax = (ii+MATRIX_BLOCK < hi ? ii+MATRIX_BLOCK : hi);
+    for (jj = 0; jj < m; jj += MATRIX_BLOCK) {
+      size_t jmax = (jj+MATRIX_BLOCK < m ? jj+MATRIX_BLOCK : m);
+      for (i = ii; i < imax; i++) {
+	if (a->lsrc) {
+	  for (j = jj; j < jmax; j++)
+	    a->ldst[j*n+i] = a->lsrc[i*m+j];
+	} else {
+	  for (j = jj; j < jmax; j++)
+	    a->ddst[j*n+i] = a->dsrc[i*m+j];
+	}
+      }
+    }
+  }
+}
+
 static YAP_Term
 new_int_matrix(int ndims, int dims[], long int data[])
 {
@@ -154,6 +646,7 @@ new_int_matrix(int ndims, int dims[], long int data[])
   mat[MAT_BASE] = 0;
   mat[MAT_NDIMS] = ndims;
   mat[MAT_SIZE] = nelems;
+  mat[MAT_VIEW] = 0;
   for (i=0;i< ndims;i++) {
     mat[MAT_DIMS+i] = idims[i];
   }
@@ -188,6 +681,7 @@ new_float_matrix(int ndims, int dims[], double data[])
   mat[MAT_BASE] = 0;
   mat[MAT_NDIMS] = ndims;
   mat[MAT_SIZE] = nelems;
+  mat[MAT_VIEW] = 0;
   for (i=0;i< ndims;i++) {
     mat[MAT_DIMS+i] = idims[i];
   }
@@ -197,6 +691,40 @@ new_float_matrix(int ndims, int dims[], double data[])
   return blob;
 }
 
+static YAP_Term
+new_matrix_view(mat_data_type type, int ndims, int dims[], void *data)
+{
+  unsigned int sz;
+  unsigned int i;
+  YAP_Int nelems=1;
+  YAP_Term blob;
+  int *mat;
+  int idims[MAX_DIMS];
+
+  for (i=0;i< ndims;i++) {
+    idims[i] = dims[i];
+    nelems *= dims[i];
+    /* MAT_SIZE is an int */
+    if (nelems > INT_MAX)
+      return YAP_TermNil();
+  }
+  sz = ((MAT_DIMS+ndims)*sizeof(int)+sizeof(void *)+(sizeof(YAP_CELL)-1))/sizeof(YAP_CELL);
+  blob = YAP_MkBlobTerm(sz);
+  if (blob == YAP_TermNil())
+    return blob;
+  mat = YAP_BlobOfTerm(blob);
+  mat[MAT_TYPE] = type;
+  mat[MAT_BASE] = 0;
+  mat[MAT_NDIMS] = ndims;
+  mat[MAT_SIZE] = nelems;
+  mat[MAT_VIEW] = 1;
+  for (i=0;i< ndims;i++) {
+    mat[MAT_DIMS+i] = idims[i];
+  }
+  memcpy(mat+(MAT_DIMS+ndims), &data, sizeof(data));
+  return blob;
+}
+
 static YAP_Bool
 scan_dims(int ndims, YAP_Term tl, int dims[MAX_DIMS])
 {
@@ -1187,11 +1715,8 @@ matrix_log_all(void)
     return FALSE;
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    int i;
 
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      data[i] = log(data[i]);
-    }
+    matrix_map(MAT_LOG, NULL, data, data, 0.0, mat[MAT_SIZE]);
   }
   return TRUE;
 }
@@ -1210,7 +1735,6 @@ matrix_log_all2(void)
     YAP_Term out;
     long int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
     double *ndata;
-    int i;
     int *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1222,16 +1746,13 @@ matrix_log_all2(void)
     }
     nmat = (int *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      ndata[i] = log((double)data[i]);
-    }
+    matrix_map(MAT_LOG, data, NULL, ndata, 0.0, mat[MAT_SIZE]);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
   } else {
     YAP_Term out;
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]), *ndata;
-    int i;
     int *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1243,9 +1764,7 @@ matrix_log_all2(void)
     }
     nmat = (int *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      ndata[i] = log(data[i]);
-    }
+    matrix_map(MAT_LOG, NULL, data, ndata, 0.0, mat[MAT_SIZE]);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
@@ -1267,11 +1786,8 @@ matrix_exp_all(void)
     return FALSE;
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    int i;
 
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      data[i] = exp(data[i]);
-    }
+    matrix_map(MAT_EXP, NULL, data, data, 0.0, mat[MAT_SIZE]);
   }
   return TRUE;
 }
@@ -1296,10 +1812,7 @@ matrix_exp2_all(void)
     for (i=1; i< mat[MAT_SIZE]; i++) {
       if (data[i] > max) max = data[i];
     }
-    
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      data[i] = exp(data[i]-max);
-    }
+    matrix_map(MAT_EXP, NULL, data, data, max, mat[MAT_SIZE]);
   }
   return TRUE;
 }
@@ -1318,7 +1831,6 @@ matrix_exp_all2(void)
     YAP_Term out;
     long int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
     double *ndata;
-    int i;
     int *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1330,16 +1842,13 @@ matrix_exp_all2(void)
     }
     nmat = (int *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      ndata[i] = exp((double)data[i]);
-    }
+    matrix_map(MAT_EXP, data, NULL, ndata, 0.0, mat[MAT_SIZE]);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
   } else {
     YAP_Term out;
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]), *ndata;
-    int i;
     int *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1351,9 +1860,7 @@ matrix_exp_all2(void)
     }
     nmat = (int *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i=0; i< mat[MAT_SIZE]; i++) {
-      ndata[i] = exp(data[i]);
-    }
+    matrix_map(MAT_EXP, NULL, data, ndata, 0.0, mat[MAT_SIZE]);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
@@ -1398,22 +1905,12 @@ matrix_sum(void)
   }
   if (mat[MAT_TYPE] == INT_MATRIX) {
     long int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
-    int i;
-    long int sum = 0;
 
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      sum += data[i];
-    }
-    tf = YAP_MkIntTerm(sum);
+    tf = YAP_MkIntTerm(matrix_sum_longs(data, mat[MAT_SIZE]));
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    int i;
-    double sum = 0.0;
 
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      sum += data[i];
-    }
-    tf = YAP_MkFloatTerm(sum);
+    tf = YAP_MkFloatTerm(matrix_sum_doubles(data, mat[MAT_SIZE]));
   }
   return YAP_Unify(YAP_ARG2, tf);
 }
@@ -1421,31 +1918,26 @@ matrix_sum(void)
 static void
 add_int_lines(int total,int nlines,long int *mat0,long int *matf)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<ncols;i++) {
-    long int sum = 0;
-    int j;
+  lines_args a;
 
-    for (j=i;j<total;j+=ncols) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  a.ldata = mat0;
+  a.lout = matf;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(a.ncols, total, add_lines_kernel, &a);
 }
 
 static void
 add_double_lines(int total,int nlines,double *mat0,double *matf)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<ncols;i++) {
-    double sum = 0;
-    int j;
-
-    for (j=i;j<total;j+=ncols) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  lines_args a;
+
+  a.ldata = NULL;
+  a.ddata = mat0;
+  a.dout = matf;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(a.ncols, total, add_lines_kernel, &a);
 }
 
 static YAP_Bool
@@ -1504,31 +1996,26 @@ matrix_agg_lines(void)
 static void
 add_int_cols(int total,int nlines,long int *mat0,long int *matf)
 {
-  int ncols = total/nlines, i, j = 0;
-  for (i=0;i<nlines;i++) {
-    long int sum = 0;
-    int max = (i+1)*ncols;
+  lines_args a;
 
-    for (;j<max;j++) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  a.ldata = mat0;
+  a.lout = matf;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, add_cols_kernel, &a);
 }
 
 static void
 add_double_cols(int total,int nlines,double *mat0,double *matf)
 {
-  int ncols = total/nlines, i, j = 0;
-  for (i=0;i<nlines;i++) {
-    double sum = 0;
-    int max = (i+1)*ncols;
-
-    for (;j<max;j++) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  lines_args a;
+
+  a.ldata = NULL;
+  a.ddata = mat0;
+  a.dout = matf;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, add_cols_kernel, &a);
 }
 
 static YAP_Bool
@@ -1587,37 +2074,57 @@ matrix_agg_cols(void)
 static void
 div_int_by_lines(int total,int nlines,long int *mat1,long int *mat2,double *ndata)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<total;i++) {
-    ndata[i] = ((double)mat1[i])/mat2[i%ncols];
-  }
+  lines_args a;
+
+  a.ldata = mat1;
+  a.ldata2 = mat2;
+  a.dout = ndata;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, div_lines_kernel, &a);
 }
 
 static void
 div_int_by_dlines(int total,int nlines,long int *mat1,double *mat2,double *ndata)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<total;i++) {
-    ndata[i] = mat1[i]/mat2[i%ncols];
-  }
+  lines_args a;
+
+  a.ldata = mat1;
+  a.ldata2 = NULL;
+  a.ddata2 = mat2;
+  a.dout = ndata;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, div_lines_kernel, &a);
 }
 
 static void
 div_float_long_by_lines(int total,int nlines,double *mat1,long int *mat2,double *ndata)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<total;i++) {
-    ndata[i] = mat1[i]/mat2[i%ncols];
-  }
+  lines_args a;
+
+  a.ldata = NULL;
+  a.ddata = mat1;
+  a.ldata2 = mat2;
+  a.dout = ndata;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, div_lines_kernel, &a);
 }
 
 static void
 div_float_by_lines(int total,int nlines,double *mat1,double *mat2,double *ndata)
 {
-  int ncols = total/nlines, i;
-  for (i=0;i<total;i++) {
-    ndata[i] = mat1[i]/mat2[i%ncols];
-  }
+  lines_args a;
+
+  a.ldata = NULL;
+  a.ddata = mat1;
+  a.ldata2 = NULL;
+  a.ddata2 = mat2;
+  a.dout = ndata;
+  a.nlines = nlines;
+  a.ncols = total/nlines;
+  matrix_parallel(nlines, total, div_lines_kernel, &a);
 }
 
 static YAP_Bool
@@ -3231,6 +3738,274 @@ matrix_m(void)
   return YAP_Unify(YAP_ARG2, tm);
 }
 
+static double *
+matrix_as_doubles(int *mat)
+{
+  size_t i, n = mat[MAT_SIZE];
+  long int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
+  double *ndata = (double *)malloc(n*sizeof(double)+1);
+
+  if (ndata) {
+    for (i = 0; i < n; i++)
+      ndata[i] = data[i];
+  }
+  return ndata;
+}
+
+static YAP_Bool
+matrix_mul(void)
+{
+  int *mat1, *mat2, *nmat;
+  int dims[2];
+  YAP_Term tf;
+  mul_args a;
+  double *tmp1 = NULL, *tmp2 = NULL;
+  int is_int;
+
+  mat1 = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  mat2 = (int *)YAP_BlobOfTerm(YAP_ARG2);
+  if (!mat1 || !mat2) {
+    /* Error */
+    return FALSE;
+  }
+  if (mat1[MAT_NDIMS] != 2 || mat2[MAT_NDIMS] != 2 ||
+      mat1[MAT_DIMS+1] != mat2[MAT_DIMS]) {
+    return FALSE;
+  }
+  dims[0] = mat1[MAT_DIMS];
+  dims[1] = mat2[MAT_DIMS+1];
+  is_int = (mat1[MAT_TYPE] == INT_MATRIX && mat2[MAT_TYPE] == INT_MATRIX);
+  if (is_int)
+    tf = new_int_matrix(2, dims, NULL);
+  else
+    tf = new_float_matrix(2, dims, NULL);
+  if (tf == YAP_TermNil())
+    return FALSE;
+  /* just in case there was an overflow */
+  mat1 = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  mat2 = (int *)YAP_BlobOfTerm(YAP_ARG2);
+  nmat = (int *)YAP_BlobOfTerm(tf);
+  a.n = dims[0];
+  a.k = mat1[MAT_DIMS+1];
+  a.m = dims[1];
+  if (is_int) {
+    a.la = matrix_long_data(mat1, 2);
+    a.lb = matrix_long_data(mat2, 2);
+    a.lc = matrix_long_data(nmat, 2);
+  } else {
+    /* mixed products are done in floating point */
+    if (mat1[MAT_TYPE] == INT_MATRIX) {
+      if (!(tmp1 = matrix_as_doubles(mat1)))
+	return FALSE;
+      a.da = tmp1;
+    } else {
+      a.da = matrix_double_data(mat1, 2);
+    }
+    if (mat2[MAT_TYPE] == INT_MATRIX) {
+      if (!(tmp2 = matrix_as_doubles(mat2))) {
+	free(tmp1);
+	return FALSE;
+      }
+      a.db = tmp2;
+    } else {
+      a.db = matrix_double_data(mat2, 2);
+    }
+    a.lc = NULL;
+    a.dc = matrix_double_data(nmat, 2);
+  }
+  matrix_parallel(a.n, a.n*a.k*a.m, mul_kernel, &a);
+  free(tmp1);
+  free(tmp2);
+  return YAP_Unify(YAP_ARG3, tf);
+}
+
+static YAP_Bool
+matrix_dot(void)
+{
+  int *mat1, *mat2;
+  sum_args a;
+  size_t n;
+  int i, nt;
+  YAP_Term tf;
+
+  mat1 = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  mat2 = (int *)YAP_BlobOfTerm(YAP_ARG2);
+  if (!mat1 || !mat2) {
+    /* Error */
+    return FALSE;
+  }
+  if (mat1[MAT_SIZE] != mat2[MAT_SIZE] ||
+      mat1[MAT_TYPE] != mat2[MAT_TYPE]) {
+    return FALSE;
+  }
+  n = mat1[MAT_SIZE];
+  if (mat1[MAT_TYPE] == INT_MATRIX) {
+    long int sum = 0;
+
+    a.ldata = matrix_long_data(mat1, mat1[MAT_NDIMS]);
+    a.ldata2 = matrix_long_data(mat2, mat2[MAT_NDIMS]);
+    nt = matrix_parallel(n, n, dot_kernel, &a);
+    for (i = 0; i < nt; i++)
+      sum += a.lsum[i];
+    tf = YAP_MkIntTerm(sum);
+  } else {
+    double sum = 0.0;
+
+    a.ldata = NULL;
+    a.ddata = matrix_double_data(mat1, mat1[MAT_NDIMS]);
+    a.ddata2 = matrix_double_data(mat2, mat2[MAT_NDIMS]);
+    nt = matrix_parallel(n, n, dot_kernel, &a);
+    for (i = 0; i < nt; i++)
+      sum += a.dsum[i];
+    tf = YAP_MkFloatTerm(sum);
+  }
+  return YAP_Unify(YAP_ARG3, tf);
+}
+
+static YAP_Bool
+matrix_transpose2(void)
+{
+  int *mat, *nmat;
+  int dims[2];
+  YAP_Term tf;
+  transpose_args a;
+
+  mat = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  if (!mat) {
+    /* Error */
+    return FALSE;
+  }
+  if (mat[MAT_NDIMS] != 2)
+    return FALSE;
+  dims[0] = mat[MAT_DIMS+1];
+  dims[1] = mat[MAT_DIMS];
+  if (mat[MAT_TYPE] == INT_MATRIX)
+    tf = new_int_matrix(2, dims, NULL);
+  else
+    tf = new_float_matrix(2, dims, NULL);
+  if (tf == YAP_TermNil())
+    return FALSE;
+  /* just in case there was an overflow */
+  mat = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  nmat = (int *)YAP_BlobOfTerm(tf);
+  nmat[MAT_BASE] = mat[MAT_BASE];
+  a.nlines = dims[1];
+  a.ncols = dims[0];
+  if (mat[MAT_TYPE] == INT_MATRIX) {
+    a.lsrc = matrix_long_data(mat, 2);
+    a.ldst = matrix_long_data(nmat, 2);
+  } else {
+    a.lsrc = NULL;
+    a.dsrc = matrix_double_data(mat, 2);
+    a.ddst = matrix_double_data(nmat, 2);
+  }
+  matrix_parallel(a.nlines, a.nlines*a.ncols, transpose_kernel, &a);
+  return YAP_Unify(YAP_ARG2, tf);
+}
+
+/* a view over the storage of a static array of ints or floats */
+static YAP_Bool
+matrix_view(void)
+{
+  int ndims = YAP_IntOfTerm(YAP_ARG2);
+  int dims[MAX_DIMS], i;
+  YAP_Int size, nelems = 1;
+  YAP_Bool floats;
+  void *data;
+  YAP_Term tf;
+
+  if (!YAP_IsAtomTerm(YAP_ARG1))
+    return FALSE;
+  if (!scan_dims(ndims, YAP_ARG3, dims))
+    return FALSE;
+  data = YAP_StaticArrayData(YAP_AtomOfTerm(YAP_ARG1), &size, &floats);
+  if (!data)
+    return FALSE;
+  if (!floats && sizeof(YAP_Int) != sizeof(long int))
+    return FALSE;
+  for (i = 0; i < ndims; i++) {
+    nelems *= dims[i];
+    if (nelems > INT_MAX) {
+      YAP_Error(REPRESENTATION_ERROR_INT, YAP_ARG3,
+		"matrix_view/3: too many elements");
+      return FALSE;
+    }
+  }
+  if (nelems > size)
+    return FALSE;
+  tf = new_matrix_view((floats ? FLOAT_MATRIX : INT_MATRIX), ndims, dims, data);
+  if (tf == YAP_TermNil())
+    return FALSE;
+  return YAP_Unify(YAP_ARG4, tf);
+}
+
+/*
+  lines First to Last of the first dimension. These are contiguous, so
+  the slice of a view is a view again. Other matrices live in the
+  stacks and may move, so their lines are copied.
+*/
+static YAP_Bool
+matrix_slice(void)
+{
+  int *mat, *nmat;
+  int dims[MAX_DIMS], ndims, i, first, last, base;
+  size_t line, esz;
+  YAP_Term tf;
+
+  mat = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  if (!mat) {
+    /* Error */
+    return FALSE;
+  }
+  if (!YAP_IsIntTerm(YAP_ARG2) || !YAP_IsIntTerm(YAP_ARG3))
+    return FALSE;
+  ndims = mat[MAT_NDIMS];
+  base = mat[MAT_BASE];
+  first = YAP_IntOfTerm(YAP_ARG2)-base;
+  last = YAP_IntOfTerm(YAP_ARG3)-base;
+  if (first < 0 || last < first || last >= mat[MAT_DIMS])
+    return FALSE;
+  dims[0] = last-first+1;
+  line = 1;
+  for (i = 1; i < ndims; i++) {
+    dims[i] = mat[MAT_DIMS+i];
+    line *= dims[i];
+  }
+  esz = (mat[MAT_TYPE] == INT_MATRIX ? sizeof(long int) : sizeof(double));
+  if (mat[MAT_VIEW]) {
+    char *data = (char *)matrix_view_data(mat, ndims)+first*line*esz;
+    tf = new_matrix_view(mat[MAT_TYPE], ndims, dims, data);
+  } else if (mat[MAT_TYPE] == INT_MATRIX) {
+    tf = new_int_matrix(ndims, dims, NULL);
+  } else {
+    tf = new_float_matrix(ndims, dims, NULL);
+  }
+  if (tf == YAP_TermNil())
+    return FALSE;
+  /* just in case there was an overflow */
+  mat = (int *)YAP_BlobOfTerm(YAP_ARG1);
+  nmat = (int *)YAP_BlobOfTerm(tf);
+  nmat[MAT_BASE] = base;
+  if (!mat[MAT_VIEW]) {
+    if (mat[MAT_TYPE] == INT_MATRIX)
+      memcpy(matrix_long_data(nmat, ndims), matrix_long_data(mat, ndims)+first*line,
+	     dims[0]*line*esz);
+    else
+      memcpy(matrix_double_data(nmat, ndims), matrix_double_data(mat, ndims)+first*line,
+	     dims[0]*line*esz);
+  }
+  return YAP_Unify(YAP_ARG4, tf);
+}
+
+/* whether the matrix shares storage with someone else */
+static YAP_Bool
+matrix_is_view(void)
+{
+  int *mat = (int *)YAP_BlobOfTerm(YAP_ARG1);
+
+  return mat && mat[MAT_VIEW];
+}
+
 static YAP_Bool
 is_matrix(void)
 {
@@ -3281,6 +4056,12 @@ init_matrix(void)
   YAP_UserCPredicate("matrixn_minarg", matrix_minarg, 2);
   YAP_UserCPredicate("matrix_sum", matrix_sum, 2);
   YAP_UserCPredicate("matrix_shuffle", matrix_transpose, 3);
+  YAP_UserCPredicate("do_matrix_transpose", matrix_transpose2, 2);
+  YAP_UserCPredicate("matrix_mul", matrix_mul, 3);
+  YAP_UserCPredicate("matrix_dot", matrix_dot, 3);
+  YAP_UserCPredicate("do_matrix_view", matrix_view, 4);
+  YAP_UserCPredicate("matrix_slice", matrix_slice, 4);
+  YAP_UserCPredicate("matrix_is_view", matrix_is_view, 1);
   YAP_UserCPredicate("matrix_expand", matrix_expand, 3);
   YAP_UserCPredicate("matrix_select", matrix_select, 4);
   YAP_UserCPredicate("matrix_column", matrix_column, 3);
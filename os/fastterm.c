@@ -0,0 +1,1069 @@
+/*************************************************************************
+*									 *
+*	 YAP Prolog 							 *
+*									 *
+*	Yap Prolog was developed at NCCUP - Universidade do Porto	 *
+*									 *
+* Copyright L.Damas, V.S.Costa and Universidade do Porto 1985-1997	 *
+*									 *
+**************************************************************************
+*									 *
+* File:		fastterm.c						 *
+* Last rev:								 *
+* mods:									 *
+* comments:	portable binary representation of terms			 *
+*									 *
+*************************************************************************/
+#ifdef SCCS
+static char SccsId[] = "%W% %G%";
+#endif
+
+/*
+   Fast terms are the binary cousins of write_canonical/1: the term is
+   flattened the same way Yap_ExportTerm() does, but every reference is
+   replaced by its position in the byte stream, so the result can be stored
+   or shipped to a YAP with a different word size or byte order:
+
+   'Y' 'F' 'T' VERSION
+   varint: size of the rest
+   varint: number of atoms, followed by the atoms:
+     0 varint(length) latin-1 bytes 0, or
+     1 varint(length) varint(code)*
+   varint: number of variables
+   the term, in prefix order:
+     FT_VAR varint(var)		FT_ATOM varint(atom)
+     FT_INT zigzag varint		FT_FLOAT 8 bytes, little endian
+     FT_BIGINT sign varint(n) n bytes, least significant first
+     FT_RATIONAL bigint bigint	FT_STRING varint(n) n UTF-8 bytes 0
+     FT_LIST head tail		FT_COMPOUND varint(atom) varint(arity) args
+
+   Varints are little endian base 128. Reading a term builds it directly
+   on the global stack, without going through an intermediate copy.
+*/
+
+#include "Yap.h"
+#include "YapHeap.h"
+#include "Yatom.h"
+#include "attvar.h"
+#include "iopreds.h"
+#include "yapio.h"
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#include <stdint.h>
+
+typedef enum {
+  FT_VAR = 1,
+  FT_ATOM,
+  FT_INT,
+  FT_FLOAT,
+  FT_BIGINT,
+  FT_RATIONAL,
+  FT_STRING,
+  FT_LIST,
+  FT_COMPOUND
+} ft_tag;
+
+/* what can go wrong when writing a term */
+#define FT_OK 0
+#define FT_STACK_OVERFLOW -1
+#define FT_TRAIL_OVERFLOW -2
+#define FT_NO_MEMORY -3
+#define FT_BAD_TERM -4
+#define FT_AUX_OVERFLOW -5
+
+typedef struct ft_buf {
+  unsigned char *data;
+  size_t size, pos;
+} ft_buf;
+
+typedef struct ft_enc {
+  ft_buf atoms, body;
+  Atom *akeys;   /* open addressing table from atoms to their number */
+  UInt *aids;
+  size_t asize;
+  UInt natoms, nvars;
+  CELL *HLow;    /* variables are bound to markers above HLow */
+  Term bad;
+} ft_enc;
+
+static bool ft_grow(ft_buf *b, size_t n) {
+  size_t nsz;
+  unsigned char *nd;
+
+  if (b->pos + n <= b->size)
+    return true;
+  nsz = (b->size ? 2 * b->size : 4096);
+  while (nsz < b->pos + n)
+    nsz *= 2;
+  if (!(nd = realloc(b->data, nsz)))
+    return false;
+  b->data = nd;
+  b->size = nsz;
+  return true;
+}
+
+static inline bool ft_byte(ft_buf *b, int c) {
+  if (!ft_grow(b, 1))
+    return false;
+  b->data[b->pos++] = c;
+  return true;
+}
+
+static bool ft_varint(ft_buf *b, uint64_t v) {
+  if (!ft_grow(b, 10))
+    return false;
+  while (v >= 0x80) {
+    b->data[b->pos++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  b->data[b->pos++] = v;
+  return true;
+}
+
+static bool ft_bytes(ft_buf *b, const void *s, size_t n) {
+  if (!ft_grow(b, n))
+    return false;
+  memcpy(b->data + b->pos, s, n);
+  b->pos += n;
+  return true;
+}
+
+static bool ft_int(ft_buf *b, int64_t i) {
+  return ft_byte(b, FT_INT) &&
+         ft_varint(b, ((uint64_t)i << 1) ^ (uint64_t)(i >> 63));
+}
+
+/* append the definition of a new atom to the atom table */
+static bool ft_atom_def(ft_buf *b, Atom at) {
+  if (IsWideAtom(at)) {
+    wchar_t *ws = RepAtom(at)->WStrOfAE;
+    size_t i, sz = wcslen(ws);
+
+    if (!ft_byte(b, 1) || !ft_varint(b, sz))
+      return false;
+    for (i = 0; i < sz; i++)
+      if (!ft_varint(b, (uint64_t)ws[i]))
+        return false;
+    return true;
+  } else {
+    const char *s = RepAtom(at)->StrOfAE;
+    size_t sz = strlen(s);
+
+    return ft_byte(b, 0) && ft_varint(b, sz) && ft_bytes(b, s, sz + 1);
+  }
+}
+
+/* the number of an atom, giving it one if this is the first time we see
+   it. Returns -1 if we ran out of memory */
+static Int ft_atom(ft_enc *e, Atom at) {
+  size_t h;
+
+  if (2 * (e->natoms + 1) > e->asize) {
+    size_t i, nsz = (e->asize ? 2 * e->asize : 256);
+    Atom *nk = calloc(nsz, sizeof(Atom));
+    UInt *ni = malloc(nsz * sizeof(UInt));
+
+    if (!nk || !ni) {
+      free(nk);
+      free(ni);
+      return -1;
+    }
+    for (i = 0; i < e->asize; i++) {
+      if (e->akeys[i]) {
+        h = ((CELL)e->akeys[i] >> 3) & (nsz - 1);
+        while (nk[h])
+          h = (h + 1) & (nsz - 1);
+        nk[h] = e->akeys[i];
+        ni[h] = e->aids[i];
+      }
+    }
+    free(e->akeys);
+    free(e->aids);
+    e->akeys = nk;
+    e->aids = ni;
+    e->asize = nsz;
+  }
+  h = ((CELL)at >> 3) & (e->asize - 1);
+  while (e->akeys[h]) {
+    if (e->akeys[h] == at)
+      return e->aids[h];
+    h = (h + 1) & (e->asize - 1);
+  }
+  if (!ft_atom_def(&e->atoms, at))
+    return -1;
+  e->akeys[h] = at;
+  e->aids[h] = e->natoms;
+  return e->natoms++;
+}
+
+#ifdef USE_GMP
+static bool ft_mpz(ft_buf *b, MP_INT *big) {
+  size_t n = (mpz_sizeinbase(big, 2) + 7) / 8, count;
+
+  if (!ft_byte(b, mpz_sgn(big) < 0) || !ft_varint(b, n) || !ft_grow(b, n))
+    return false;
+  mpz_export(b->data + b->pos, &count, -1, 1, -1, 0, big);
+  /* zero is exported as no bytes at all */
+  if (count < n)
+    memset(b->data + b->pos + count, 0, n - count);
+  b->pos += n;
+  return true;
+}
+#endif
+
+/* pending argument ranges, kept on the auxiliary stack */
+typedef struct ft_frame {
+  CELL *start, *end;
+} ft_frame;
+
+/* walk the term with an explicit stack, as the term walkers in
+   utilpreds.c do, so that deep terms do not eat the C stack */
+static int ft_put_term(Term t, ft_enc *e USES_REGS) {
+  ft_buf *b = &e->body;
+  ft_frame *to_visit0, *to_visit = (ft_frame *)Yap_PreAllocCodeSpace();
+  CELL *pt0 = &t - 1, *pt0_end = &t;
+
+  to_visit0 = to_visit;
+loop:
+  while (pt0 < pt0_end) {
+    Term d0 = Deref(*++pt0);
+
+    if (IsVarTerm(d0)) {
+      CELL *pt = VarOfTerm(d0);
+
+      if (HR > ASP - 1024)
+        return FT_STACK_OVERFLOW;
+      if (TR > (tr_fr_ptr)LOCAL_TrailTop - 256)
+        return FT_TRAIL_OVERFLOW;
+      /* bind it to a marker, so that we recognise it the next time */
+      HR[0] = (CELL)FunctorDollarVar;
+      HR[1] = MkIntegerTerm(e->nvars);
+      *pt = AbsAppl(HR);
+      TrailTerm(TR++) = (CELL)pt;
+      HR += 2;
+      if (!ft_byte(b, FT_VAR) || !ft_varint(b, e->nvars++))
+        return FT_NO_MEMORY;
+    } else if (IsAtomTerm(d0)) {
+      Int id;
+
+      if (IsBlob(AtomOfTerm(d0))) {
+        e->bad = d0;
+        return FT_BAD_TERM;
+      }
+      if ((id = ft_atom(e, AtomOfTerm(d0))) < 0 || !ft_byte(b, FT_ATOM) ||
+          !ft_varint(b, id))
+        return FT_NO_MEMORY;
+    } else if (IsIntTerm(d0)) {
+      if (!ft_int(b, IntOfTerm(d0)))
+        return FT_NO_MEMORY;
+    } else if (IsPairTerm(d0)) {
+      CELL *p = RepPair(d0);
+
+      if (!ft_byte(b, FT_LIST))
+        return FT_NO_MEMORY;
+      /* the last cell of a range needs no frame: lists and
+         right-nested terms run in constant space */
+      if (pt0 < pt0_end) {
+        if (to_visit + 1 >= (ft_frame *)AuxSp)
+          return FT_AUX_OVERFLOW;
+        to_visit->start = pt0;
+        to_visit->end = pt0_end;
+        to_visit++;
+      }
+      pt0 = p - 1;
+      pt0_end = p + 1;
+    } else {
+      CELL *p = RepAppl(d0);
+      Functor f;
+      UInt i, arity;
+      Int id;
+
+      if (p >= e->HLow) {
+        /* a variable we have seen before */
+        if (!ft_byte(b, FT_VAR) || !ft_varint(b, IntegerOfTerm(p[1])))
+          return FT_NO_MEMORY;
+        continue;
+      }
+      f = FunctorOfTerm(d0);
+      if (IsExtensionFunctor(f)) {
+        switch ((CELL)f) {
+        case (CELL)FunctorDouble: {
+          union {
+            Float f;
+            uint64_t u;
+          } d;
+          unsigned char out[8];
+
+          d.f = FloatOfTerm(d0);
+          for (i = 0; i < 8; i++)
+            out[i] = (d.u >> (8 * i)) & 0xff;
+          if (!ft_byte(b, FT_FLOAT) || !ft_bytes(b, out, 8))
+            return FT_NO_MEMORY;
+          continue;
+        }
+        case (CELL)FunctorLongInt:
+          if (!ft_int(b, LongIntOfTerm(d0)))
+            return FT_NO_MEMORY;
+          continue;
+        case (CELL)FunctorString: {
+          const unsigned char *s = UStringOfTerm(d0);
+          size_t sz = strlen((const char *)s);
+
+          if (!ft_byte(b, FT_STRING) || !ft_varint(b, sz) ||
+              !ft_bytes(b, s, sz + 1))
+            return FT_NO_MEMORY;
+          continue;
+        }
+#ifdef USE_GMP
+        case (CELL)FunctorBigInt:
+          if (p[1] == BIG_INT) {
+            if (!ft_byte(b, FT_BIGINT) || !ft_mpz(b, Yap_BigIntOfTerm(d0)))
+              return FT_NO_MEMORY;
+            continue;
+          } else if (p[1] == BIG_RATIONAL) {
+            MP_RAT *rat = Yap_BigRatOfTerm(d0);
+
+            if (!ft_byte(b, FT_RATIONAL) || !ft_mpz(b, mpq_numref(rat)) ||
+                !ft_mpz(b, mpq_denref(rat)))
+              return FT_NO_MEMORY;
+            continue;
+          }
+#endif
+        default:
+          e->bad = d0;
+          return FT_BAD_TERM;
+        }
+      }
+      arity = ArityOfFunctor(f);
+      if ((id = ft_atom(e, NameOfFunctor(f))) < 0 ||
+          !ft_byte(b, FT_COMPOUND) || !ft_varint(b, id) ||
+          !ft_varint(b, arity))
+        return FT_NO_MEMORY;
+      if (pt0 < pt0_end) {
+        if (to_visit + 1 >= (ft_frame *)AuxSp)
+          return FT_AUX_OVERFLOW;
+        to_visit->start = pt0;
+        to_visit->end = pt0_end;
+        to_visit++;
+      }
+      pt0 = p;
+      pt0_end = p + arity;
+    }
+  }
+  /* Do we still have compound terms to visit */
+  if (to_visit > to_visit0) {
+    to_visit--;
+    pt0 = to_visit->start;
+    pt0_end = to_visit->end;
+    goto loop;
+  }
+  return FT_OK;
+}
+
+static void ft_free(ft_enc *e) {
+  free(e->atoms.data);
+  free(e->body.data);
+  free(e->akeys);
+  free(e->aids);
+}
+
+/**
+ * Yap_FastTermToBuffer() serializes a term in the fast term format.
+ *
+ * @param t the term
+ * @param sizep where to store the size of the result
+ * @param arity how many argument registers must survive garbage collection
+ *
+ * @return a buffer obtained with malloc(), or NULL after raising an error.
+ */
+unsigned char *Yap_FastTermToBuffer(Term t, size_t *sizep, UInt arity) {
+  CACHE_REGS
+  ft_enc e;
+  ft_buf out;
+  unsigned char nb[24];
+  ft_buf hdr;
+  int rc;
+
+  memset(&e, 0, sizeof(e));
+  XREGS[arity + 1] = t;
+  if (!Yap_IsAcyclicTerm(t)) {
+    Yap_Error(DOMAIN_ERROR_GENERIC_ARGUMENT, t,
+              "fast term: cannot serialize cyclic terms");
+    return NULL;
+  }
+  for (;;) {
+    tr_fr_ptr TR0 = TR, pt;
+
+    t = Deref(XREGS[arity + 1]);
+    e.atoms.pos = e.body.pos = 0;
+    e.natoms = e.nvars = 0;
+    if (e.akeys)
+      memset(e.akeys, 0, e.asize * sizeof(Atom));
+    e.HLow = HR;
+    rc = ft_put_term(t, &e PASS_REGS);
+    /* undo the variable markers */
+    for (pt = TR0; pt != TR; pt++) {
+      RESET_VARIABLE(TrailTerm(pt));
+    }
+    TR = TR0;
+    HR = e.HLow;
+    if (rc == FT_OK)
+      break;
+    if (rc == FT_STACK_OVERFLOW) {
+      if (!Yap_gcl((ASP - HR) * sizeof(CELL), arity + 1, ENV, gc_P(P, CP))) {
+        ft_free(&e);
+        Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+        return NULL;
+      }
+    } else if (rc == FT_TRAIL_OVERFLOW) {
+      if (!Yap_growtrail((TR - TR0 + 1024) * sizeof(tr_fr_ptr *), FALSE)) {
+        ft_free(&e);
+        Yap_Error(RESOURCE_ERROR_TRAIL, TermNil, LOCAL_ErrorMessage);
+        return NULL;
+      }
+    } else if (rc == FT_AUX_OVERFLOW) {
+      if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
+        ft_free(&e);
+        Yap_Error(RESOURCE_ERROR_AUXILIARY_STACK, TermNil, LOCAL_ErrorMessage);
+        return NULL;
+      }
+    } else if (rc == FT_BAD_TERM) {
+      ft_free(&e);
+      Yap_Error(DOMAIN_ERROR_GENERIC_ARGUMENT, e.bad,
+                "fast term: cannot serialize blobs or data base references");
+      return NULL;
+    } else {
+      ft_free(&e);
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "fast term");
+      return NULL;
+    }
+  }
+  /* payload is the atom table, the variables and the term */
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.data = nb;
+  hdr.size = sizeof(nb);
+  ft_varint(&hdr, e.natoms);
+  {
+    size_t natoms_sz = hdr.pos;
+    size_t payload;
+
+    ft_varint(&hdr, e.nvars);
+    payload = hdr.pos + e.atoms.pos + e.body.pos;
+    memset(&out, 0, sizeof(out));
+    if (!ft_grow(&out, payload + 16)) {
+      ft_free(&e);
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "fast term");
+      return NULL;
+    }
+    ft_bytes(&out, "YFT", 3);
+    ft_byte(&out, FT_VERSION);
+    ft_varint(&out, payload);
+    ft_bytes(&out, nb, natoms_sz);
+    ft_bytes(&out, e.atoms.data, e.atoms.pos);
+    ft_bytes(&out, nb + natoms_sz, hdr.pos - natoms_sz);
+    ft_bytes(&out, e.body.data, e.body.pos);
+  }
+  ft_free(&e);
+  *sizep = out.pos;
+  return out.data;
+}
+
+typedef struct ft_dec {
+  const unsigned char *pos, *end;
+  Atom *atoms;
+  UInt natoms;
+  CELL **vars;
+  UInt nvars;
+  CELL *limit;
+} ft_dec;
+
+static bool ft_get_varint(ft_dec *d, uint64_t *vp) {
+  uint64_t v = 0;
+  int shift = 0;
+
+  while (d->pos < d->end && shift < 64) {
+    int c = *d->pos++;
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *vp = v;
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+}
+
+#ifdef USE_GMP
+static bool ft_get_mpz(ft_dec *d, mpz_t z) {
+  uint64_t n;
+  int sgn;
+
+  if (d->pos >= d->end)
+    return false;
+  sgn = *d->pos++;
+  if (!ft_get_varint(d, &n) || n > (uint64_t)(d->end - d->pos))
+    return false;
+  mpz_import(z, n, -1, 1, -1, 0, d->pos);
+  if (sgn)
+    mpz_neg(z, z);
+  d->pos += n;
+  return true;
+}
+#endif
+
+static Term ft_get_int(int64_t i USES_REGS) {
+  if ((int64_t)(Int)i == i)
+    return MkIntegerTerm((Int)i);
+#ifdef USE_GMP
+  {
+    uint64_t u = (i < 0 ? -(uint64_t)i : (uint64_t)i);
+    mpz_t z;
+    Term t;
+
+    mpz_init(z);
+    mpz_import(z, 1, -1, sizeof(u), 0, 0, &u);
+    if (i < 0)
+      mpz_neg(z, z);
+    t = Yap_MkBigIntTerm(z);
+    mpz_clear(z);
+    return t;
+  }
+#else
+  return 0L;
+#endif
+}
+
+/* decode one term into *slot, with an explicit stack of the argument
+   cells still to fill. d->limit is where the global stack runs out:
+   we return FT_STACK_OVERFLOW there, and the caller makes room and tries
+   again */
+static int ft_get_term(ft_dec *d, CELL *slot USES_REGS) {
+  ft_frame *to_visit0, *to_visit = (ft_frame *)Yap_PreAllocCodeSpace();
+  CELL *pt0 = slot - 1, *pt0_end = slot;
+
+  to_visit0 = to_visit;
+loop:
+  while (pt0 < pt0_end) {
+    uint64_t v, arity;
+    int tag;
+
+    slot = ++pt0;
+    if (d->pos >= d->end)
+      return FT_BAD_TERM;
+    if (HR > d->limit)
+      return FT_STACK_OVERFLOW;
+    tag = *d->pos++;
+    switch (tag) {
+    case FT_VAR:
+      if (!ft_get_varint(d, &v) || v >= d->nvars)
+        return FT_BAD_TERM;
+      if (d->vars[v]) {
+        *slot = (CELL)d->vars[v];
+      } else {
+        RESET_VARIABLE(slot);
+        d->vars[v] = slot;
+      }
+      break;
+    case FT_ATOM:
+      if (!ft_get_varint(d, &v) || v >= d->natoms)
+        return FT_BAD_TERM;
+      *slot = MkAtomTerm(d->atoms[v]);
+      break;
+    case FT_INT:
+      if (!ft_get_varint(d, &v))
+        return FT_BAD_TERM;
+      if (!(*slot = ft_get_int((int64_t)(v >> 1) ^ -(int64_t)(v & 1)
+                                   PASS_REGS)))
+        return FT_BAD_TERM;
+      if (*slot == TermNil)
+        return FT_STACK_OVERFLOW;
+      break;
+    case FT_FLOAT: {
+      union {
+        Float f;
+        uint64_t u;
+      } u;
+      int i;
+
+      if (d->end - d->pos < 8)
+        return FT_BAD_TERM;
+      u.u = 0;
+      for (i = 0; i < 8; i++)
+        u.u |= (uint64_t)d->pos[i] << (8 * i);
+      d->pos += 8;
+      *slot = MkFloatTerm(u.f);
+      break;
+    }
+    case FT_STRING: {
+      const unsigned char *s;
+
+      if (!ft_get_varint(d, &v) || v >= (uint64_t)(d->end - d->pos) ||
+          d->pos[v] != '\0')
+        return FT_BAD_TERM;
+      if (HR + v / sizeof(CELL) + 8 > d->limit)
+        return FT_STACK_OVERFLOW;
+      s = d->pos;
+      d->pos += v + 1;
+      *slot = MkStringTerm((const char *)s);
+      break;
+    }
+#ifdef USE_GMP
+    case FT_BIGINT: {
+      mpz_t z;
+      bool ok;
+
+      mpz_init(z);
+      ok = ft_get_mpz(d, z);
+      if (ok)
+        *slot = Yap_MkBigIntTerm(z);
+      mpz_clear(z);
+      if (!ok)
+        return FT_BAD_TERM;
+      if (*slot == TermNil)
+        return FT_STACK_OVERFLOW;
+      break;
+    }
+    case FT_RATIONAL: {
+      mpq_t q;
+      bool ok;
+
+      mpq_init(q);
+      ok = ft_get_mpz(d, mpq_numref(q)) && ft_get_mpz(d, mpq_denref(q)) &&
+           mpz_sgn(mpq_denref(q)) != 0;
+      if (ok) {
+        mpq_canonicalize(q);
+        *slot = Yap_MkBigRatTerm((MP_RAT *)q);
+      }
+      mpq_clear(q);
+      if (!ok)
+        return FT_BAD_TERM;
+      if (*slot == TermNil)
+        return FT_STACK_OVERFLOW;
+      break;
+    }
+#endif
+    case FT_LIST: {
+      CELL *p = HR;
+
+      HR += 2;
+      *slot = AbsPair(p);
+      if (pt0 < pt0_end) {
+        if (to_visit + 1 >= (ft_frame *)AuxSp)
+          return FT_AUX_OVERFLOW;
+        to_visit->start = pt0;
+        to_visit->end = pt0_end;
+        to_visit++;
+      }
+      pt0 = p - 1;
+      pt0_end = p + 1;
+      break;
+    }
+    case FT_COMPOUND: {
+      CELL *p = HR;
+      Functor f;
+
+      if (!ft_get_varint(d, &v) || v >= d->natoms ||
+          !ft_get_varint(d, &arity) || arity == 0 ||
+          arity > (uint64_t)(d->end - d->pos))
+        return FT_BAD_TERM;
+      if (HR + 1 + arity > d->limit)
+        return FT_STACK_OVERFLOW;
+      if (!(f = Yap_MkFunctor(d->atoms[v], arity)))
+        return FT_BAD_TERM;
+      HR += 1 + arity;
+      p[0] = (CELL)f;
+      *slot = AbsAppl(p);
+      if (pt0 < pt0_end) {
+        if (to_visit + 1 >= (ft_frame *)AuxSp)
+          return FT_AUX_OVERFLOW;
+        to_visit->start = pt0;
+        to_visit->end = pt0_end;
+        to_visit++;
+      }
+      pt0 = p;
+      pt0_end = p + arity;
+      break;
+    }
+    default:
+      return FT_BAD_TERM;
+    }
+  }
+  /* Do we still have compound terms to fill in */
+  if (to_visit > to_visit0) {
+    to_visit--;
+    pt0 = to_visit->start;
+    pt0_end = to_visit->end;
+    goto loop;
+  }
+  return FT_OK;
+}
+
+/* read the atom table */
+static bool ft_get_atoms(ft_dec *d) {
+  UInt i;
+
+  for (i = 0; i < d->natoms; i++) {
+    uint64_t sz, j, c;
+    int kind;
+
+    if (d->pos >= d->end)
+      return false;
+    kind = *d->pos++;
+    if (!ft_get_varint(d, &sz) || sz >= (uint64_t)(d->end - d->pos))
+      return false;
+    if (kind == 0) {
+      if (d->pos[sz] != '\0')
+        return false;
+      d->atoms[i] = Yap_LookupAtom((const char *)d->pos);
+      d->pos += sz + 1;
+    } else {
+      wchar_t *ws = malloc((sz + 1) * sizeof(wchar_t));
+
+      if (!ws)
+        return false;
+      for (j = 0; j < sz; j++) {
+        if (!ft_get_varint(d, &c)) {
+          free(ws);
+          return false;
+        }
+        ws[j] = c;
+      }
+      ws[sz] = '\0';
+      d->atoms[i] = Yap_LookupMaybeWideAtomWithLength(ws, sz);
+      free(ws);
+    }
+    if (!d->atoms[i])
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Yap_FastTermFromBuffer() rebuilds a term from its fast term form.
+ *
+ * @param buf the payload, that is, what follows the header and size
+ * @param len the size of the payload
+ * @param arity how many argument registers must survive garbage collection
+ *
+ * @param errp where to store the error, if any
+ *
+ * @return the term, or 0L without raising an error: the caller decides
+ * what to do with a bad frame.
+ */
+Term Yap_TryFastTermFromBuffer(const unsigned char *buf, size_t len,
+                               UInt arity, yap_error_number *errp) {
+  CACHE_REGS
+  ft_dec d;
+  uint64_t n;
+  /* a first guess; if the term does not fit we make room and retry */
+  size_t cells = len + 1024;
+  CELL *HR0, *root;
+  Term t = 0L;
+  int rc;
+
+  memset(&d, 0, sizeof(d));
+  for (;;) {
+    while (HR + cells > ASP - 4096) {
+      if (!Yap_gcl((cells + 4096) * sizeof(CELL), arity, ENV, gc_P(P, CP))) {
+        free(d.atoms);
+        free(d.vars);
+        *errp = RESOURCE_ERROR_STACK;
+        return 0L;
+      }
+    }
+    /* the atom table is read again after a collection */
+    d.pos = buf;
+    d.end = buf + len;
+    if (!ft_get_varint(&d, &n) || n > len)
+      goto bad;
+    d.natoms = n;
+    if (!d.atoms && !(d.atoms = malloc((n + 1) * sizeof(Atom))))
+      goto no_memory;
+    if (!ft_get_atoms(&d))
+      goto bad;
+    if (!ft_get_varint(&d, &n) || n > len)
+      goto bad;
+    d.nvars = n;
+    if (!d.vars && !(d.vars = malloc((n + 1) * sizeof(CELL *))))
+      goto no_memory;
+    memset(d.vars, 0, (n + 1) * sizeof(CELL *));
+    HR0 = HR;
+    d.limit = ASP - 1024;
+    root = HR++;
+    rc = ft_get_term(&d, root PASS_REGS);
+    if (rc == FT_OK) {
+      if (d.pos != d.end) {
+        HR = HR0;
+        goto bad;
+      }
+      break;
+    }
+    if (rc == FT_STACK_OVERFLOW) {
+      cells = 2 * (HR - HR0) + 1024;
+      HR = HR0;
+    } else if (rc == FT_AUX_OVERFLOW) {
+      HR = HR0;
+      if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
+        free(d.atoms);
+        free(d.vars);
+        *errp = RESOURCE_ERROR_AUXILIARY_STACK;
+        return 0L;
+      }
+    } else {
+      HR = HR0;
+      goto bad;
+    }
+  }
+  t = *root;
+  free(d.atoms);
+  free(d.vars);
+  return t;
+
+bad:
+  free(d.atoms);
+  free(d.vars);
+  *errp = SYNTAX_ERROR;
+  return 0L;
+
+no_memory:
+  free(d.atoms);
+  free(d.vars);
+  *errp = RESOURCE_ERROR_HEAP;
+  return 0L;
+}
+
+/**
+ * Yap_FastTermFromBuffer() is Yap_TryFastTermFromBuffer(), but raises
+ * the error.
+ *
+ * @return the term, or 0L after raising an error.
+ */
+Term Yap_FastTermFromBuffer(const unsigned char *buf, size_t len,
+                            UInt arity) {
+  CACHE_REGS
+  yap_error_number err;
+  Term t;
+
+  if ((t = Yap_TryFastTermFromBuffer(buf, len, arity, &err)))
+    return t;
+  if (err == SYNTAX_ERROR)
+    Yap_Error(err, TermNil, "fast term: corrupted data");
+  else if (err == RESOURCE_ERROR_HEAP)
+    Yap_Error(err, TermNil, "fast term");
+  else
+    Yap_Error(err, TermNil, LOCAL_ErrorMessage);
+  return 0L;
+}
+
+/* read the header, and return the size of the payload, -1 at end of file,
+   or -2 if this is not a fast term */
+static Int ft_get_header(int sno) {
+  StreamDesc *st = GLOBAL_Stream + sno;
+  uint64_t v = 0;
+  int c, i, shift = 0;
+
+  if ((c = st->stream_getc(sno)) == EOF)
+    return -1;
+  if (c != 'Y' || st->stream_getc(sno) != 'F' ||
+      st->stream_getc(sno) != 'T' || st->stream_getc(sno) != FT_VERSION)
+    return -2;
+  for (i = 0; i < 10; i++) {
+    if ((c = st->stream_getc(sno)) == EOF)
+      return -2;
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return (Int)v;
+    shift += 7;
+  }
+  return -2;
+}
+
+/** @pred fast_read(+ _Stream_, - _Term_)
+
+Read a term written by fast_write/2 from the binary stream
+ _Stream_. At the end of the stream _Term_ is unified with
+`end_of_file`. On memory mapped streams the term is built straight from
+the file contents.
+*/
+static Int fast_read(USES_REGS1) {
+  int sno = Yap_CheckBinaryStream(ARG1, Input_Stream_f, "fast_read/2");
+  StreamDesc *st;
+  const unsigned char *buf;
+  unsigned char *mbuf = NULL;
+  size_t left;
+  Int len;
+  Term t;
+
+  if (sno < 0)
+    return false;
+  st = GLOBAL_Stream + sno;
+  if ((len = ft_get_header(sno)) == -1) {
+    UNLOCK(st->streamlock);
+    return Yap_unify(ARG2, MkAtomTerm(AtomEof));
+  }
+  if (len < 0) {
+    UNLOCK(st->streamlock);
+    Yap_Error(SYNTAX_ERROR, ARG1, "fast_read/2: not a fast term");
+    return false;
+  }
+  if ((buf = Yap_MappedStreamBytes(sno, &left)) && left >= (size_t)len) {
+    /* the term is already in memory */
+    t = Yap_FastTermFromBuffer(buf, len, 2);
+    if (t)
+      Yap_MappedStreamSkip(sno, len, len, 0, 0);
+    UNLOCK(st->streamlock);
+    return t && Yap_unify(ARG2, t);
+  }
+  if (!(mbuf = malloc(len ? len : 1))) {
+    UNLOCK(st->streamlock);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "fast_read/2");
+    return false;
+  }
+  if (st->stream_getc == PlGetc && st->file) {
+    left = fread(mbuf, 1, len, st->file);
+  } else {
+    int c;
+
+    for (left = 0; left < (size_t)len; left++) {
+      if ((c = st->stream_getc(sno)) == EOF)
+        break;
+      mbuf[left] = c;
+    }
+  }
+  UNLOCK(st->streamlock);
+  if (left < (size_t)len) {
+    free(mbuf);
+    Yap_Error(SYNTAX_ERROR, ARG1, "fast_read/2: truncated term");
+    return false;
+  }
+  t = Yap_FastTermFromBuffer(mbuf, len, 2);
+  free(mbuf);
+  return t && Yap_unify(ARG2, t);
+}
+
+/** @pred fast_write(+ _Stream_, + _Term_)
+
+Write _Term_ to the binary stream _Stream_ in a compact, portable
+binary format that fast_read/2 reads back much faster than read/1
+would parse the output of write_canonical/1. Variable sharing is
+preserved; attributes, blobs and data base references are not.
+*/
+static Int fast_write(USES_REGS1) {
+  unsigned char *buf;
+  size_t sz;
+  int sno;
+  StreamDesc *st;
+
+  if (!(buf = Yap_FastTermToBuffer(ARG2, &sz, 2)))
+    return false;
+  sno = Yap_CheckBinaryStream(ARG1, Output_Stream_f, "fast_write/2");
+  if (sno < 0) {
+    free(buf);
+    return false;
+  }
+  st = GLOBAL_Stream + sno;
+  if (st->stream_putc == FilePutc && st->file) {
+    fwrite(buf, 1, sz, st->file);
+    st->charcount += sz;
+  } else {
+    size_t i;
+
+    for (i = 0; i < sz; i++)
+      st->stream_putc(sno, buf[i]);
+  }
+  UNLOCK(st->streamlock);
+  free(buf);
+  return true;
+}
+
+/** @pred fast_term_serialized(? _Term_, ? _Bytes_)
+
+_Bytes_ is the list of byte codes of _Term_ in the fast_write/2
+format. If _Term_ is unbound it is rebuilt from _Bytes_.
+*/
+static Int fast_term_serialized(USES_REGS1) {
+  Term t1 = Deref(ARG1), t2 = Deref(ARG2);
+
+  if (IsVarTerm(t1) && !IsVarTerm(t2)) {
+    unsigned char *buf;
+    Term *tailp;
+    Int len = Yap_SkipList(&t2, &tailp);
+    Int i = 0;
+    Term t;
+
+    if (*tailp != TermNil) {
+      Yap_Error(TYPE_ERROR_LIST, ARG2, "fast_term_serialized/2");
+      return false;
+    }
+    if (!(buf = malloc(len ? len : 1))) {
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "fast_term_serialized/2");
+      return false;
+    }
+    t2 = Deref(ARG2);
+    while (t2 != TermNil) {
+      Term hd = Deref(HeadOfTerm(t2));
+      Int c;
+
+      if (IsVarTerm(hd)) {
+        free(buf);
+        Yap_Error(INSTANTIATION_ERROR, hd, "fast_term_serialized/2");
+        return false;
+      }
+      if (!IsIntTerm(hd) || (c = IntOfTerm(hd)) < 0 || c > 255) {
+        free(buf);
+        Yap_Error(TYPE_ERROR_BYTE, hd, "fast_term_serialized/2");
+        return false;
+      }
+      buf[i++] = c;
+      t2 = Deref(TailOfTerm(t2));
+    }
+    t = 0L;
+    if (len < 5 || memcmp(buf, "YFT", 3) || buf[3] != FT_VERSION) {
+      Yap_Error(SYNTAX_ERROR, ARG2, "fast_term_serialized/2: not a fast term");
+    } else {
+      ft_dec d;
+      uint64_t n;
+
+      d.pos = buf + 4;
+      d.end = buf + len;
+      if (!ft_get_varint(&d, &n) || n != (uint64_t)(d.end - d.pos))
+        Yap_Error(SYNTAX_ERROR, ARG2, "fast_term_serialized/2: truncated term");
+      else
+        t = Yap_FastTermFromBuffer(d.pos, n, 2);
+    }
+    free(buf);
+    return t && Yap_unify(ARG1, t);
+  } else {
+    unsigned char *buf;
+    size_t sz, i;
+    CELL *pt;
+
+    if (!(buf = Yap_FastTermToBuffer(t1, &sz, 2)))
+      return false;
+    while (HR + 2 * sz > ASP - 1024) {
+      if (!Yap_gcl(2 * sz * sizeof(CELL), 2, ENV, gc_P(P, CP))) {
+        free(buf);
+        Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+        return false;
+      }
+    }
+    pt = HR;
+    for (i = 0; i < sz; i++) {
+      pt[0] = MkIntTerm(buf[i]);
+      pt[1] = AbsPair(pt + 2);
+      pt += 2;
+    }
+    pt[-1] = TermNil;
+    t2 = AbsPair(HR);
+    HR = pt;
+    free(buf);
+    return Yap_unify(ARG2, t2);
+  }
+}
+
+void Yap_InitFastTermPreds(void) {
+  Yap_InitCPred("fast_read", 2, fast_read, SyncPredFlag);
+  Yap_InitCPred("fast_write", 2, fast_write, SyncPredFlag);
+  Yap_InitCPred("fast_term_serialized", 2, fast_term_serialized, 0);
+}
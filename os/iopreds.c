@@ -99,17 +99,13 @@ static char SccsId[] = "%W% %G%";
 #endif
 #include "iopreds.h"
 
-#define GETW get_wchar_from_FILE
-#define GETC() fgetwc(st->file)
-#include "getw.h"
-
-#undef GETW
-#undef GETC
 #define GETW get_wchar
 #define GETC() st->stream_getc(sno)
 #include "getw.h"
 
-static int get_wchar_from_file(int);
+#ifndef _WIN32
+static int get_wchar_from_buffer(int);
+#endif
 
 FILE *Yap_stdin;
 FILE *Yap_stdout;
@@ -261,11 +257,8 @@ void Yap_DefaultStreamOps(StreamDesc *st) {
     Yap_ConsoleOps(st);
   }
 #ifndef _WIN32
-  else if (st->file != NULL && 0 && !(st->status & InMemory_Stream_f)) {
-    if (st->encoding == Yap_SystemEncoding()) {
-      st->stream_wgetc = get_wchar_from_file;
-    } else
-      st->stream_wgetc = get_wchar_from_FILE;
+  else if (st->file != NULL) {
+    st->stream_wgetc = get_wchar_from_buffer;
   }
 #endif
   if (GLOBAL_CharConversionTable != NULL)
@@ -659,11 +652,146 @@ int PlGetc(int sno) {
   return fgetc(s->file);
 }
 
-// layered version
-static int get_wchar__(int sno) { return fgetwc(GLOBAL_Stream[sno].file); }
+#ifndef _WIN32
+/* fast lane for streams read through stdio in a byte oriented encoding:
+   the characters are taken straight from the FILE buffer, without calling
+   stream_getc or locking the FILE for every byte. Everything else, including
+   streams whose stream_getc was replaced after they were set up, goes
+   through get_wchar() */
+static int get_wchar_from_buffer(int sno) {
+  StreamDesc *st = GLOBAL_Stream + sno;
+  FILE *f = st->file;
+  int ch, c1, c2, c3;
+
+  if (st->stream_getc != PlGetc)
+    return get_wchar(sno);
+  switch (st->encoding) {
+  case ENC_OCTET:
+  case ENC_ISO_LATIN1:
+  case ENC_ISO_ASCII:
+    if ((ch = getc_unlocked(f)) == EOF)
+      return post_process_weof(st);
+    return post_process_read_wchar(ch, 1, st);
+  case ENC_ISO_UTF8:
+    if ((ch = getc_unlocked(f)) < 0x80) {
+      if (ch == EOF)
+        return post_process_weof(st);
+      return post_process_read_wchar(ch, 1, st);
+    }
+    if ((c1 = getc_unlocked(f)) == EOF)
+      return post_process_weof(st);
+    if (ch < 0xe0)
+      return post_process_read_wchar(((ch & 0x1f) << 6) | (c1 & 0x3f), 2, st);
+    if ((c2 = getc_unlocked(f)) == EOF)
+      return post_process_weof(st);
+    if (ch < 0xf0)
+      return post_process_read_wchar(
+          ((ch & 0xf) << 12) | ((c1 & 0x3f) << 6) | (c2 & 0x3f), 3, st);
+    if ((c3 = getc_unlocked(f)) == EOF)
+      return post_process_weof(st);
+    return post_process_read_wchar(((ch & 7) << 18) | ((c1 & 0x3f) << 12) |
+                                       ((c2 & 0x3f) << 6) | (c3 & 0x3f),
+                                   4, st);
+  default:
+    return get_wchar(sno);
+  }
+}
+#endif
+
+/**
+ * copy the run of ASCII letters, digits and underscores that comes next in
+ * a stream to buf, without going through the stream functions.
+ *
+ * @param st the stream, only streams read through get_wchar_from_buffer()
+ *   with no character conversion are scanned.
+ * @param buf where to store the characters
+ * @param max at most how many characters to copy
+ *
+ * @return how many characters were copied, 0 if the stream can not be scanned.
+ */
+size_t Yap_GetAlnumRun(StreamDesc *st, char *buf, size_t max) {
+#ifndef _WIN32
+  FILE *f = st->file;
+  size_t n = 0;
+  int ch;
+
+  if (st->stream_wgetc_for_read != get_wchar_from_buffer ||
+      st->stream_getc != PlGetc)
+    return 0;
+  switch (st->encoding) {
+  case ENC_OCTET:
+  case ENC_ISO_LATIN1:
+  case ENC_ISO_ASCII:
+  case ENC_ISO_UTF8:
+    break;
+  default:
+    return 0;
+  }
+  while (n < max) {
+    ch = getc_unlocked(f);
+    if (ch < 0 || ch >= 0x80 || Yap_chtype[ch] > NU) {
+      if (ch != EOF)
+        ungetc(ch, f);
+      break;
+    }
+    buf[n++] = ch;
+  }
+  st->charcount += n;
+  st->linepos += n;
+  return n;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * write the run of ASCII characters at the start of s in a single block,
+ * without going through the stream functions.
+ *
+ * @param st the stream, only plain file streams that would write the
+ *   characters unchanged are handled.
+ * @param s the text to output
+ *
+ * @return how many characters were written, 0 if the stream can not take
+ *   the short cut.
+ */
+size_t Yap_PutAsciiRun(StreamDesc *st, const char *s) {
+#if !MAC && !_MSC_VER
+  size_t n = 0, nl = 0, lastnl = 0;
+  int ch;
 
-static int get_wchar_from_file(int sno) {
-  return post_process_read_wchar(get_wchar__(sno), 1, GLOBAL_Stream + sno);
+  if (st->stream_wputc != put_wchar || st->stream_putc != FilePutc ||
+      st->file == NULL)
+    return 0;
+  switch (st->encoding) {
+  case ENC_OCTET:
+  case ENC_ISO_LATIN1:
+  case ENC_ISO_ASCII:
+  case ENC_ISO_UTF8:
+    break;
+  default:
+    return 0;
+  }
+  while ((ch = ((const unsigned char *)s)[n]) && ch < 0x80) {
+    n++;
+    if (ch == '\n') {
+      nl++;
+      lastnl = n;
+    }
+  }
+  if (n == 0 || fwrite(s, 1, n, st->file) != n)
+    return 0;
+  st->charcount += n;
+  if (nl) {
+    st->linecount += nl;
+    st->linepos = n - lastnl;
+  } else {
+    st->linepos += n;
+  }
+  return n;
+#else
+  return 0;
+#endif
 }
 
 #ifndef MB_LEN_MAX
@@ -1104,7 +1232,8 @@ static bool open_header(int sno, Atom open_mode) {
       PAR("expand_filename", booleanFlag, OPEN_EXPAND_FILENAME),               \
       PAR("file_name", isatom, OPEN_FILE_NAME), PAR("input", ok, OPEN_INPUT),  \
       PAR("locale", isatom, OPEN_LOCALE), PAR("lock", isatom, OPEN_LOCK),      \
-      PAR("mode", isatom, OPEN_MODE), PAR("output", ok, OPEN_OUTPUT),          \
+      PAR("mmap", booleanFlag, OPEN_MMAP), PAR("mode", isatom, OPEN_MODE),     \
+      PAR("output", ok, OPEN_OUTPUT),                                          \
       PAR("representation_errors", booleanFlag, OPEN_REPRESENTATION_ERRORS),   \
       PAR("reposition", booleanFlag, OPEN_REPOSITION),                         \
       PAR("script", booleanFlag, OPEN_SCRIPT), PAR("type", isatom, OPEN_TYPE), \
@@ -1294,6 +1423,14 @@ do_open(Term file_name, Term t2,
     Yap_SetTextFile(RepAtom(AtomOfTerm(file_name))->StrOfAE);
   }
 #endif
+  if (open_mode == AtomRead && args[OPEN_MMAP].used &&
+      args[OPEN_MMAP].tvalue == TermTrue) {
+    FILE *mfd = Yap_MapFileStream(fd, st);
+    if (mfd != fd) {
+      fd = mfd;
+      flags |= Mmap_Stream_f;
+    }
+  }
   flags &= ~(Free_Stream_f);
   if (!Yap_initStream(sno, fd, fname, file_name, encoding, flags, open_mode))
     return false;
@@ -1424,6 +1561,14 @@ open_expands_filename.
   calling `yap -l file -- $*`. Note that YAP will not set file
   permissions as executable. In `append` mode ignore the flag.
 
++ `mmap( + _Boolean_ )` YAP extension.
+
+  In `read` mode, map the whole file in memory instead of reading it
+  through system calls. read_line_to_codes/2, read_line_to_string/2
+  and read_stream_to_codes/3 then take their text straight from the
+  map. The option is ignored if the file cannot be mapped, e.g. if it
+  is not a regular file.
+
 
 */
 static Int open4(USES_REGS1) { /* '$open'(+File,+Mode,?Stream,-ReturnCode) */
@@ -1862,6 +2007,7 @@ void Yap_InitIOPreds(void) {
   Yap_InitPipes();
   Yap_InitFiles();
   Yap_InitWriteTPreds();
+  Yap_InitFastTermPreds();
   Yap_InitReadTPreds();
   Yap_InitFormat();
   Yap_InitRandomPreds();
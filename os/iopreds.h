@@ -77,6 +77,7 @@ extern int Yap_CheckSocketStream(Term, const char *);
 extern socket_domain Yap_GetSocketDomain(int);
 extern socket_info Yap_GetSocketStatus(int);
 extern void Yap_UpdateSocketStream(int, socket_info, socket_domain);
+extern void Yap_FreeSocketBuffers(struct stream_desc *);
 
 /* routines in ypsocks.c */
 Int Yap_CloseSocket(int, socket_info, socket_domain);
@@ -225,6 +226,9 @@ typedef struct stream_desc {
       socket_domain domain;
       socket_info flags;
       int fd;
+      /* pending input and output for the non-blocking calls */
+      char *rbuf, *wbuf;
+      size_t rlen, rsize, wlen, wsize;
     } socket;
 #endif
     struct {
@@ -301,6 +305,11 @@ void Yap_DefaultStreamOps(StreamDesc *st);
 void Yap_PipeOps(StreamDesc *st);
 void Yap_MemOps(StreamDesc *st);
 bool Yap_CloseMemoryStream(int sno);
+FILE *Yap_MapFileStream(FILE *f, StreamDesc *st);
+void Yap_UnmapFileStream(StreamDesc *st);
+const unsigned char *Yap_MappedStreamBytes(int sno, size_t *left);
+void Yap_MappedStreamSkip(int sno, size_t n, size_t nchars, size_t nlines,
+                          size_t linepos);
 void Yap_ConsolePipeOps(StreamDesc *st);
 void Yap_SocketOps(StreamDesc *st);
 void Yap_ConsoleSocketOps(StreamDesc *st);
@@ -327,6 +336,7 @@ void Yap_InitFormat(void);
 void Yap_InitFiles(void);
 void Yap_InitIOStreams(void);
 void Yap_InitWriteTPreds(void);
+void Yap_InitFastTermPreds(void);
 void Yap_InitReadTPreds(void);
 void Yap_socketStream(StreamDesc *s);
 void Yap_ReadlineFlush(int sno);
@@ -351,6 +361,14 @@ Term read_line(int sno);
 int PlGets(int sno, UInt size, char *buf);
 GetsFunc PlGetsFunc(void);
 int PlGetc(int sno);
+size_t Yap_GetAlnumRun(StreamDesc *st, char *buf, size_t max);
+size_t Yap_PutAsciiRun(StreamDesc *st, const char *s);
+/* version byte of the fast term header, after "YFT" */
+#define FT_VERSION 1
+unsigned char *Yap_FastTermToBuffer(Term t, size_t *sizep, UInt arity);
+Term Yap_FastTermFromBuffer(const unsigned char *buf, size_t len, UInt arity);
+Term Yap_TryFastTermFromBuffer(const unsigned char *buf, size_t len, UInt arity,
+                               yap_error_number *errp);
 int FilePutc(int sno, int c);
 int DefaultGets(int, UInt, char *);
 int put_wchar(int sno, wchar_t ch);
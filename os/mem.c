@@ -24,6 +24,9 @@ static char SccsId[] = "%W% %G%";
  */
 
 #include "sysbits.h"
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #if !MAY_READ
 static int MemGetc(int);
@@ -322,6 +325,96 @@ restart:
   return (Yap_unify(ARG3, tf));
 }
 
+/**
+ * Yap_MapFileStream() replaces the FILE of a file opened for reading by a
+ * read-only map of the whole file, accessed through fmemopen(). The map is
+ * kept in the nbuf and nsize fields of the stream; the caller should mark
+ * the stream with Mmap_Stream_f, so that it is undone on close.
+ *
+ * @param f the FILE returned by fopen()
+ * @param st the stream being opened
+ *
+ * @return the FILE to use, f itself if the file could not be mapped.
+ */
+FILE *Yap_MapFileStream(FILE *f, StreamDesc *st) {
+#if MAY_READ && HAVE_MMAP && HAVE_SYS_MMAN_H
+  struct stat sb;
+  void *map;
+  FILE *mf;
+
+  if (fstat(fileno(f), &sb) < 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0)
+    return f;
+  map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  if (map == MAP_FAILED)
+    return f;
+#ifdef MADV_SEQUENTIAL
+  madvise(map, (size_t)sb.st_size, MADV_SEQUENTIAL);
+#endif
+  if (!(mf = fmemopen(map, (size_t)sb.st_size, "r"))) {
+    munmap(map, (size_t)sb.st_size);
+    return f;
+  }
+  fclose(f);
+  st->nbuf = map;
+  st->nsize = (size_t)sb.st_size;
+  return mf;
+#else
+  return f;
+#endif
+}
+
+void Yap_UnmapFileStream(StreamDesc *st) {
+#if MAY_READ && HAVE_MMAP && HAVE_SYS_MMAN_H
+  munmap(st->nbuf, st->nsize);
+  st->nbuf = NULL;
+  st->nsize = 0;
+#endif
+}
+
+/**
+ * Yap_MappedStreamBytes() gives direct access to the bytes still to be read
+ * from a memory mapped stream.
+ *
+ * @param sno the stream
+ * @param left where to store how many bytes are left
+ *
+ * @return the next byte to read, or NULL if the stream is not mapped or is
+ * at its end.
+ */
+const unsigned char *Yap_MappedStreamBytes(int sno, size_t *left) {
+  StreamDesc *st = GLOBAL_Stream + sno;
+  long pos;
+
+  if (!(st->status & Mmap_Stream_f) || (st->status & Eof_Stream_f) ||
+      (pos = ftell(st->file)) < 0 || (size_t)pos >= st->nsize)
+    return NULL;
+  *left = st->nsize - pos;
+  return (const unsigned char *)st->nbuf + pos;
+}
+
+/**
+ * Yap_MappedStreamSkip() consumes bytes read through Yap_MappedStreamBytes().
+ *
+ * @param sno the stream
+ * @param n how many bytes were consumed
+ * @param nchars how many characters they make
+ * @param nlines how many of them were newlines
+ * @param linepos the column after the last character
+ */
+void Yap_MappedStreamSkip(int sno, size_t n, size_t nchars, size_t nlines,
+                          size_t linepos) {
+  StreamDesc *st = GLOBAL_Stream + sno;
+
+  fseek(st->file, n, SEEK_CUR);
+  st->charcount += nchars;
+  if (nlines) {
+    st->linecount += nlines;
+    st->linepos = linepos;
+  } else {
+    st->linepos += linepos;
+  }
+}
+
 void Yap_MemOps(StreamDesc *st) {
 #if MAY_WRITE
   st->stream_putc = FilePutc;
@@ -25,9 +25,64 @@ static char SccsId[] = "%W% %G%";
 #include "encoding.h"
 #include "iopreds.h"
 #include "yapio.h"
+#include <ctype.h>
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
 
 /// @addtogroup readutil
 
+/* consume n bytes of a memory mapped stream, counting the characters
+   they decode to and the newlines among them */
+static void mapped_skip(int sno, const unsigned char *s, size_t n) {
+  bool utf8 = GLOBAL_Stream[sno].encoding == ENC_ISO_UTF8;
+  size_t i, nchars = 0, nlines = 0, linepos = 0;
+
+  for (i = 0; i < n; i++) {
+    /* UTF-8 continuation bytes do not start a character */
+    if (utf8 && (s[i] & 0xc0) == 0x80)
+      continue;
+    nchars++;
+    if (s[i] == '\n') {
+      nlines++;
+      linepos = 0;
+    } else {
+      linepos++;
+    }
+  }
+  Yap_MappedStreamSkip(sno, n, nchars, nlines, linepos);
+}
+
+/* copy the next line of a memory mapped stream to buf, without the line
+   terminator. Returns its size, -2 at the end of the stream, or -1 if the
+   stream must be read character by character */
+static Int mapped_line(int sno, unsigned char *buf, UInt buf_sz) {
+  StreamDesc *st = GLOBAL_Stream + sno;
+  const unsigned char *s, *nl;
+  size_t left, n, len;
+
+  if (!(st->status & Mmap_Stream_f) ||
+      (st->encoding != ENC_ISO_UTF8 && st->encoding != ENC_ISO_ASCII) ||
+      st->stream_wgetc_for_read != st->stream_wgetc)
+    return -1;
+  if (!(s = Yap_MappedStreamBytes(sno, &left))) {
+    /* let the stream find its end of file */
+    st->stream_wgetc(sno);
+    return -2;
+  }
+  nl = memchr(s, '\n', left);
+  len = (nl ? nl - s : left);
+  n = (nl ? len + 1 : len);
+  if (len >= buf_sz)
+    return -1;
+  memcpy(buf, s, len);
+  if (len && buf[len - 1] == '\r')
+    len--;
+  buf[len] = '\0';
+  mapped_skip(sno, s, n);
+  return len;
+}
+
 static Int rl_to_codes(Term TEnd, int do_as_binary, int arity USES_REGS) {
   int sno = Yap_CheckStream(ARG1, Input_Stream_f, "read_line_to_codes/2");
   StreamDesc *st = GLOBAL_Stream + sno;
@@ -48,6 +103,17 @@ static Int rl_to_codes(Term TEnd, int do_as_binary, int arity USES_REGS) {
   max_inp = (ASP - HR) / 2 - 1024;
   buf = (unsigned char *)TR;
   buf_sz = (unsigned char *)LOCAL_TrailTop - buf;
+  if (!do_as_binary) {
+    Int len = mapped_line(sno, buf, (buf_sz > max_inp ? max_inp : buf_sz));
+    if (len == -2) {
+      UNLOCK(GLOBAL_Stream[sno].streamlock);
+      return Yap_unify_constant(ARG2, MkAtomTerm(AtomEof));
+    } else if (len >= 0) {
+      UNLOCK(GLOBAL_Stream[sno].streamlock);
+      return Yap_unify(ARG2,
+                       Yap_UTF8ToDiffListOfCodes((const char *)TR, TermNil PASS_REGS));
+    }
+  }
   while (true) {
     if (buf_sz > max_inp) {
       buf_sz = max_inp;
@@ -146,6 +212,12 @@ static Int read_line_to_string(USES_REGS1) {
     if (buf_sz > max_inp) {
       buf_sz = max_inp;
     }
+    if ((sz = mapped_line(sno, buf, buf_sz)) != (size_t)-1) {
+      UNLOCK(GLOBAL_Stream[sno].streamlock);
+      if (sz == (size_t)-2)
+        return Yap_unify_constant(ARG2, MkAtomTerm(AtomEof));
+      return Yap_unify(ARG2, Yap_UTF8ToString((const char *)TR PASS_REGS));
+    }
     if (st->status & Binary_Stream_f) {
       char *b = (char *)TR;
       sz = fread(b, 1, buf_sz, GLOBAL_Stream[sno].file);
@@ -214,8 +286,22 @@ static Int read_stream_to_codes(USES_REGS1) {
   CELL *HBASE = HR;
   CELL *h0 = &ARG4;
 
+  const unsigned char *s;
+  size_t left;
+
   if (sno < 0)
     return FALSE;
+  if ((s = Yap_MappedStreamBytes(sno, &left)) && HR + 2 * left + 1024 < ASP) {
+    /* the whole text is in memory, and so is the space for its list */
+    size_t i;
+    for (i = 0; i < left; i++) {
+      h0[0] = AbsPair(HR);
+      HR[0] = MkIntTerm(s[i]);
+      HR += 2;
+      h0 = HR - 1;
+    }
+    mapped_skip(sno, s, left);
+  }
   while (!(GLOBAL_Stream[sno].status & Eof_Stream_f)) {
     /* skip errors */
     Int ch = GLOBAL_Stream[sno].stream_getc(sno);
@@ -288,6 +374,357 @@ static Int read_stream_to_terms(USES_REGS1) {
   return Yap_unify(t, ARG2);
 }
 
+/*
+  Term index files: the byte offset and line number where each term of a
+  Prolog text starts, found by a scan that only understands quotes,
+  comments and end tokens. They are stored next to the text, and allow
+  reading any term, or any range of terms, without parsing what comes
+  before it.
+
+  The file is a header, then one (offset, line) pair of 64 bit integers in
+  native byte order per term. The size and modification time of the text
+  are kept in the header, so that a stale index is never used.
+*/
+
+#define TIX_MAGIC "YTIX"
+#define TIX_VERSION 1
+
+typedef struct tix_header {
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+  int64_t mtime;
+  uint64_t count;
+} tix_header;
+
+typedef struct tix_entry {
+  uint64_t offset, line;
+} tix_entry;
+
+typedef enum {
+  TIX_CODE,
+  TIX_SLASH,
+  TIX_LINE_COMMENT,
+  TIX_BLOCK,
+  TIX_BLOCK_STAR,
+  TIX_QUOTE,
+  TIX_QUOTE_ESC,
+  TIX_QUOTE_NUMESC,
+  TIX_QUOTE_END,
+  TIX_DOT,
+  TIX_ZERO,
+  TIX_CHAR,
+  TIX_CHAR_ESC,
+  TIX_CHAR_QUOTE
+} tix_state;
+
+typedef struct tix_scan {
+  tix_state state;
+  int quote;                   /* the quote we are in */
+  bool in_term, prev_sym, prev_alnum, slash_opened;
+  uint64_t line;
+  tix_entry *entries;
+  size_t count, size;
+} tix_scan;
+
+static bool tix_symbol_char(int c) {
+  return c && strchr("#$&*+-./:<=>?@^~\\", c) != NULL;
+}
+
+static bool tix_layout(int c) { return c <= ' ' || c == 127; }
+
+static bool tix_start(tix_scan *sc, uint64_t off) {
+  if (sc->count == sc->size) {
+    size_t nsz = (sc->size ? 2 * sc->size : 1024);
+    tix_entry *ne = realloc(sc->entries, nsz * sizeof(tix_entry));
+
+    if (!ne)
+      return false;
+    sc->entries = ne;
+    sc->size = nsz;
+  }
+  sc->entries[sc->count].offset = off;
+  sc->entries[sc->count].line = sc->line;
+  sc->count++;
+  sc->in_term = true;
+  return true;
+}
+
+/* feed one byte at offset off to the scanner */
+static bool tix_char(tix_scan *sc, int c, uint64_t off) {
+again:
+  switch (sc->state) {
+  case TIX_CODE:
+    if (c == '%') {
+      sc->state = TIX_LINE_COMMENT;
+      break;
+    }
+    if (tix_layout(c)) {
+      sc->prev_sym = sc->prev_alnum = false;
+      break;
+    }
+    sc->slash_opened = (c == '/' && !sc->in_term);
+    if (!sc->in_term && !tix_start(sc, off))
+      return false;
+    if (c == '/') {
+      sc->state = TIX_SLASH;
+    } else if (c == '.' && !sc->prev_sym) {
+      sc->state = TIX_DOT;
+    } else if (c == '\'' || c == '"' || c == '`') {
+      sc->quote = c;
+      sc->state = TIX_QUOTE;
+    } else if (c == '0' && !sc->prev_alnum) {
+      sc->state = TIX_ZERO;
+    } else {
+      sc->prev_sym = tix_symbol_char(c);
+      sc->prev_alnum = (c == '_' || isalnum(c) || c >= 128);
+    }
+    break;
+  case TIX_SLASH:
+    if (c == '*') {
+      /* a comment, not the first token of a term */
+      if (sc->slash_opened) {
+        sc->count--;
+        sc->in_term = false;
+      }
+      sc->state = TIX_BLOCK;
+      break;
+    }
+    sc->state = TIX_CODE;
+    sc->prev_sym = true;
+    sc->prev_alnum = false;
+    goto again;
+  case TIX_LINE_COMMENT:
+    if (c == '\n') {
+      sc->state = TIX_CODE;
+      sc->prev_sym = sc->prev_alnum = false;
+    }
+    break;
+  case TIX_BLOCK:
+    if (c == '*')
+      sc->state = TIX_BLOCK_STAR;
+    break;
+  case TIX_BLOCK_STAR:
+    if (c == '/') {
+      sc->state = TIX_CODE;
+      sc->prev_sym = sc->prev_alnum = false;
+    } else if (c != '*') {
+      sc->state = TIX_BLOCK;
+    }
+    break;
+  case TIX_QUOTE:
+    if (c == '\\')
+      sc->state = TIX_QUOTE_ESC;
+    else if (c == sc->quote)
+      sc->state = TIX_QUOTE_END;
+    break;
+  case TIX_QUOTE_ESC:
+    /* \x41\ and \101\ run up to a closing backslash */
+    sc->state = (c == 'x' || (c >= '0' && c <= '7') ? TIX_QUOTE_NUMESC
+                                                     : TIX_QUOTE);
+    break;
+  case TIX_QUOTE_NUMESC:
+    if (c == '\\') {
+      sc->state = TIX_QUOTE;
+    } else if (!isxdigit(c)) {
+      sc->state = TIX_QUOTE;
+      goto again;
+    }
+    break;
+  case TIX_QUOTE_END:
+    if (c == sc->quote) {
+      sc->state = TIX_QUOTE;
+      break;
+    }
+    sc->state = TIX_CODE;
+    sc->prev_sym = sc->prev_alnum = false;
+    goto again;
+  case TIX_DOT:
+    if (tix_layout(c) || c == '%') {
+      /* an end token */
+      sc->in_term = false;
+      sc->state = TIX_CODE;
+      sc->prev_sym = sc->prev_alnum = false;
+      goto again;
+    }
+    sc->state = TIX_CODE;
+    sc->prev_sym = true;
+    sc->prev_alnum = false;
+    goto again;
+  case TIX_ZERO:
+    if (c == '\'') {
+      sc->state = TIX_CHAR;
+      break;
+    }
+    sc->state = TIX_CODE;
+    sc->prev_sym = false;
+    sc->prev_alnum = true;
+    goto again;
+  case TIX_CHAR:
+    sc->state = (c == '\\' ? TIX_CHAR_ESC
+                           : c == '\'' ? TIX_CHAR_QUOTE : TIX_CODE);
+    sc->prev_sym = false;
+    sc->prev_alnum = true;
+    break;
+  case TIX_CHAR_ESC:
+    sc->state = TIX_CODE;
+    break;
+  case TIX_CHAR_QUOTE:
+    /* 0''' as well as 0'' */
+    sc->state = TIX_CODE;
+    if (c != '\'')
+      goto again;
+    break;
+  }
+  if (c == '\n')
+    sc->line++;
+  return true;
+}
+
+static const char *tix_file_name(Term t, const char *msg) {
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, msg);
+    return NULL;
+  }
+  if (!IsAtomTerm(t)) {
+    Yap_Error(TYPE_ERROR_ATOM, t, msg);
+    return NULL;
+  }
+  return RepAtom(AtomOfTerm(t))->StrOfAE;
+}
+
+/* '$term_index_build'(+File, +IndexFile, -Count) */
+static Int term_index_build(USES_REGS1) {
+  const char *src = tix_file_name(Deref(ARG1), "term_file_index/2");
+  const char *dst = tix_file_name(Deref(ARG2), "term_file_index/2");
+  unsigned char buf[64 * 1024];
+  tix_scan sc;
+  tix_header h;
+  struct stat st;
+  uint64_t off = 0;
+  size_t n, i;
+  FILE *in, *out;
+  int err = 0;
+
+  if (!src || !dst)
+    return false;
+  if (!(in = fopen(src, "rb")) || fstat(fileno(in), &st) < 0) {
+    if (in)
+      fclose(in);
+    Yap_Error(EXISTENCE_ERROR_SOURCE_SINK, ARG1, "term_file_index/2: %s",
+              strerror(errno));
+    return false;
+  }
+  memset(&sc, 0, sizeof(sc));
+  sc.line = 1;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    for (i = 0; i < n; i++)
+      if (!tix_char(&sc, buf[i], off + i)) {
+        fclose(in);
+        free(sc.entries);
+        Yap_Error(RESOURCE_ERROR_HEAP, ARG1, "term_file_index/2");
+        return false;
+      }
+    off += n;
+  }
+  fclose(in);
+  memcpy(h.magic, TIX_MAGIC, 4);
+  h.version = TIX_VERSION;
+  h.size = st.st_size;
+  h.mtime = st.st_mtime;
+  h.count = sc.count;
+  if (!(out = fopen(dst, "wb"))) {
+    err = errno;
+  } else {
+    if (fwrite(&h, sizeof(h), 1, out) != 1 ||
+        (sc.count &&
+         fwrite(sc.entries, sizeof(tix_entry), sc.count, out) != sc.count))
+      err = (errno ? errno : EIO);
+    /* the stream is gone after fclose(), even if it fails */
+    if (fclose(out) != 0 && !err)
+      err = errno;
+  }
+  if (err) {
+    remove(dst);
+    free(sc.entries);
+    Yap_Error(PERMISSION_ERROR_OUTPUT_STREAM, ARG2, "term_file_index/2: %s",
+              strerror(err));
+    return false;
+  }
+  free(sc.entries);
+  return Yap_unify(ARG3, MkIntegerTerm(sc.count));
+}
+
+static FILE *tix_open(const char *src, const char *dst, tix_header *h) {
+  struct stat st;
+  FILE *f;
+
+  if (stat(src, &st) < 0 || !(f = fopen(dst, "rb")))
+    return NULL;
+  if (fread(h, sizeof(*h), 1, f) != 1 || memcmp(h->magic, TIX_MAGIC, 4) ||
+      h->version != TIX_VERSION || h->size != (uint64_t)st.st_size ||
+      h->mtime != (int64_t)st.st_mtime) {
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+/* '$term_index_check'(+File, +IndexFile, -Count): fails if there is no
+   up to date index */
+static Int term_index_check(USES_REGS1) {
+  const char *src = tix_file_name(Deref(ARG1), "term_file_index/2");
+  const char *dst = tix_file_name(Deref(ARG2), "term_file_index/2");
+  tix_header h;
+  FILE *f;
+
+  if (!src || !dst || !(f = tix_open(src, dst, &h)))
+    return false;
+  fclose(f);
+  return Yap_unify(ARG3, MkIntegerTerm(h.count));
+}
+
+/* '$term_index_position'(+File, +IndexFile, +N, -Pos): the position of the
+   Nth term, for set_stream_position/2 */
+static Int term_index_position(USES_REGS1) {
+  const char *src = tix_file_name(Deref(ARG1), "read_indexed_term/3");
+  const char *dst = tix_file_name(Deref(ARG2), "read_indexed_term/3");
+  Term tn = Deref(ARG3), ts[4];
+  tix_header h;
+  tix_entry e;
+  Int n;
+  FILE *f;
+
+  if (!src || !dst)
+    return false;
+  if (IsVarTerm(tn)) {
+    Yap_Error(INSTANTIATION_ERROR, tn, "read_indexed_term/3");
+    return false;
+  }
+  if (!IsIntegerTerm(tn)) {
+    Yap_Error(TYPE_ERROR_INTEGER, tn, "read_indexed_term/3");
+    return false;
+  }
+  if (!(f = tix_open(src, dst, &h))) {
+    Yap_Error(PERMISSION_ERROR_INPUT_STREAM, ARG2,
+              "read_indexed_term/3: index is missing or out of date");
+    return false;
+  }
+  n = IntegerOfTerm(tn);
+  if (n < 1 || (uint64_t)n > h.count ||
+      fseek(f, (long)(sizeof(h) + (n - 1) * sizeof(e)), SEEK_SET) < 0 ||
+      fread(&e, sizeof(e), 1, f) != 1) {
+    fclose(f);
+    return false;
+  }
+  fclose(f);
+  ts[0] = MkIntegerTerm(e.offset);
+  ts[1] = MkIntegerTerm(e.line);
+  ts[2] = MkIntTerm(0);
+  ts[3] = MkIntegerTerm(e.offset);
+  return Yap_unify(ARG4, Yap_MkApplTerm(FunctorStreamPos, 4, ts));
+}
+
 void Yap_InitReadUtil(void) {
   CACHE_REGS
 
@@ -298,5 +735,8 @@ void Yap_InitReadUtil(void) {
   Yap_InitCPred("read_line_to_codes", 3, read_line_to_codes2, SyncPredFlag);
   Yap_InitCPred("read_stream_to_codes", 3, read_stream_to_codes, SyncPredFlag);
   Yap_InitCPred("read_stream_to_terms", 3, read_stream_to_terms, SyncPredFlag);
+  Yap_InitCPred("$term_index_build", 3, term_index_build, SyncPredFlag);
+  Yap_InitCPred("$term_index_check", 3, term_index_check, SyncPredFlag);
+  Yap_InitCPred("$term_index_position", 4, term_index_position, SyncPredFlag);
   CurrentModule = cm;
 }
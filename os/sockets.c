@@ -250,6 +250,9 @@ Yap_InitSocketStream(int fd, socket_info flags, socket_domain domain) {
     st->status = Socket_Stream_f;
   }
   st->u.socket.fd = fd;
+  st->u.socket.rbuf = st->u.socket.wbuf = NULL;
+  st->u.socket.rlen = st->u.socket.rsize = 0;
+  st->u.socket.wlen = st->u.socket.wsize = 0;
   // use dup and have two streams?
   st->file = fdopen( fd, "rw");
   st->charcount = 0;
@@ -262,6 +265,17 @@ Yap_InitSocketStream(int fd, socket_info flags, socket_domain domain) {
   return(Yap_MkStream(sno));
 }
 
+/* release the buffers used by socket_recv_lines/3 and friends */
+void
+Yap_FreeSocketBuffers(StreamDesc *st)
+{
+  free(st->u.socket.rbuf);
+  free(st->u.socket.wbuf);
+  st->u.socket.rbuf = st->u.socket.wbuf = NULL;
+  st->u.socket.rlen = st->u.socket.rsize = 0;
+  st->u.socket.wlen = st->u.socket.wsize = 0;
+}
+
 /* given a socket file descriptor, get the corresponding stream descripor */
 int
 Yap_CheckSocketStream(Term stream, const char * error)
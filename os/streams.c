@@ -903,13 +903,17 @@ static void CloseStream(int sno) {
 
   fflush(NULL);
   if (!(GLOBAL_Stream[sno].status &
-        (Null_Stream_f | Socket_Stream_f | InMemory_Stream_f | Pipe_Stream_f)))
+        (Null_Stream_f | Socket_Stream_f | InMemory_Stream_f | Pipe_Stream_f))) {
     fclose(GLOBAL_Stream[sno].file);
+    if (GLOBAL_Stream[sno].status & Mmap_Stream_f)
+      Yap_UnmapFileStream(GLOBAL_Stream + sno);
+  }
 #if HAVE_SOCKET
   else if (GLOBAL_Stream[sno].status & (Socket_Stream_f)) {
     Yap_CloseSocket(GLOBAL_Stream[sno].u.socket.fd,
                     GLOBAL_Stream[sno].u.socket.flags,
                     GLOBAL_Stream[sno].u.socket.domain);
+    Yap_FreeSocketBuffers(GLOBAL_Stream + sno);
   }
 #endif
   else if (GLOBAL_Stream[sno].status & Pipe_Stream_f) {
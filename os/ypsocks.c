@@ -67,6 +67,9 @@
 #if HAVE_SYS_PARAM_H
 #include <sys/param.h>
 #endif
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #endif
 #ifdef _WIN32
 //#include <ws2tcpip.h>
@@ -1244,6 +1247,486 @@ static Int p_hostname_address(USES_REGS1) {
     return (Yap_unify(out, ARG2));
   }
 }
+
+/*
+   Event loop support. A poll set is an epoll descriptor: streams are
+   registered one-shot, so that when several threads wait on the same set
+   each ready stream goes to a single thread, and stays quiet until it is
+   added again. The non-blocking calls below keep whatever was not
+   consumed in buffers attached to the socket stream.
+*/
+#if HAVE_SYS_EPOLL_H
+
+#define MAX_POLL_EVENTS 256
+
+static Functor poll_functor(void) {
+  return Yap_MkFunctor(Yap_LookupAtom("$stream_poll"), 1);
+}
+
+static int get_poll_fd(Term t, const char *msg) {
+  Term ta;
+
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, msg);
+    return -1;
+  }
+  if (!IsApplTerm(t) || FunctorOfTerm(t) != poll_functor() ||
+      !IsIntTerm(ta = ArgOfTerm(1, t))) {
+    Yap_Error(DOMAIN_ERROR_GENERIC_ARGUMENT, t, msg);
+    return -1;
+  }
+  return IntOfTerm(ta);
+}
+
+/** @pred stream_poll_create(- _POLL_)
+
+Create a new poll set, used to wait for events on many streams at once.
+*/
+static Int p_stream_poll_create(USES_REGS1) {
+  int fd = epoll_create1(EPOLL_CLOEXEC);
+  Term t;
+
+  if (fd < 0) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, TermNil,
+              "stream_poll_create/1 (epoll_create: %s)", strerror(errno));
+    return false;
+  }
+  t = MkIntTerm(fd);
+  return Yap_unify(ARG1, Yap_MkApplTerm(poll_functor(), 1, &t));
+}
+
+/** @pred stream_poll_close(+ _POLL_)
+
+Release a poll set. The streams themselves are not closed.
+*/
+static Int p_stream_poll_close(USES_REGS1) {
+  int fd = get_poll_fd(Deref(ARG1), "stream_poll_close/1");
+
+  if (fd < 0)
+    return false;
+  close(fd);
+  return true;
+}
+
+/** @pred stream_poll_add(+ _POLL_, + _STREAM_, + _EVENTS_)
+
+Wait for _EVENTS_, a list with `read` and/or `write`, on _STREAM_.
+The stream is reported once by stream_poll_wait/3, and must then be
+added again to be watched again.
+*/
+static Int p_stream_poll_add(USES_REGS1) {
+  int pfd = get_poll_fd(Deref(ARG1), "stream_poll_add/3");
+  Term tl = Deref(ARG3);
+  struct epoll_event ev;
+  int sno;
+
+  if (pfd < 0)
+    return false;
+  sno = Yap_CheckStream(ARG2, 0, "stream_poll_add/3");
+  if (sno < 0)
+    return false;
+  UNLOCK(GLOBAL_Stream[sno].streamlock);
+  ev.events = EPOLLONESHOT | EPOLLRDHUP;
+  ev.data.u64 = sno;
+  while (IsPairTerm(tl)) {
+    Term th = Deref(HeadOfTerm(tl));
+
+    if (th == MkAtomTerm(AtomRead))
+      ev.events |= EPOLLIN;
+    else if (th == MkAtomTerm(AtomWrite))
+      ev.events |= EPOLLOUT;
+    else {
+      Yap_Error(DOMAIN_ERROR_IO_MODE, th, "stream_poll_add/3");
+      return false;
+    }
+    tl = Deref(TailOfTerm(tl));
+  }
+  if (tl != TermNil) {
+    Yap_Error(TYPE_ERROR_LIST, ARG3, "stream_poll_add/3");
+    return false;
+  }
+  if (epoll_ctl(pfd, EPOLL_CTL_MOD, Yap_GetStreamFd(sno), &ev) < 0 &&
+      (errno != ENOENT ||
+       epoll_ctl(pfd, EPOLL_CTL_ADD, Yap_GetStreamFd(sno), &ev) < 0)) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, ARG2,
+              "stream_poll_add/3 (epoll_ctl: %s)", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/** @pred stream_poll_remove(+ _POLL_, + _STREAM_)
+
+Stop watching _STREAM_. Streams are also removed when they are closed.
+*/
+static Int p_stream_poll_remove(USES_REGS1) {
+  int pfd = get_poll_fd(Deref(ARG1), "stream_poll_remove/2");
+  struct epoll_event ev;
+  int sno;
+
+  if (pfd < 0)
+    return false;
+  sno = Yap_CheckStream(ARG2, 0, "stream_poll_remove/2");
+  if (sno < 0)
+    return false;
+  UNLOCK(GLOBAL_Stream[sno].streamlock);
+  if (epoll_ctl(pfd, EPOLL_CTL_DEL, Yap_GetStreamFd(sno), &ev) < 0 &&
+      errno != ENOENT) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, ARG2,
+              "stream_poll_remove/2 (epoll_ctl: %s)", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/** @pred stream_poll_wait(+ _POLL_, + _TIMEOUT_, - _READY_)
+
+Wait until some of the streams in _POLL_ are ready, or for _TIMEOUT_
+milliseconds (`off` waits forever). _READY_ is a list of
+_STREAM_-_EVENTS_, where _EVENTS_ may include `read`, `write`,
+`hangup` and `error`. At most 256 streams are returned in one call.
+*/
+static Int p_stream_poll_wait(USES_REGS1) {
+  int pfd = get_poll_fd(Deref(ARG1), "stream_poll_wait/3");
+  Term t2 = Deref(ARG2), tout = TermNil;
+  struct epoll_event evs[MAX_POLL_EVENTS];
+  int timeout, n, i;
+
+  if (pfd < 0)
+    return false;
+  if (IsVarTerm(t2)) {
+    Yap_Error(INSTANTIATION_ERROR, t2, "stream_poll_wait/3");
+    return false;
+  } else if (t2 == MkAtomTerm(AtomOff)) {
+    timeout = -1;
+  } else if (IsIntegerTerm(t2) && IntegerOfTerm(t2) >= 0) {
+    timeout = IntegerOfTerm(t2);
+  } else {
+    Yap_Error(DOMAIN_ERROR_TIMEOUT_SPEC, t2, "stream_poll_wait/3");
+    return false;
+  }
+  /* make sure we can build the answer */
+  if (ASP - HR < 16 * MAX_POLL_EVENTS + 1024) {
+    if (!Yap_gcl((16 * MAX_POLL_EVENTS + 1024) * sizeof(CELL), 3, ENV,
+                 gc_P(P, CP))) {
+      Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+      return false;
+    }
+  }
+  n = epoll_wait(pfd, evs, MAX_POLL_EVENTS, timeout);
+  if (n < 0) {
+    if (errno == EINTR)
+      return Yap_unify(ARG3, TermNil);
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, TermNil,
+              "stream_poll_wait/3 (epoll_wait: %s)", strerror(errno));
+    return false;
+  }
+  for (i = n - 1; i >= 0; i--) {
+    Term tevs = TermNil, ts[2];
+
+    if (evs[i].events & EPOLLERR)
+      tevs = MkPairTerm(MkAtomTerm(Yap_LookupAtom("error")), tevs);
+    if (evs[i].events & (EPOLLHUP | EPOLLRDHUP))
+      tevs = MkPairTerm(MkAtomTerm(Yap_LookupAtom("hangup")), tevs);
+    if (evs[i].events & EPOLLOUT)
+      tevs = MkPairTerm(MkAtomTerm(AtomWrite), tevs);
+    if (evs[i].events & EPOLLIN)
+      tevs = MkPairTerm(MkAtomTerm(AtomRead), tevs);
+    ts[0] = Yap_MkStream((int)evs[i].data.u64);
+    ts[1] = tevs;
+    tout = MkPairTerm(Yap_MkApplTerm(FunctorMinus, 2, ts), tout);
+  }
+  return Yap_unify(ARG3, tout);
+}
+
+static int get_socket(Term t, const char *msg) {
+  int sno = Yap_CheckStream(t, Socket_Stream_f, msg);
+
+  if (sno < 0)
+    return -1;
+  UNLOCK(GLOBAL_Stream[sno].streamlock);
+  return sno;
+}
+
+/* read whatever the socket has for us, without blocking. Returns 0 if the
+   peer has closed the connection, -1 on error */
+static int fill_socket_buffer(StreamDesc *st) {
+  size_t got = 0;
+
+  for (;;) {
+    ssize_t n;
+
+    if (st->u.socket.rsize - st->u.socket.rlen < 4096) {
+      size_t nsz = (st->u.socket.rsize ? 2 * st->u.socket.rsize : 8192);
+      char *nb = realloc(st->u.socket.rbuf, nsz);
+
+      if (!nb)
+        return -1;
+      st->u.socket.rbuf = nb;
+      st->u.socket.rsize = nsz;
+    }
+    n = recv(st->u.socket.fd, st->u.socket.rbuf + st->u.socket.rlen,
+             st->u.socket.rsize - st->u.socket.rlen, MSG_DONTWAIT);
+    if (n > 0) {
+      st->u.socket.rlen += n;
+      /* give the other streams a chance */
+      if ((got += n) > 1024 * 1024)
+        return 1;
+    } else if (n == 0) {
+      return 0;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 1;
+    } else {
+      return -1;
+    }
+  }
+}
+
+/* drop the first n bytes of the input buffer */
+static void consume_socket_buffer(StreamDesc *st, size_t n) {
+  st->u.socket.rlen -= n;
+  memmove(st->u.socket.rbuf, st->u.socket.rbuf + n, st->u.socket.rlen);
+}
+
+static Term socket_status(int rc, const char *msg) {
+  if (rc < 0) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, TermNil, "%s (recv: %s)", msg,
+              strerror(errno));
+    return 0L;
+  }
+  return MkAtomTerm(rc ? Yap_LookupAtom("open") : AtomEof);
+}
+
+/** @pred socket_recv_lines(+ _STREAM_, - _LINES_, - _STATUS_)
+
+Read all the data available on socket _STREAM_ without blocking, and
+unify _LINES_ with the list of complete lines received so far, as
+strings without the line terminator. Partial lines are kept for the
+next call. _STATUS_ is `open`, or `end_of_file` once the peer closed
+the connection, in which case the last, unterminated, line is also
+returned.
+*/
+static Int p_socket_recv_lines(USES_REGS1) {
+  int sno = get_socket(ARG1, "socket_recv_lines/3");
+  StreamDesc *st;
+  Term status, tout, *tailp = &tout;
+  size_t i, start, need;
+  int rc;
+
+  if (sno < 0)
+    return false;
+  st = GLOBAL_Stream + sno;
+  rc = fill_socket_buffer(st);
+  if (!(status = socket_status(rc, "socket_recv_lines/3")))
+    return false;
+  /* a string of n bytes takes at most n+12 cells, and its list cell 2 */
+  need = 2 * st->u.socket.rlen + 1024;
+  for (i = 0; i < st->u.socket.rlen; i++)
+    if (st->u.socket.rbuf[i] == '\n')
+      need += 16;
+  if (ASP - HR < need + 1024) {
+    if (!Yap_gcl(need * sizeof(CELL), 3, ENV, gc_P(P, CP))) {
+      Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+      return false;
+    }
+  }
+  /* make room for a terminator after a partial last line */
+  if (st->u.socket.rlen == st->u.socket.rsize) {
+    char *nb = realloc(st->u.socket.rbuf, st->u.socket.rsize + 1);
+
+    if (!nb) {
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "socket_recv_lines/3");
+      return false;
+    }
+    st->u.socket.rbuf = nb;
+    st->u.socket.rsize++;
+  }
+  for (i = start = 0; i < st->u.socket.rlen; i++) {
+    if (st->u.socket.rbuf[i] == '\n' ||
+        (rc == 0 && i + 1 == st->u.socket.rlen)) {
+      size_t end = (st->u.socket.rbuf[i] == '\n' ? i : i + 1);
+
+      if (end > start && st->u.socket.rbuf[end - 1] == '\r')
+        end--;
+      st->u.socket.rbuf[end] = '\0';
+      *tailp = AbsPair(HR);
+      HR += 2;
+      RepPair(*tailp)[0] = MkStringTerm(st->u.socket.rbuf + start);
+      tailp = RepPair(*tailp) + 1;
+      start = i + 1;
+    }
+  }
+  *tailp = TermNil;
+  consume_socket_buffer(st, (start < st->u.socket.rlen ? start
+                                                       : st->u.socket.rlen));
+  return Yap_unify(ARG2, tout) && Yap_unify(ARG3, status);
+}
+
+/** @pred socket_recv_terms(+ _STREAM_, - _TERMS_, - _STATUS_)
+
+As socket_recv_lines/3, but the peer sends terms in the format of
+fast_write/2, and _TERMS_ is the list of complete terms received.
+Terms received before a corrupted one are returned first; the next call
+raises a syntax error and skips the bad data.
+*/
+static Int p_socket_recv_terms(USES_REGS1) {
+  int sno = get_socket(ARG1, "socket_recv_terms/3");
+  StreamDesc *st;
+  Term status, tout = TermNil;
+  size_t pos = 0;
+  int rc;
+
+  if (sno < 0)
+    return false;
+  st = GLOBAL_Stream + sno;
+  rc = fill_socket_buffer(st);
+  if (!(status = socket_status(rc, "socket_recv_terms/3")))
+    return false;
+  /* collect the answers in reverse in an extra register, that survives
+     garbage collection */
+  XREGS[4] = TermNil;
+  for (;;) {
+    const unsigned char *s = (const unsigned char *)st->u.socket.rbuf + pos;
+    size_t left = st->u.socket.rlen - pos, hd = 4;
+    uint64_t len = 0;
+    int shift = 0;
+    Term t;
+
+    yap_error_number err;
+
+    if (left < 5)
+      break;
+    if (memcmp(s, "YFT", 3) || s[3] != FT_VERSION) {
+      /* we cannot find the next frame: return what we have, and drop
+         the rest of the input on the next call */
+      if (pos)
+        break;
+      consume_socket_buffer(st, st->u.socket.rlen);
+      Yap_Error(SYNTAX_ERROR, ARG1, "socket_recv_terms/3: not a fast term");
+      return false;
+    }
+    while (hd < left && hd < 14) {
+      len |= (uint64_t)(s[hd] & 0x7f) << shift;
+      shift += 7;
+      if (!(s[hd++] & 0x80))
+        break;
+    }
+    if ((s[hd - 1] & 0x80) || left - hd < len)
+      break;
+    if (!(t = Yap_TryFastTermFromBuffer(s + hd, len, 4, &err))) {
+      /* a bad frame: return the terms before it, it will be reported by
+         the next call */
+      if (pos)
+        break;
+      if (err == SYNTAX_ERROR) {
+        consume_socket_buffer(st, hd + len);
+        Yap_Error(err, ARG1, "socket_recv_terms/3: corrupted fast term");
+      } else {
+        Yap_Error(err, ARG1, LOCAL_ErrorMessage);
+      }
+      return false;
+    }
+    XREGS[4] = MkPairTerm(t, XREGS[4]);
+    pos += hd + len;
+  }
+  consume_socket_buffer(st, pos);
+  while (XREGS[4] != TermNil) {
+    Term tn = TailOfTerm(XREGS[4]);
+
+    RepPair(XREGS[4])[1] = tout;
+    tout = XREGS[4];
+    XREGS[4] = tn;
+  }
+  return Yap_unify(ARG2, tout) && Yap_unify(ARG3, status);
+}
+
+/* send as much of the output queue as the socket takes now */
+static bool flush_socket_buffer(StreamDesc *st) {
+  size_t sent = 0;
+
+  while (sent < st->u.socket.wlen) {
+    ssize_t n = send(st->u.socket.fd, st->u.socket.wbuf + sent,
+                     st->u.socket.wlen - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n >= 0)
+      sent += n;
+    else if (errno == EINTR)
+      continue;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else
+      return false;
+  }
+  st->u.socket.wlen -= sent;
+  memmove(st->u.socket.wbuf, st->u.socket.wbuf + sent, st->u.socket.wlen);
+  return true;
+}
+
+/** @pred socket_send(+ _STREAM_, + _DATA_, - _PENDING_)
+
+Send _DATA_ through socket _STREAM_ without blocking. _DATA_ is either
+text, or `fast_term(T)` to send _T_ in the format of fast_write/2.
+What the socket cannot take now is queued, and _PENDING_ is unified
+with the number of bytes waiting: they are sent by the next calls,
+e.g. `socket_send(S, '', Left)` when stream_poll_wait/3 reports that
+_S_ is ready for writing.
+*/
+static Int p_socket_send(USES_REGS1) {
+  int sno = get_socket(ARG1, "socket_send/3");
+  Term t = Deref(ARG2);
+  StreamDesc *st;
+  const char *data;
+  unsigned char *fdata = NULL;
+  size_t sz;
+
+  if (sno < 0)
+    return false;
+  st = GLOBAL_Stream + sno;
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, "socket_send/3");
+    return false;
+  }
+  if (IsApplTerm(t) &&
+      FunctorOfTerm(t) == Yap_MkFunctor(Yap_LookupAtom("fast_term"), 1)) {
+    if (!(fdata = Yap_FastTermToBuffer(ArgOfTerm(1, t), &sz, 3)))
+      return false;
+    data = (const char *)fdata;
+  } else {
+    if (!(data = Yap_TextTermToText(t, NULL, 0, ENC_ISO_UTF8)))
+      return false;
+    sz = strlen(data);
+  }
+  if (st->u.socket.wlen + sz > st->u.socket.wsize) {
+    size_t nsz = st->u.socket.wlen + sz + 4096;
+    char *nb = realloc(st->u.socket.wbuf, nsz);
+
+    if (!nb) {
+      if (fdata)
+        free(fdata);
+      else
+        freeBuffer(data);
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "socket_send/3");
+      return false;
+    }
+    st->u.socket.wbuf = nb;
+    st->u.socket.wsize = nsz;
+  }
+  memcpy(st->u.socket.wbuf + st->u.socket.wlen, data, sz);
+  st->u.socket.wlen += sz;
+  if (fdata)
+    free(fdata);
+  else
+    freeBuffer(data);
+  if (!flush_socket_buffer(st)) {
+    Yap_Error(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
+              "socket_send/3 (send: %s)", strerror(errno));
+    return false;
+  }
+  return Yap_unify(ARG3, MkIntegerTerm(st->u.socket.wlen));
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
 #endif
 
 void Yap_InitSocketLayer(void) {
@@ -1263,6 +1746,20 @@ void Yap_InitSocketLayer(void) {
                 SafePredFlag | SyncPredFlag | HiddenPredFlag);
   Yap_InitCPred("current_host", 1, p_current_host, SafePredFlag);
   Yap_InitCPred("hostname_address", 2, p_hostname_address, SafePredFlag);
+#if HAVE_SYS_EPOLL_H
+  Yap_InitCPred("stream_poll_create", 1, p_stream_poll_create, SafePredFlag);
+  Yap_InitCPred("stream_poll_close", 1, p_stream_poll_close, SafePredFlag);
+  Yap_InitCPred("stream_poll_add", 3, p_stream_poll_add,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("stream_poll_remove", 2, p_stream_poll_remove,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("stream_poll_wait", 3, p_stream_poll_wait, SafePredFlag);
+  Yap_InitCPred("socket_recv_lines", 3, p_socket_recv_lines,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_recv_terms", 3, p_socket_recv_terms,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_send", 3, p_socket_send, SafePredFlag | SyncPredFlag);
+#endif
 #if _MSC_VER || defined(__MINGW32__)
   {
     WSADATA info;
@@ -123,8 +123,6 @@ _|The development of this library was sponsored by SecuritEase,
 	term_variables/3 is a SWI-Prolog with a *|different definition|*.
 @tbd	Analysing the aggregation template and compiling a predicate
 	for the list aggregation can be done at compile time.
-@tbd	aggregate_all/3 can be rewritten to run in constant space using
-	non-backtrackable assignment on a term.
 */
 
 		 /*******************************
@@ -155,8 +153,81 @@ aggregate(Template, Discriminator, Goal0, Result) :-
 %%	aggregate_all(+Template, :Goal, -Result) is semidet.
 %
 %	Aggregate bindings in Goal according to Template.  The aggregate_all/3
-%	version performs findall/3 on Goal.
-
+%	version performs findall/3 on Goal.  The templates count, sum(Expr),
+%	max(Expr), min(Expr), max(Expr,Witness) and min(Expr,Witness) do not
+%	collect the solutions: they keep a running result in a term that is
+%	updated with nb_setarg/3.  The stacks then stay flat whatever the
+%	number of solutions, but nb_setarg/3 copies each new result that is
+%	not an atom or small integer, say a float, a bignum or a witness,
+%	and these copies are only reclaimed by the garbage collector.
+%
+%	min(Expr,Witness) returns the smallest Expr, as documented; older
+%	versions returned the largest one.
+
+aggregate_all(Var, _, _) :-
+	var(Var), !,
+	instantiation_error(Var).
+aggregate_all(count, Goal, Count) :- !,
+	aggregate_all(sum(1), Goal, Count).
+aggregate_all(sum(X), Goal, Sum) :- !,
+	State = state(0),
+	(   call(Goal),
+	    arg(1, State, S0),
+	    S is S0+X,
+	    nb_setarg(1, State, S),
+	    fail
+	;   arg(1, State, Sum)
+	).
+aggregate_all(max(X), Goal, Max) :- !,
+	State = state(none),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (   M0 == none -> true ; V > M0 ),
+	    nb_setarg(1, State, V),
+	    fail
+	;   arg(1, State, Max),
+	    Max \== none
+	).
+aggregate_all(min(X), Goal, Min) :- !,
+	State = state(none),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (   M0 == none -> true ; V < M0 ),
+	    nb_setarg(1, State, V),
+	    fail
+	;   arg(1, State, Min),
+	    Min \== none
+	).
+aggregate_all(max(X, W), Goal, Result) :- !,
+	State = state(none, _),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (   M0 == none -> true ; V > M0 ),
+	    nb_setarg(1, State, V),
+	    nb_setarg(2, State, W),
+	    fail
+	;   arg(1, State, Max),
+	    Max \== none,
+	    arg(2, State, Witness),
+	    Result = max(Max, Witness)
+	).
+aggregate_all(min(X, W), Goal, Result) :- !,
+	State = state(none, _),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (   M0 == none -> true ; V < M0 ),
+	    nb_setarg(1, State, V),
+	    nb_setarg(2, State, W),
+	    fail
+	;   arg(1, State, Min),
+	    Min \== none,
+	    arg(2, State, Witness),
+	    Result = min(Min, Witness)
+	).
 aggregate_all(Template, Goal0, Result) :-
 	template_to_pattern(all, Template, Pattern, Goal0, Goal, Aggregate),
 	findall(Pattern, Goal, List),
@@ -319,7 +390,7 @@ min_pair([M0-W0|T], M, W) :-
 
 min_pair([], M, W, M, W).
 min_pair([M0-W0|T], M1, W1, M, W) :-
-	(   M0 > M1
+	(   M0 < M1
 	->  min_pair(T, M0, W0, M, W)
 	;   min_pair(T, M1, W1, M, W)
 	).